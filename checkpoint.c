@@ -0,0 +1,612 @@
+/******************************************************************************
+ *
+ *                              checkpoint.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for checkpoint, a module that
+ *    writes a program's state to a log every so often and rebuilds it
+ *    from the log.
+ *
+ *    The log is a chain of records. The first one holds every mapped
+ *    segment; each later one holds only the segments memory.c's dirty
+ *    tracking saw change, and of those only the pages (1024 words) that
+ *    were written, so its size follows what the program did rather than
+ *    how much memory it has. Every record also holds the registers, the
+ *    program counter, the counts of instructions and input bytes, the
+ *    number of identifiers and the stack of free ones, since MAP must
+ *    hand out the same identifiers after a restore.
+ *
+ *    A record ends with a 64 bit FNV-1a hash of its bytes and is synced
+ *    to disk before the program continues. A record cut short by a crash
+ *    fails its hash; opening the log cuts it off, so the program resumes
+ *    from the last complete record and the log carries on from there.
+ *
+ *    With forkCheckpoints, each record is written by a child process
+ *    from its copy-on-write image of the machine instead, so the program
+ *    only pauses for the fork. The parent cleans its segments as soon as
+ *    the child exists and carries on; it learns how the child did the
+ *    next time a record is due, and skips that record, leaving its
+ *    segments dirty for the one after, while the child is still writing.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "assert.h"
+#include "checkpoint.h"
+#include "timing.h"
+
+/* Identifies a checkpoint record and the layout of its header */
+static const char CHECKPOINT_MAGIC[8] = "UMCKPT1";
+
+/* Words in a page of a record, as for dirty tracking */
+#define PAGE_WORDS (1u << DIRTY_PAGE_SHIFT)
+
+/* Struct that starts every record */
+struct checkpointHeader
+{
+        char magic[8];
+        uint64_t program;
+        uint64_t instructions;
+        uint64_t input_bytes;
+        uint32_t pc;
+        uint32_t registers[8];
+        uint32_t count;
+        uint32_t free_count;
+        uint32_t entries;
+};
+
+/* Struct that starts the entry of a segment in a record; pages pages
+follow, each its index and then its words */
+struct checkpointEntry
+{
+        uint32_t identifier;
+        uint32_t mapped;
+        uint32_t length;
+        uint32_t pages;
+};
+
+/* Struct that holds an open log */
+struct checkpointLog
+{
+        FILE *file;
+        char *path;
+        uint64_t program;
+        uint64_t records;
+        uint64_t hash;
+        bool fork;
+        bool writer;
+        pid_t child;
+        uint64_t skipped;
+        double longest_pause;
+};
+
+/******************************** fail() ********************************
+ *  Purpose: Gives up on a log that cannot be read or written
+ *  Parameters: checkpointLog log: the log
+ *              const char *what: what went wrong
+ *  Returns: Does not return
+ *  Effects: A writer child leaves with _exit, so that it does not flush
+ *           streams it shares with the parent
+ ***********************************************************************/
+static void fail(checkpointLog log, const char *what)
+{
+        fprintf(stderr, "um: checkpoint log %s: %s\n", log->path, what);
+        if (log->writer) {
+                _exit(EXIT_FAILURE);
+        }
+        exit(EXIT_FAILURE);
+}
+
+/******************************* fnv() *******************************
+ *  Purpose: Continues a 64 bit FNV-1a hash
+ *  Parameters: uint64_t hash: the hash so far
+ *              const void *bytes: more bytes
+ *              size_t size: their number
+ *  Returns: the hash with the bytes added
+ ***********************************************************************/
+static uint64_t fnv(uint64_t hash, const void *bytes, size_t size)
+{
+        const uint8_t *next = bytes;
+        for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ next[i]) * 1099511628211ULL;
+        }
+        return hash;
+}
+
+/* Starting value of every hash */
+#define FNV_BASIS 14695981039346656037ULL
+
+/****************************** putBytes() ******************************
+ *  Purpose: Writes part of a record
+ *  Parameters: checkpointLog log: the log
+ *              const void *bytes: what to write
+ *              size_t size: its size
+ *  Returns: None
+ *  Effects: Adds the bytes to the hash of the record; exits if the log
+ *           cannot be written
+ ***********************************************************************/
+static void putBytes(checkpointLog log, const void *bytes, size_t size)
+{
+        log->hash = fnv(log->hash, bytes, size);
+        if (fwrite(bytes, 1, size, log->file) != size) {
+                fail(log, strerror(errno));
+        }
+}
+
+/****************************** getBytes() ******************************
+ *  Purpose: Reads part of a record
+ *  Parameters: checkpointLog log: the log
+ *              void *bytes: where to put them
+ *              size_t size: how many to read
+ *  Returns: false if the log ends first
+ *  Effects: Adds the bytes to the hash of the record
+ ***********************************************************************/
+static bool getBytes(checkpointLog log, void *bytes, size_t size)
+{
+        if (fread(bytes, 1, size, log->file) != size) {
+                return false;
+        }
+        log->hash = fnv(log->hash, bytes, size);
+        return true;
+}
+
+/****************************** pageCount() ******************************
+ *  Purpose: Tells how many pages a segment has in a record
+ *  Parameters: uint32_t length: its number of words
+ *  Returns: the number of pages, the last of which may be short
+ ***********************************************************************/
+static uint32_t pageCount(uint32_t length)
+{
+        return (uint32_t) (((uint64_t) length + PAGE_WORDS - 1) >>
+                           DIRTY_PAGE_SHIFT);
+}
+
+/****************************** pageLength() ******************************
+ *  Purpose: Tells how many words a page of a segment holds
+ *  Parameters: uint32_t length: the number of words of the segment
+ *              uint32_t page: the page, below pageCount(length)
+ *  Returns: PAGE_WORDS, or fewer for the last page
+ ***********************************************************************/
+static uint32_t pageLength(uint32_t length, uint32_t page)
+{
+        uint32_t first = page << DIRTY_PAGE_SHIFT;
+        return length - first < PAGE_WORDS ? length - first : PAGE_WORDS;
+}
+
+/* What a record says about the machine besides its segments */
+struct checkpointState
+{
+        struct checkpointHeader header;
+        uint32_t *free_identifiers;
+};
+
+/***************************** readRecord() *****************************
+ *  Purpose: Reads the record at the current position of a log, and
+ *           applies it to a machine if asked to
+ *  Parameters: checkpointLog log: the log
+ *              executionContext *context: the machine, or NULL only to
+ *                                         check the record; *context is
+ *                                         NULL before the first record
+ *                                         and created by it
+ *              struct checkpointState *state: where to store the rest of
+ *                                             the state, whose
+ *                                             free_identifiers the
+ *                                             caller frees
+ *  Returns: false if the log ends, or the record is cut short or does
+ *           not match its hash
+ *  Effects: Exits if the record belongs to another program. Applying a
+ *           record replaces or updates the segments it holds.
+ *  Expects: when applying, the record was checked already
+ ***********************************************************************/
+static bool readRecord(checkpointLog log, executionContext *context,
+                       struct checkpointState *state)
+{
+        struct checkpointHeader *header = &state->header;
+        log->hash = FNV_BASIS;
+        state->free_identifiers = NULL;
+        if (!getBytes(log, header, sizeof(*header)) ||
+            memcmp(header->magic, CHECKPOINT_MAGIC,
+                   sizeof(CHECKPOINT_MAGIC)) != 0) {
+                return false;
+        }
+        if (header->program != log->program) {
+                fail(log, "written for another program");
+        }
+
+        size_t free_size = (size_t) header->free_count * sizeof(uint32_t);
+        state->free_identifiers = malloc(free_size + 1);
+        assert(state->free_identifiers != NULL);
+        if (!getBytes(log, state->free_identifiers, free_size)) {
+                return false;
+        }
+
+        uint32_t scratch[PAGE_WORDS];
+        for (uint32_t i = 0; i < header->entries; i++) {
+                struct checkpointEntry entry;
+                if (!getBytes(log, &entry, sizeof(entry))) {
+                        return false;
+                }
+
+                /* find or make the segment the pages go to */
+                Segment segment = NULL;
+                if (context != NULL && entry.mapped) {
+                        segmentTable table = *context == NULL ? NULL :
+                                             contextSegments(*context);
+                        if (table != NULL &&
+                            segmentMapped(table, entry.identifier) &&
+                            table->lengths[entry.identifier] ==
+                            entry.length) {
+                                segment = getSegment(table,
+                                                     entry.identifier);
+                        } else {
+                                segment = entry.identifier == 0 ?
+                                          newCodeSegment(entry.length) :
+                                          newSegment(entry.length);
+                                if (table == NULL) {
+                                        assert(entry.identifier == 0);
+                                        *context = newContext(segment);
+                                } else {
+                                        placeSegment(table,
+                                                     entry.identifier,
+                                                     segment);
+                                }
+                        }
+                } else if (context != NULL) {
+                        segmentTable table = contextSegments(*context);
+                        if (segmentMapped(table, entry.identifier)) {
+                                unmapSegmentOf(table, entry.identifier);
+                        }
+                }
+
+                for (uint32_t p = 0; p < entry.pages; p++) {
+                        uint32_t page;
+                        if (!getBytes(log, &page, sizeof(page)) ||
+                            page >= pageCount(entry.length)) {
+                                return false;
+                        }
+                        uint32_t *words = segment == NULL ? scratch :
+                                segment->words +
+                                ((size_t) page << DIRTY_PAGE_SHIFT);
+                        if (!getBytes(log, words,
+                                      (size_t) pageLength(entry.length,
+                                                          page) * 4)) {
+                                return false;
+                        }
+                }
+        }
+
+        uint64_t expected = log->hash;
+        uint64_t hash;
+        return fread(&hash, sizeof(hash), 1, log->file) == 1 &&
+               hash == expected;
+}
+
+/*************************** openCheckpointLog() ***************************
+ *  Purpose: Opens the log of a program, creating it if need be
+ *  Parameters: const char *path: the log
+ *              Segment program: the program as loaded, which the log
+ *                               must belong to
+ *  Returns: the log, positioned after its last complete record
+ *  Effects: Cuts off a record left incomplete by a crash; exits if the
+ *           log cannot be opened or belongs to another program
+ *  Expects: path and program must exist
+ ***********************************************************************/
+checkpointLog openCheckpointLog(const char *path, Segment program)
+{
+        assert(path != NULL && program != NULL);
+        checkpointLog log = malloc(sizeof(struct checkpointLog));
+        assert(log != NULL);
+        log->path = malloc(strlen(path) + 1);
+        assert(log->path != NULL);
+        strcpy(log->path, path);
+        log->program = fnv(FNV_BASIS, program->words,
+                           (size_t) program->length * 4);
+        log->records = 0;
+        log->fork = false;
+        log->writer = false;
+        log->child = 0;
+        log->skipped = 0;
+        log->longest_pause = 0;
+
+        int fd = open(path, O_RDWR | O_CREAT, 0666);
+        log->file = fd == -1 ? NULL : fdopen(fd, "r+b");
+        if (log->file == NULL) {
+                fail(log, strerror(errno));
+        }
+
+        /* keep the complete records, and only those */
+        long valid_end = 0;
+        struct checkpointState state;
+        while (readRecord(log, NULL, &state)) {
+                free(state.free_identifiers);
+                log->records++;
+                valid_end = ftell(log->file);
+        }
+        free(state.free_identifiers);
+        fflush(log->file);
+        if (ftruncate(fileno(log->file), valid_end) != 0 ||
+            fseek(log->file, valid_end, SEEK_SET) != 0) {
+                fail(log, strerror(errno));
+        }
+        return log;
+}
+
+/************************** resumeFromCheckpoint() **************************
+ *  Purpose: Creates the machine a run continues with
+ *  Parameters: checkpointLog log: the log of the program
+ *              Segment program: the program as loaded
+ *              FILE *input: the input of the program
+ *  Returns: a context in the state of the last record of the log, or a
+ *           new context for program if the log is empty
+ *  Effects: Takes program, freeing it when the log has records. Skips
+ *           the input the program had read by the last record. Starts
+ *           dirty tracking, with everything clean.
+ *  Expects: log came from openCheckpointLog with the same program
+ ***********************************************************************/
+executionContext resumeFromCheckpoint(checkpointLog log, Segment program,
+                                      FILE *input)
+{
+        assert(log != NULL && program != NULL && input != NULL);
+        executionContext context = NULL;
+        if (log->records == 0) {
+                context = newContext(program);
+        } else {
+                freeSegment(&program);
+                long end = ftell(log->file);
+                rewind(log->file);
+                struct checkpointState state;
+                for (uint64_t i = 0; i < log->records; i++) {
+                        if (i != 0) {
+                                free(state.free_identifiers);
+                        }
+                        if (!readRecord(log, &context, &state)) {
+                                fail(log, "changed while being read");
+                        }
+                }
+                segmentTable table = contextSegments(context);
+                struct checkpointHeader *header = &state.header;
+                restoreIdentifiers(table, header->count,
+                                   state.free_identifiers,
+                                   header->free_count);
+                free(state.free_identifiers);
+                resumeContext(context, header->pc, header->registers,
+                              header->instructions, header->input_bytes);
+                for (uint64_t i = 0; i < header->input_bytes; i++) {
+                        if (getc(input) == EOF) {
+                                break;
+                        }
+                }
+                if (fseek(log->file, end, SEEK_SET) != 0) {
+                        fail(log, strerror(errno));
+                }
+        }
+        segmentTable table = contextSegments(context);
+        enableDirtyTracking(table);
+        clearDirty(table);
+        return context;
+}
+
+/**************************** putSegment() ****************************
+ *  Purpose: Writes the entry of a segment
+ *  Parameters: checkpointLog log: the log
+ *              segmentTable table: the segments
+ *              uint32_t identifier: the segment
+ *              bool all: whether to write every page, or only those 
+ *                        written since the last checkpoint
+ *  Returns: None
+ ***********************************************************************/
+static void putSegment(checkpointLog log, segmentTable table,
+                       uint32_t identifier, bool all)
+{
+        struct checkpointEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.identifier = identifier;
+        entry.mapped = segmentMapped(table, identifier);
+        entry.length = table->lengths[identifier];
+        uint32_t count = pageCount(entry.length);
+        for (uint32_t page = 0; page < count; page++) {
+                if (all || pageWritten(table, identifier, page)) {
+                        entry.pages++;
+                }
+        }
+        putBytes(log, &entry, sizeof(entry));
+        if (entry.pages == 0) {
+                return;
+        }
+
+        Segment segment = getSegment(table, identifier);
+        for (uint32_t page = 0; page < count; page++) {
+                if (all || pageWritten(table, identifier, page)) {
+                        putBytes(log, &page, sizeof(page));
+                        putBytes(log, segment->words +
+                                      ((size_t) page << DIRTY_PAGE_SHIFT),
+                                 (size_t) pageLength(entry.length, page) *
+                                 4);
+                }
+        }
+}
+
+/***************************** putRecord() *****************************
+ *  Purpose: Appends a record of a machine to its log
+ *  Parameters: checkpointLog log: the log
+ *              executionContext context: the machine
+ *  Returns: None
+ *  Effects: The first record of a log holds every segment, later ones
+ *           the pages written since the record before. The record is
+ *           synced to disk. Exits if the log cannot be written.
+ ***********************************************************************/
+static void putRecord(checkpointLog log, executionContext context)
+{
+        segmentTable table = contextSegments(context);
+        bool base = log->records == 0;
+
+        struct checkpointHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        header.program = log->program;
+        header.instructions = contextInstructions(context);
+        header.input_bytes = contextInputBytes(context);
+        header.pc = contextProgramCounter(context);
+        for (int i = 0; i < 8; i++) {
+                header.registers[i] = contextRegister(context, i);
+        }
+        header.count = table->count;
+        header.free_count = table->free_count;
+        if (base) {
+                for (uint32_t id = 0; id < table->count; id++) {
+                        header.entries += segmentMapped(table, id);
+                }
+        } else {
+                header.entries = table->dirty_count;
+        }
+
+        /* a writer child shares the file offset, not the stream's idea
+        of it */
+        if (fseek(log->file, 0, SEEK_END) != 0) {
+                fail(log, strerror(errno));
+        }
+        log->hash = FNV_BASIS;
+        putBytes(log, &header, sizeof(header));
+        putBytes(log, table->free_identifiers,
+                 (size_t) table->free_count * sizeof(uint32_t));
+        if (base) {
+                for (uint32_t id = 0; id < table->count; id++) {
+                        if (segmentMapped(table, id)) {
+                                putSegment(log, table, id, true);
+                        }
+                }
+        } else {
+                for (uint32_t i = 0; i < table->dirty_count; i++) {
+                        uint32_t id = table->dirty_identifiers[i];
+                        putSegment(log, table, id, false);
+                }
+        }
+        uint64_t hash = log->hash;
+        putBytes(log, &hash, sizeof(hash));
+        if (fflush(log->file) != 0 || fsync(fileno(log->file)) != 0) {
+                fail(log, strerror(errno));
+        }
+}
+
+/**************************** reapWriter() ****************************
+ *  Purpose: Finds out whether the child writing the last record is done
+ *  Parameters: checkpointLog log: a log with a writer child
+ *              bool wait: whether to wait for the child to finish
+ *  Returns: true if the child is done (always, when waiting)
+ *  Effects: Exits if the child failed, since the segments it was to
+ *           record are clean in the parent and the record torn
+ ***********************************************************************/
+static bool reapWriter(checkpointLog log, bool wait)
+{
+        int status;
+        pid_t done = waitpid(log->child, &status, wait ? 0 : WNOHANG);
+        if (done == 0) {
+                return false;
+        }
+        log->child = 0;
+        if (done == -1 || !WIFEXITED(status) || 
+            WEXITSTATUS(status) != EXIT_SUCCESS) {
+                fail(log, "its writer failed");
+        }
+        return true;
+}
+
+/*************************** writeCheckpoint() ***************************
+ *  Purpose: Adds a record of a machine to its log
+ *  Parameters: checkpointLog log: the log
+ *              executionContext context: the machine, stopped between
+ *                                        two run() calls
+ *  Returns: None
+ *  Effects: Writes the record (see putRecord), in a child when the log
+ *           forks, and makes every segment clean again. A forking log
+ *           skips the record while the child of the one before is still
+ *           writing. Exits if the log cannot be written.
+ *  Expects: context came from resumeFromCheckpoint on this log
+ ***********************************************************************/
+void writeCheckpoint(checkpointLog log, executionContext context)
+{
+        assert(log != NULL && context != NULL);
+        double start = clockNow(CLOCK_MONOTONIC);
+        if (!log->fork) {
+                putRecord(log, context);
+        } else {
+                if (log->child != 0 && !reapWriter(log, false)) {
+                        log->skipped++;
+                        return;
+                }
+                fflush(NULL);
+                pid_t child = fork();
+                if (child == -1) {
+                        fail(log, strerror(errno));
+                } else if (child == 0) {
+                        log->writer = true;
+                        putRecord(log, context);
+                        _exit(EXIT_SUCCESS);
+                }
+                log->child = child;
+        }
+        clearDirty(contextSegments(context));
+        log->records++;
+
+        double pause = (clockNow(CLOCK_MONOTONIC) - start) * 1e3;
+        if (pause > log->longest_pause) {
+                log->longest_pause = pause;
+        }
+}
+
+/*************************** forkCheckpoints() ***************************
+ *  Purpose: Makes a log write each record from a child process
+ *  Parameters: checkpointLog log: the log
+ *  Returns: None
+ *  Expects: log must exist
+ ***********************************************************************/
+void forkCheckpoints(checkpointLog log)
+{
+        assert(log != NULL);
+        log->fork = true;
+}
+
+/************************** reportCheckpoints() **************************
+ *  Purpose: Describes on stderr what a log cost the run, for --profile
+ *  Parameters: checkpointLog log: the log
+ *  Returns: None
+ *  Expects: log must exist
+ ***********************************************************************/
+void reportCheckpoints(checkpointLog log)
+{
+        assert(log != NULL);
+        fprintf(stderr, "um: checkpoints: %" PRIu64 " records, %" PRIu64 
+                        " skipped while writing, longest pause %.1f ms\n",
+                log->records, log->skipped, log->longest_pause);
+}
+
+/************************** closeCheckpointLog() **************************
+ *  Purpose: Closes a log
+ *  Parameters: checkpointLog *log: reference to the log
+ *  Returns: None
+ *  Effects: Waits for a record still being written; sets *log to NULL
+ *  Expects: log and *log must exist
+ ***********************************************************************/
+void closeCheckpointLog(checkpointLog *log)
+{
+        assert(log != NULL && *log != NULL);
+        if ((*log)->child != 0) {
+                reapWriter(*log, true);
+        }
+        fclose((*log)->file);
+        free((*log)->path);
+        free(*log);
+        *log = NULL;
+}
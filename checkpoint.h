@@ -0,0 +1,43 @@
+/*************************************************************
+ *
+ *                     checkpoint.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for checkpoint, a module that
+ *    keeps a log of checkpoints of a running program: one full record
+ *    of its segments and registers, then records of only what changed
+ *    since the one before, so that a program killed with its host can
+ *    be resumed from the last complete record.
+ *
+ **************************************************************/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include "executor.h"
+#include "memory.h"
+
+typedef struct checkpointLog *checkpointLog;
+
+checkpointLog
+openCheckpointLog(const char *path, Segment program);
+
+executionContext
+resumeFromCheckpoint(checkpointLog log, Segment program, FILE *input);
+
+void
+writeCheckpoint(checkpointLog log, executionContext context);
+
+void
+forkCheckpoints(checkpointLog log);
+
+void
+reportCheckpoints(checkpointLog log);
+
+void
+closeCheckpointLog(checkpointLog *log);
+
+#endif
@@ -0,0 +1,360 @@
+/******************************************************************************
+ *
+ *                              codecache.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for codecache, a module that
+ *    keeps the records an executor derives from an image of segment 0 in
+ *    a directory, so that they survive the process.
+ *
+ *    An image is named by a 64 bit hash of its words, as DIR/<hash>.umc.
+ *    The file holds a header, the records and then the image itself; the
+ *    records come first so that they start at a fixed offset and can be
+ *    used in place, and the image is there so that a hash collision is a
+ *    miss rather than wrong code. The caller versions its records, and a
+ *    file written for another version is a miss as well. Files are
+ *    mapped privately, so the executor may update its copy of the
+ *    records without touching the file, and are written under a
+ *    temporary name and renamed, so that runs sharing a directory never
+ *    see half a file. The cache is only an accelerator: any error is
+ *    treated as a miss.
+ *
+ *    Since the images a program loads are up to the program, not all of
+ *    them are kept: only the first image a process offers (the program
+ *    itself) and any image offered again, so that a program loading many
+ *    images once each writes nothing. The directory is held to
+ *    CACHE_BYTES: each hit touches its file, and after a store the files
+ *    least recently used are removed until the rest fit, along with any
+ *    file written with another header or version.
+ *
+ *****************************************************************************/
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "codecache.h"
+
+/* Identifies a code cache file and the layout of its header; bumped
+whenever that layout changes */
+static const char CACHE_MAGIC[8] = "UMCODE2";
+
+/* Most bytes the files of a cache directory take together */
+#define CACHE_BYTES ((off_t) 256 << 20)
+
+/* Number of images whose hashes are remembered, to tell an image offered
+again from a new one */
+#define SEEN_SLOTS 256
+
+/* Hashes of the images offered in this process, each in the slot its low
+bits name (a later image may take the slot over), and whether any was */
+static uint64_t seen[SEEN_SLOTS];
+static bool offered = false;
+
+/* Struct that starts every code cache file */
+struct cacheHeader
+{
+        char magic[8];
+        uint64_t hash;
+        uint64_t records_size;
+        uint32_t length;
+        uint32_t version;
+};
+
+/****************************** hashImage() ******************************
+ *  Purpose: Names an image of segment 0
+ *  Parameters: const uint32_t *words: the image
+ *              uint32_t length: its number of words
+ *  Returns: a 64 bit FNV-1a hash of the words and the length
+ ***********************************************************************/
+static uint64_t hashImage(const uint32_t *words, uint32_t length)
+{
+        uint64_t hash = 14695981039346656037ULL;
+        for (uint32_t i = 0; i < length; i++) {
+                hash = (hash ^ words[i]) * 1099511628211ULL;
+        }
+        return (hash ^ length) * 1099511628211ULL;
+}
+
+/****************************** keepImage() ******************************
+ *  Purpose: Decides whether the records of an image are worth keeping
+ *  Parameters: uint64_t hash: the hash of an image being offered
+ *  Returns: true for the first image offered in this process and for
+ *           one offered before
+ *  Effects: Remembers the image as offered
+ ***********************************************************************/
+static bool keepImage(uint64_t hash)
+{
+        uint64_t *slot = &seen[hash % SEEN_SLOTS];
+        bool keep = !offered || *slot == hash;
+        offered = true;
+        *slot = hash;
+        return keep;
+}
+
+/****************************** cachePath() ******************************
+ *  Purpose: Builds the name of the file that holds an image
+ *  Parameters: const char *directory: the cache directory
+ *              uint64_t hash: the hash of the image
+ *              const char *suffix: appended to the name
+ *  Returns: the path, which the caller frees
+ ***********************************************************************/
+static char *cachePath(const char *directory, uint64_t hash,
+                       const char *suffix)
+{
+        size_t size = strlen(directory) + strlen(suffix) + 24;
+        char *path = malloc(size);
+        assert(path != NULL);
+        snprintf(path, size, "%s/%016llx.umc%s", directory,
+                 (unsigned long long) hash, suffix);
+        return path;
+}
+
+/***************************** codeCacheMap() *****************************
+ *  Purpose: Maps in the records kept for an image
+ *  Parameters: const char *directory: the cache directory
+ *              const uint32_t *words, uint32_t length: the image
+ *              size_t records_size: the size the records must have
+ *              uint32_t version: the version the records must have
+ *              bool *keep: where to store whether codeCacheStore should
+ *                          be given the records on a miss
+ *              size_t *mapping_size: where to store what codeCacheUnmap
+ *                                    needs
+ *  Returns: the records, which may be written without changing the
+ *           file, or NULL if the directory holds none for this image
+ *  Effects: Maps the file privately and marks it as recently used
+ *  Expects: directory, words, keep and mapping_size must exist
+ ***********************************************************************/
+void *codeCacheMap(const char *directory, const uint32_t *words,
+                   uint32_t length, size_t records_size, uint32_t version,
+                   bool *keep, size_t *mapping_size)
+{
+        assert(directory != NULL && words != NULL && keep != NULL &&
+               mapping_size != NULL);
+        uint64_t hash = hashImage(words, length);
+        *keep = keepImage(hash);
+        char *path = cachePath(directory, hash, "");
+        int fd = open(path, O_RDONLY);
+        free(path);
+        if (fd == -1) {
+                return NULL;
+        }
+
+        size_t size = sizeof(struct cacheHeader) + records_size +
+                      (size_t) length * sizeof(uint32_t);
+        struct stat file;
+        void *mapping = MAP_FAILED;
+        if (fstat(fd, &file) == 0 && (size_t) file.st_size == size) {
+                mapping = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE, fd, 0);
+        }
+        if (mapping != MAP_FAILED) {
+                futimens(fd, NULL);
+        }
+        close(fd);
+        if (mapping == MAP_FAILED) {
+                return NULL;
+        }
+
+        struct cacheHeader *header = mapping;
+        char *records = (char *) mapping + sizeof(struct cacheHeader);
+        if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+            header->hash != hash || header->records_size != records_size ||
+            header->length != length || header->version != version ||
+            memcmp(records + records_size, words,
+                   (size_t) length * sizeof(uint32_t)) != 0) {
+                munmap(mapping, size);
+                return NULL;
+        }
+        *mapping_size = size;
+        return records;
+}
+
+/* A file of a cache directory, as trimCache sees it */
+struct cacheFile {
+        char *name;
+        off_t size;
+        struct timespec used;
+};
+
+/***************************** isCurrent() *****************************
+ *  Purpose: Tells whether a file of a cache directory could still be hit
+ *  Parameters: int directory: the open cache directory
+ *              const char *name: a file in it named *.umc
+ *              uint32_t version: the version of the records being kept
+ *  Returns: false if the file starts with another header or version
+ ***********************************************************************/
+static bool isCurrent(int directory, const char *name, uint32_t version)
+{
+        int fd = openat(directory, name, O_RDONLY);
+        if (fd == -1) {
+                return true;
+        }
+        struct cacheHeader header;
+        bool current = read(fd, &header, sizeof(header)) ==
+                               (ssize_t) sizeof(header) &&
+                       memcmp(header.magic, CACHE_MAGIC,
+                              sizeof(CACHE_MAGIC)) == 0 &&
+                       header.version == version;
+        close(fd);
+        return current;
+}
+
+/*************************** compareUse() ***************************
+ *  Purpose: Orders the files of a cache directory, least recently used
+ *           first, for qsort
+ *  Parameters: const void *a, const void *b: two struct cacheFile
+ *  Returns: <0, 0 or >0
+ ***********************************************************************/
+static int compareUse(const void *a, const void *b)
+{
+        const struct timespec *x = &((const struct cacheFile *) a)->used;
+        const struct timespec *y = &((const struct cacheFile *) b)->used;
+        if (x->tv_sec != y->tv_sec) {
+                return x->tv_sec < y->tv_sec ? -1 : 1;
+        }
+        return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+/****************************** trimCache() ******************************
+ *  Purpose: Holds a cache directory to CACHE_BYTES
+ *  Parameters: const char *path: the cache directory
+ *              const char *kept: the name of the file just written
+ *              uint32_t version: the version of the records being kept
+ *  Returns: None
+ *  Effects: Removes the files of another header or version, then the
+ *           least recently used files (temporary ones included) but
+ *           kept, until the rest fit
+ ***********************************************************************/
+static void trimCache(const char *path, const char *kept, uint32_t version)
+{
+        DIR *directory = opendir(path);
+        if (directory == NULL) {
+                return;
+        }
+        int fd = dirfd(directory);
+        struct cacheFile *files = NULL;
+        size_t count = 0, capacity = 0;
+        off_t total = 0;
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL) {
+                const char *suffix = strstr(entry->d_name, ".umc");
+                struct stat file;
+                if (suffix == NULL || 
+                    fstatat(fd, entry->d_name, &file, 0) != 0 ||
+                    !S_ISREG(file.st_mode)) {
+                        continue;
+                }
+                if (suffix[4] == '\0' &&
+                    !isCurrent(fd, entry->d_name, version)) {
+                        unlinkat(fd, entry->d_name, 0);
+                        continue;
+                }
+                total += file.st_size;
+                if (strcmp(entry->d_name, kept) == 0) {
+                        continue;
+                }
+                if (count == capacity) {
+                        capacity = capacity == 0 ? 16 : 2 * capacity;
+                        files = realloc(files, capacity * sizeof(*files));
+                        assert(files != NULL);
+                }
+                files[count].name = strdup(entry->d_name);
+                assert(files[count].name != NULL);
+                files[count].size = file.st_size;
+                files[count].used = file.st_mtim;
+                count++;
+        }
+
+        qsort(files, count, sizeof(*files), compareUse);
+        for (size_t i = 0; i < count; i++) {
+                if (total > CACHE_BYTES && 
+                    unlinkat(fd, files[i].name, 0) == 0) {
+                        total -= files[i].size;
+                }
+                free(files[i].name);
+        }
+        free(files);
+        closedir(directory);
+}
+
+/**************************** codeCacheStore() ****************************
+ *  Purpose: Keeps the records derived from an image for later runs
+ *  Parameters: const char *directory: the cache directory, created if
+ *                                     need be
+ *              const uint32_t *words, uint32_t length: the image
+ *              const void *records: the records
+ *              size_t records_size: their size in bytes
+ *              uint32_t version: the version of their format
+ *  Returns: None
+ *  Effects: Writes DIR/<hash>.umc, replacing any earlier file at once,
+ *           and trims the directory; gives up quietly if the directory
+ *           cannot be written or the file alone would not fit in it
+ *  Expects: directory, words and records must exist, and codeCacheMap
+ *           asked to keep the records
+ ***********************************************************************/
+void codeCacheStore(const char *directory, const uint32_t *words,
+                    uint32_t length, const void *records,
+                    size_t records_size, uint32_t version)
+{
+        assert(directory != NULL && words != NULL && records != NULL);
+        if (sizeof(struct cacheHeader) + records_size +
+            (size_t) length * sizeof(uint32_t) > (size_t) CACHE_BYTES ||
+            (mkdir(directory, 0777) == -1 && errno != EEXIST)) {
+                return;
+        }
+
+        struct cacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.hash = hashImage(words, length);
+        header.records_size = records_size;
+        header.length = length;
+        header.version = version;
+
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%ld", (long) getpid());
+        char *temporary = cachePath(directory, header.hash, suffix);
+        char *path = cachePath(directory, header.hash, "");
+        FILE *file = fopen(temporary, "wb");
+        if (file != NULL) {
+                bool written =
+                        fwrite(&header, sizeof(header), 1, file) == 1 &&
+                        fwrite(records, 1, records_size, file) ==
+                                records_size &&
+                        fwrite(words, sizeof(uint32_t), length, file) ==
+                                length;
+                if (fclose(file) != 0 || !written ||
+                    rename(temporary, path) != 0) {
+                        unlink(temporary);
+                } else {
+                        trimCache(directory, strrchr(path, '/') + 1,
+                                  version);
+                }
+        }
+        free(temporary);
+        free(path);
+}
+
+/**************************** codeCacheUnmap() ****************************
+ *  Purpose: Releases records returned by codeCacheMap
+ *  Parameters: void *records: the records
+ *              size_t mapping_size: as stored by codeCacheMap
+ *  Returns: None
+ *  Expects: records came from codeCacheMap
+ ***********************************************************************/
+void codeCacheUnmap(void *records, size_t mapping_size)
+{
+        assert(records != NULL);
+        munmap((char *) records - sizeof(struct cacheHeader), mapping_size);
+}
@@ -0,0 +1,39 @@
+/*************************************************************
+ *
+ *                     codecache.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for codecache, a module that keeps
+ *    what an executor derived from an image of segment 0 (one fixed size
+ *    record per word) in a directory, under a hash of the image, so that
+ *    a later run or LOAD_PROGRAM of the same image maps the records back
+ *    in instead of deriving them again. The executor gives a version of
+ *    its records, so that files it wrote with another layout are ignored.
+ *    Only the records of images worth keeping are stored, and the
+ *    directory is held to a fixed size.
+ *
+ **************************************************************/
+#ifndef CODECACHE_H
+#define CODECACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void *
+codeCacheMap(const char *directory, const uint32_t *words, uint32_t length,
+             size_t record_size, uint32_t version, bool *keep,
+             size_t *mapping_size);
+
+void
+codeCacheStore(const char *directory, const uint32_t *words,
+               uint32_t length, const void *records, size_t record_size,
+               uint32_t version);
+
+void
+codeCacheUnmap(void *records, size_t mapping_size);
+
+#endif
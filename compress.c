@@ -0,0 +1,211 @@
+/******************************************************************************
+ *
+ *                              compress.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for compress, an LZ-style codec
+ *    on 32 bit words.
+ *
+ *    The packed form is a series of tokens. Each token is a count of
+ *    literal words, those words as they are, then the length of a match
+ *    and, if it is not 0, how many words back the match starts; every
+ *    number is a little endian base 128 varint. A match may overlap the
+ *    words it produces, so a run of one value packs to a literal and a
+ *    single match at distance 1. Matches are found through a table of the
+ *    last position of each hashed pair of words, so compressing is one
+ *    pass with no search.
+ *
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "compress.h"
+
+/* log2 of the number of entries in the match table */
+#define HASH_BITS 12
+
+/* Shortest match worth a token; a shorter one stays literal */
+#define MIN_MATCH 2
+
+/* Where compressWords writes, and where it must stop */
+struct packer
+{
+        uint8_t *next;
+        uint8_t *end;
+};
+
+/****************************** hashPair() ******************************
+ *  Purpose: Picks the entry of the match table for two words
+ *  Parameters: uint32_t first, second: consecutive words
+ *  Returns: an index below 1 << HASH_BITS
+ ***********************************************************************/
+static inline uint32_t hashPair(uint32_t first, uint32_t second)
+{
+        uint32_t mixed = first * 2654435761u ^ (second * 2246822519u >> 7);
+        return mixed >> (32 - HASH_BITS);
+}
+
+/****************************** putNumber() ******************************
+ *  Purpose: Writes a varint
+ *  Parameters: struct packer *packer: the output
+ *              uint32_t value: the number
+ *  Returns: false if the output is full
+ ***********************************************************************/
+static bool putNumber(struct packer *packer, uint32_t value)
+{
+        do {
+                if (packer->next == packer->end) {
+                        return false;
+                }
+                uint8_t byte = value & 0x7f;
+                value >>= 7;
+                *packer->next++ = byte | (value != 0 ? 0x80 : 0);
+        } while (value != 0);
+        return true;
+}
+
+/****************************** putToken() ******************************
+ *  Purpose: Writes a token
+ *  Parameters: struct packer *packer: the output
+ *              const uint32_t *literals: the literal words
+ *              uint32_t literal_count: their number
+ *              uint32_t match, distance: the match that follows, or 0
+ *  Returns: false if the output is full
+ ***********************************************************************/
+static bool putToken(struct packer *packer, const uint32_t *literals,
+                     uint32_t literal_count, uint32_t match,
+                     uint32_t distance)
+{
+        if (!putNumber(packer, literal_count)) {
+                return false;
+        }
+        size_t size = (size_t) literal_count * 4;
+        if ((size_t) (packer->end - packer->next) < size) {
+                return false;
+        }
+        memcpy(packer->next, literals, size);
+        packer->next += size;
+        return putNumber(packer, match) &&
+               (match == 0 || putNumber(packer, distance));
+}
+
+/**************************** compressWords() ****************************
+ *  Purpose: Packs an array of words
+ *  Parameters: const uint32_t *words: the words
+ *              uint32_t length: their number
+ *              uint8_t *bytes: where the packed form goes
+ *              size_t capacity: the most bytes it may take
+ *  Returns: the size of the packed form, or 0 if it does not fit in
+ *           capacity, in which case bytes holds nothing useful
+ *  Expects: words and bytes must exist
+ ***********************************************************************/
+size_t compressWords(const uint32_t *words, uint32_t length, uint8_t *bytes,
+                     size_t capacity)
+{
+        assert(words != NULL && bytes != NULL);
+
+        /* 1 + the last position of each hashed pair, or 0 */
+        uint32_t last[1 << HASH_BITS];
+        memset(last, 0, sizeof(last));
+
+        struct packer packer = { bytes, bytes + capacity };
+        uint32_t literal_start = 0;
+        uint32_t i = 0;
+        while (i + MIN_MATCH <= length) {
+                uint32_t hash = hashPair(words[i], words[i + 1]);
+                uint32_t candidate = last[hash];
+                last[hash] = i + 1;
+
+                uint32_t match = 0;
+                if (candidate != 0) {
+                        candidate--;
+                        while (i + match < length &&
+                               words[candidate + match] == words[i + match]) {
+                                match++;
+                        }
+                }
+                if (match < MIN_MATCH) {
+                        i++;
+                        continue;
+                }
+                if (!putToken(&packer, words + literal_start,
+                              i - literal_start, match, i - candidate)) {
+                        return 0;
+                }
+                i += match;
+                literal_start = i;
+        }
+        if (literal_start < length &&
+            !putToken(&packer, words + literal_start, length - literal_start,
+                      0, 0)) {
+                return 0;
+        }
+        return packer.next - bytes;
+}
+
+/****************************** getNumber() ******************************
+ *  Purpose: Reads a varint
+ *  Parameters: const uint8_t **next: the input, advanced past the number
+ *              const uint8_t *end: the end of the input
+ *  Returns: the number
+ *  Expects: the input was written by compressWords
+ ***********************************************************************/
+static uint32_t getNumber(const uint8_t **next, const uint8_t *end)
+{
+        uint32_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+                assert(*next < end && shift < 35);
+                uint8_t byte = *(*next)++;
+                value |= (uint32_t) (byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                        return value;
+                }
+        }
+}
+
+/*************************** decompressWords() ***************************
+ *  Purpose: Unpacks what compressWords packed
+ *  Parameters: const uint8_t *bytes: the packed form
+ *              size_t size: its size
+ *              uint32_t *words: where the words go
+ *              uint32_t length: their number, as given to compressWords
+ *  Returns: None
+ *  Expects: bytes and words must exist, and bytes be the packed form of
+ *           length words
+ ***********************************************************************/
+void decompressWords(const uint8_t *bytes, size_t size, uint32_t *words,
+                     uint32_t length)
+{
+        assert(bytes != NULL && words != NULL);
+        const uint8_t *next = bytes;
+        const uint8_t *end = bytes + size;
+        uint32_t filled = 0;
+        while (filled < length) {
+                uint32_t literal_count = getNumber(&next, end);
+                assert(literal_count <= length - filled);
+                assert((size_t) (end - next) >= (size_t) literal_count * 4);
+                memcpy(words + filled, next, (size_t) literal_count * 4);
+                next += (size_t) literal_count * 4;
+                filled += literal_count;
+
+                uint32_t match = getNumber(&next, end);
+                if (match == 0) {
+                        continue;
+                }
+                uint32_t distance = getNumber(&next, end);
+                assert(distance != 0 && distance <= filled);
+                assert(match <= length - filled);
+
+                /* word by word, since the match may overlap itself */
+                const uint32_t *from = words + filled - distance;
+                for (uint32_t k = 0; k < match; k++) {
+                        words[filled + k] = from[k];
+                }
+                filled += match;
+        }
+        assert(next == end);
+}
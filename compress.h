@@ -0,0 +1,29 @@
+/*************************************************************
+ *
+ *                     compress.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for compress, a small LZ-style
+ *    codec on 32 bit words that memory uses to keep cold segments
+ *    packed. It favours speed over ratio: runs and repeated blocks of
+ *    words, which make up most of a long-lived segment, pack well.
+ *
+ **************************************************************/
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+size_t
+compressWords(const uint32_t *words, uint32_t length, uint8_t *bytes,
+              size_t capacity);
+
+void
+decompressWords(const uint8_t *bytes, size_t size, uint32_t *words,
+                uint32_t length);
+
+#endif
@@ -16,256 +16,2286 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <math.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 #include "assert.h"
 #include "bitpack.h"
+#include "codecache.h"
 #include "executor.h"
+#include "flight.h"
+#include "guard.h"
+#include "idiom.h"
 #include "instructionSet.h"
+#include "isa.h"
+#include "livestats.h"
 #include "memory.h"
+#include "probes.h"
+#include "timing.h"
 #include "registers.h"
 #include "seq.h"
 
-typedef uint32_t Um_instruction;
-typedef enum Um_opcode {
-        COND_MOV = 0, SEG_LOAD, SEG_STORE, ADD, MULT, DIV,
-        NAND, HALT, MAP, UNMAP, OUTPUT, INPUT, LOAD_PROGRAM, LOAD_VAL
-} Um_opcode;
+/* Opcode of a cached instruction that still has to be decoded, one past
+the 16 that fit in an instruction so that it has a dispatch slot of its own */
+#define UNDECODED 16
 
-/* Struct that stores the unpacked values of a load value instruction */
-struct loadInstruction 
+/* Slots of the specialized engine's handler table: 0 decodes, then one per
+opcode and register triple (the register of a LOAD_VAL stands in for A), 
+then one for invalid opcodes */
+#define SPECIAL_UNDECODED 0
+#define SPECIAL_INDEX(opcode, a, b, c) \
+        (1 + ((opcode) << 9 | (a) << 6 | (b) << 3 | (c)))
+#define SPECIAL_INVALID SPECIAL_INDEX(16, 0, 0, 0)
+
+/* Struct that stores the unpacked values of an instruction; value is only
+used by load value, handler only by the specialized engine, and idiom 
+(an idiomKind) tells whether a loop starts here */
+struct decodedInstruction 
 {
-        int ra; 
+        uint8_t opcode; 
+        uint8_t ra, rb, rc;
+        uint16_t handler;
+        uint8_t idiom;
         uint32_t value;
 };
 
-/* Struct that stores the unpacked values of any instruction that is not
-load value */
-struct generalInstruction 
+/* Version of the decoded instructions kept in a code cache. It follows
+the layout of the handler table, the idiom kinds and the size of a record
+by itself; CODE_FORMAT is bumped for any other change in what a record
+means. */
+#define CODE_FORMAT 1
+#define CODE_VERSION ((uint32_t) CODE_FORMAT << 24 ^                    \
+                      (uint32_t) SPECIAL_INVALID << 8 ^                 \
+                      (uint32_t) IDIOM_COMPARE << 4 ^                   \
+                      (uint32_t) sizeof(struct decodedInstruction))
+
+/* What a SEG_LOAD or SEG_STORE remembers of the last segment it used. 
+Segment 0 only changes with the code, which starts new sites, so an entry 
+for segment 0 is always valid and every site starts out as one; any other 
+entry is valid while generation matches the context's, which MAP and UNMAP
+advance. */
+typedef struct segmentSite
+{
+        Segment segment;
+        uint32_t identifier;
+        uint32_t generation;
+} *segmentSite;
+
+/* Hits and misses of the segment sites during one run() */
+typedef struct siteCounters
+{
+        uint64_t hits;
+        uint64_t misses;
+} siteCounters;
+
+/* How many block boundaries pass between two looks at the wall clock */
+#define CLOCK_POLL_INTERVAL 4096
+
+/* Instructions between two updates of the live statistics page, a few
+times a second at the speed of the engines */
+#define LIVE_STATS_INTERVAL (1u << 24)
+
+/* Struct that holds the state of one running program and its limits */
+struct executionContext
 {
-        uint32_t opcode; 
-        int ra, rb, rc;
+        Seq_T registers;
+        segmentTable segments;
+        uint32_t pc;
+        executionStatus status;
+
+        /* decoded copy of segment 0, filled in as instructions execute 
+        unless it came from the code cache in cache_directory, in which 
+        case code_mapping is the size of its mapping */
+        decodedInstruction code;
+        uint32_t code_length;
+        const char *cache_directory;
+        size_t code_mapping;
+        bool barrier;
+        executionEngine engine;
+
+        /* whether HCALL and RESIZE are valid instructions */
+        bool extensions;
+
+        /* one segment site per word of segment 0, and the generation that
+        makes them valid */
+        struct segmentSite *sites;
+        uint32_t generation;
+        uint64_t site_hits;
+        uint64_t site_misses;
+
+        /* instructions retired so far, the count at which to stop, and 
+        the count at which limitReached next has something to do */
+        uint64_t instructions;
+        uint64_t instruction_limit;
+        uint64_t instruction_check;
+
+        /* instructions between two packings of cold segments, 0 if they 
+        are never packed, and the count at which to pack next */
+        uint64_t pack_interval;
+        uint64_t next_pack;
+
+        /* the page of --live-stats or NULL, and the count at which to
+        update it next */
+        liveStats live;
+        uint64_t next_publish;
+
+        /* the heat map of --heatmap or NULL, and the count at which its
+        next window starts */
+        heatMap heat;
+        uint64_t next_heat;
+
+        /* the command latencies of --latency, or NULL */
+        latencyTracker latency;
+
+        /* wall clock allowance of a single run(), 0 if unlimited */
+        double timeout;
+
+        /* where INPUT reads and OUTPUT writes, and the bytes INPUT has
+        read so far */
+        FILE *input;
+        FILE *output;
+        uint64_t input_bytes;
+
+        /* LOAD_PROGRAMs executed, bytes OUTPUT has written, and when it
+        wrote the first (on the monotonic clock) */
+        uint64_t jumps;
+        uint64_t output_bytes;
+        double first_output;
+
+        /* with countOpcodes, how many blocks started at each word of
+        segment 0 since the last foldEntries, what the blocks folded so
+        far executed by opcode, and what bulk loops retired */
+        uint64_t *entries;
+        uint64_t opcode_counts[16];
+        uint64_t idiom_instructions;
+
+        /* a report asked for by requestReport, made at the next block
+        boundary */
+        volatile sig_atomic_t report_requested;
+        reportCallback report;
+        void *report_closure;
 };
 
-/******************************** execute() *******************************
- *  Purpose: Executes the instructions of the entire program.
- *  Parameters: Seq_T segment_0: the 0th segment representing all the
-                                 instructions of a program, created with
-                                by the functions in fetcher.c
+/**************************** decodeInstruction() ****************************
+ *  Purpose: Unpacks a 32 bit instruction into a struct containing the
+ *           unbitpacked information
+ *  Parameters: uint32_t instruction: a universal machine instruction
+ *              decodedInstruction decoded: where to store the information
  *  Returns: None
- *  Effects: Takes in a segment created by fetcher.c and calls functions from
- *           bitpack, instructionSet, memory, Hanson sequence, and register
- *           modules
- *  Expects: segment_0 must exist, keeps running until halt instruction or end
- *           of file is reached
+ *  Effects: Uses the shift and mask decoders of isa.h
+ *  Expects: instruction must be packed in the correct manner
  ***********************************************************************/
-void execute(Seq_T segment_0)
+static void decodeInstruction(uint32_t instruction, 
+                              decodedInstruction decoded)
 {
-        /* necessary data items initialized */
-        uint32_t pc = 0;
-        Seq_T registers = createRegisters();
-        Seq_T mapped_segments = Seq_new(0);
-        Seq_T unmapped_identifiers = Seq_new(0);
-        addSegToMemory(mapped_segments, segment_0);
-        bool executing = true;
-
-        /* Continues to execute until halt instruction is reached */
-        while (executing) {
-                uint32_t instruction = getWord(
-                                       getSegment(mapped_segments, 0), pc);
-                int opcode = Bitpack_getu(instruction, 4, 28);
-                
-                loadInstruction loadInfo;
-                generalInstruction genInfo;
-                if (opcode == 13) {
-                        loadInfo = unpackLoad(instruction);
+        decoded->opcode = Um_opcodeOf(instruction);
+        if (decoded->opcode == LOAD_VAL) {
+                decoded->ra = Um_lvRegister(instruction);
+                decoded->value = Um_lvValue(instruction);
+                decoded->handler = SPECIAL_INDEX(LOAD_VAL, decoded->ra, 0, 0);
+        } else if (decoded->opcode < UM_OPCODE_COUNT) {
+                decoded->ra = Um_ra(instruction);
+                decoded->rb = Um_rb(instruction);
+                decoded->rc = Um_rc(instruction);
+                decoded->handler = SPECIAL_INDEX(decoded->opcode, decoded->ra,
+                                                 decoded->rb, decoded->rc);
+        } else {
+                decoded->handler = SPECIAL_INVALID;
+        }
+}
+
+/***************************** forgetCode() *****************************
+ *  Purpose: Invalidates cached instructions after segment 0 was written
+ *  Parameters: void *closure: the executionContext whose cache is stale
+ *              uint32_t first: index of the first word written
+ *              uint32_t count: number of words to invalidate
+ *  Returns: None
+ *  Effects: Marks the instructions to be decoded again. Called for single
+ *           stores by run(), or for whole pages by the write barrier.
+ *  Expects: first + count must be within segment 0
+ ***********************************************************************/
+static void forgetCode(void *closure, uint32_t first, uint32_t count)
+{
+        executionContext context = closure;
+        for (uint32_t i = first; i < first + count; i++) {
+                context->code[i].opcode = UNDECODED;
+                context->code[i].handler = SPECIAL_UNDECODED;
+                context->code[i].idiom = IDIOM_UNKNOWN;
+        }
+}
+
+/***************************** forgetSites() *****************************
+ *  Purpose: Empties every segment site
+ *  Parameters: executionContext context: the context whose sites to empty
+ *  Returns: None
+ *  Effects: Points each site at segment 0, which needs no generation
+ *  Expects: context->sites must cover the current segment 0
+ ***********************************************************************/
+static void forgetSites(executionContext context)
+{
+        Segment segment_0 = getSegment(context->segments, 0);
+        for (uint32_t i = 0; i <= context->code_length; i++) {
+                context->sites[i].segment = segment_0;
+                context->sites[i].identifier = 0;
+                context->sites[i].generation = 0;
+        }
+}
+
+/****************************** releaseCode() ******************************
+ *  Purpose: Frees the decoded copy of segment 0, or unmaps it if it came
+ *           from the code cache
+ *  Parameters: executionContext context: the context whose copy to free
+ *  Returns: None
+ ***********************************************************************/
+static void releaseCode(executionContext context)
+{
+        if (context->code_mapping != 0) {
+                codeCacheUnmap(context->code, context->code_mapping);
+        } else {
+                free(context->code);
+        }
+        context->code = NULL;
+        context->code_mapping = 0;
+}
+
+/****************************** resetCode() ******************************
+ *  Purpose: Starts a fresh, empty cache of decoded instructions and empty
+ *           segment sites for the current segment 0
+ *  Parameters: executionContext context: the context whose segment 0 was
+ *                                        just created or replaced
+ *  Returns: None
+ *  Effects: Reallocates the cache, the sites and any block counts. 
+ *           With a code cache directory (and no write barrier, which
+ *           forgets everything at each run anyway) the decoded copy is
+ *           mapped from the directory when this image was seen before,
+ *           and is otherwise decoded in full and kept there if the
+ *           directory wants it (or left to decode as it runs if not).
+ *  Expects: context must exist
+ ***********************************************************************/
+static void resetCode(executionContext context)
+{
+        Segment segment_0 = getSegment(context->segments, 0);
+        size_t size = (size_t) (segment_0->length + 1) * 
+                      sizeof(struct decodedInstruction);
+        bool cached = context->cache_directory != NULL && !context->barrier;
+        bool keep = false;
+        releaseCode(context);
+        context->code_length = segment_0->length;
+        if (cached) {
+                context->code = codeCacheMap(context->cache_directory,
+                                             segment_0->words,
+                                             segment_0->length, size,
+                                             CODE_VERSION, &keep,
+                                             &context->code_mapping);
+        }
+        if (context->code == NULL) {
+                context->code = malloc(size);
+                assert(context->code != NULL);
+                if (keep) {
+                        memset(context->code, 0, size);
+                        for (uint32_t i = 0; i < segment_0->length; i++) {
+                                decodeInstruction(segment_0->words[i], 
+                                                  &context->code[i]);
+                        }
+                        codeCacheStore(context->cache_directory, 
+                                       segment_0->words, segment_0->length,
+                                       context->code, size, CODE_VERSION);
                 } else {
-                        genInfo = unpackGeneral(instruction);
+                        forgetCode(context, 0, segment_0->length);
+                }
+        }
+
+        free(context->sites);
+        context->sites = malloc((size_t) (segment_0->length + 1) * 
+                                sizeof(struct segmentSite));
+        assert(context->sites != NULL);
+        forgetSites(context);
+
+        if (context->entries != NULL) {
+                free(context->entries);
+                context->entries = calloc((size_t) segment_0->length + 1,
+                                          sizeof(uint64_t));
+                assert(context->entries != NULL);
+        }
+}
+
+/***************************** replaceCode() *****************************
+ *  Purpose: Follows a LOAD_PROGRAM that replaced segment 0
+ *  Parameters: executionContext context: the running context
+ *  Returns: None
+ *  Effects: Starts a new cache for the new segment 0 and, under the write
+ *           barrier, protects it instead of the old one
+ *  Expects: barrierDetach() was called before the old segment was freed
+ ***********************************************************************/
+static void replaceCode(executionContext context)
+{
+        resetCode(context);
+        if (context->barrier) {
+                barrierAttach(getSegment(context->segments, 0),
+                              forgetCode, context);
+        }
+}
+
+/***************************** startClock() *****************************
+ *  Purpose: Starts the timeout of a call to run()
+ *  Parameters: executionContext context: the context about to run
+ *  Returns: the time at which to stop, or 0 if there is no timeout
+ ***********************************************************************/
+static double startClock(executionContext context)
+{
+        return context->timeout > 0 ?
+               clockNow(CLOCK_MONOTONIC) + context->timeout : 0;
+}
+
+/**************************** scheduleCheck() ****************************
+ *  Purpose: Sets the count at which limitReached next looks at the
+ *           instruction limit, the packing of cold segments, the live
+ *           statistics, the heat map's windows and requested reports
+ *  Parameters: executionContext context: the context
+ *  Returns: None
+ ***********************************************************************/
+static void scheduleCheck(executionContext context)
+{
+        uint64_t check = context->instruction_limit;
+        if (context->next_pack < check) {
+                check = context->next_pack;
+        }
+        if (context->next_publish < check) {
+                check = context->next_publish;
+        }
+        if (context->next_heat < check) {
+                check = context->next_heat;
+        }
+        context->instruction_check = check;
+
+        /* a request that arrived while check was worked out */
+        if (context->report_requested) {
+                context->instruction_check = 0;
+        }
+}
+
+/******************************* packCold() *******************************
+ *  Purpose: Packs the segments not used since the last packing
+ *  Parameters: executionContext context: a context with packing enabled
+ *              uint64_t instructions: instructions retired so far
+ *  Returns: None
+ *  Effects: Empties the segment sites, both because packed segments move
+ *           and so that every segment still in use is looked up, and so 
+ *           marked as used, in the next period
+ ***********************************************************************/
+static void packCold(executionContext context, uint64_t instructions)
+{
+        packColdSegments(context->segments);
+        forgetSites(context);
+        context->next_pack = 
+                instructions < UINT64_MAX - context->pack_interval ?
+                instructions + context->pack_interval : UINT64_MAX;
+        scheduleCheck(context);
+}
+
+/***************************** publishLive() *****************************
+ *  Purpose: Updates the live statistics page of a context
+ *  Parameters: executionContext context: a context with a page
+ *              uint64_t instructions: instructions retired so far
+ *  Returns: None
+ *  Effects: Schedules the next update
+ ***********************************************************************/
+static void publishLive(executionContext context, uint64_t instructions)
+{
+        memoryUsage usage = &context->segments->usage;
+        struct liveCounters counters = {
+                instructions, usage->segments, usage->words, usage->maps,
+                usage->unmaps, context->jumps, context->input_bytes,
+                context->output_bytes
+        };
+        publishLiveStats(context->live, &counters, 
+                         statusName(context->status));
+        context->next_publish = 
+                instructions < UINT64_MAX - LIVE_STATS_INTERVAL ?
+                instructions + LIVE_STATS_INTERVAL : UINT64_MAX;
+        scheduleCheck(context);
+}
+
+/***************************** advanceHeat() *****************************
+ *  Purpose: Starts the windows of the heat map the program has reached
+ *  Parameters: executionContext context: a context with a heat map
+ *              uint64_t instructions: instructions retired so far
+ *  Returns: None
+ *  Effects: Schedules the start of the next window
+ ***********************************************************************/
+static void advanceHeat(executionContext context, uint64_t instructions)
+{
+        while (instructions >= context->next_heat) {
+                heatNextWindow(context->heat);
+                context->next_heat += HEAT_WINDOW;
+        }
+        scheduleCheck(context);
+}
+
+/****************************** makeReport() ******************************
+ *  Purpose: Makes the report requestReport asked for
+ *  Parameters: executionContext context: the running context
+ *              uint64_t instructions: instructions retired so far
+ *              uint32_t pc: where the next block starts
+ *  Returns: None
+ *  Effects: Calls the report callback with the counts as they stand; the
+ *           block about to start at pc is left out of them until the 
+ *           callback returns
+ ***********************************************************************/
+static void makeReport(executionContext context, uint64_t instructions,
+                       uint32_t pc)
+{
+        context->report_requested = 0;
+        scheduleCheck(context);
+        if (context->report == NULL) {
+                return;
+        }
+        context->instructions = instructions;
+        if (context->entries != NULL) {
+                context->entries[pc]--;
+        }
+        context->report(context->report_closure, context);
+        if (context->entries != NULL) {
+                context->entries[pc]++;
+        }
+}
+
+/**************************** limitReached() ****************************
+ *  Purpose: Enforces the limits of a context at a block boundary
+ *  Parameters: executionContext context: the running context
+ *              uint64_t instructions: instructions retired so far
+ *              uint32_t pc: where the next block starts
+ *              double deadline: as returned by startClock
+ *              int *clock_countdown: boundaries left before the clock is
+ *                                    read again
+ *  Returns: true if the program must stop, with context->status saying 
+ *           why
+ *  Effects: Reads the clock once every CLOCK_POLL_INTERVAL calls, and 
+ *           packs cold segments, updates the live statistics and starts
+ *           windows of the heat map when they are due, and makes a 
+ *           report asked for by requestReport
+ ***********************************************************************/
+static inline bool limitReached(executionContext context, 
+                                uint64_t instructions, uint32_t pc,
+                                double deadline, int *clock_countdown)
+{
+        if (instructions >= context->instruction_check) {
+                if (instructions >= context->instruction_limit) {
+                        context->status = EXECUTION_INSTRUCTION_LIMIT;
+                        return true;
+                }
+                if (instructions >= context->next_pack) {
+                        packCold(context, instructions);
+                }
+                if (instructions >= context->next_publish) {
+                        publishLive(context, instructions);
+                }
+                if (instructions >= context->next_heat) {
+                        advanceHeat(context, instructions);
+                }
+                if (context->report_requested) {
+                        makeReport(context, instructions, pc);
+                }
+        } else if (deadline > 0 && --*clock_countdown == 0) {
+                *clock_countdown = CLOCK_POLL_INTERVAL;
+                if (clockNow(CLOCK_MONOTONIC) >= deadline) {
+                        context->status = EXECUTION_TIMEOUT;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/**************************** siteSegment() ****************************
+ *  Purpose: Finds the segment a SEG_LOAD or SEG_STORE accesses, through 
+ *           the site of that instruction
+ *  Parameters: segmentSite site: the site of the instruction
+ *              segmentTable segments: the segments of the program
+ *              uint32_t identifier: the segment accessed
+ *              uint32_t generation: the current generation
+ *              siteCounters *counters: counts the hit or miss
+ *  Returns: the segment
+ *  Effects: On a miss, looks the segment up and remembers it in site
+ *  Expects: identifier must be mapped
+ ***********************************************************************/
+static inline Segment siteSegment(segmentSite site, segmentTable segments,
+                                  uint32_t identifier, uint32_t generation,
+                                  siteCounters *counters)
+{
+        if (site->identifier == identifier && 
+            (identifier == 0 || site->generation == generation)) {
+                counters->hits++;
+                return site->segment;
+        }
+        counters->misses++;
+        site->segment = getSegment(segments, identifier);
+        site->identifier = identifier;
+        site->generation = generation;
+        return site->segment;
+}
+
+/**************************** nextGeneration() ****************************
+ *  Purpose: Invalidates every segment site after a MAP or UNMAP
+ *  Parameters: executionContext context: the running context
+ *              uint32_t generation: the current generation
+ *  Returns: the new generation
+ *  Effects: When the counter wraps, empties the sites as well, so that 
+ *           an entry from 2^32 generations ago cannot match
+ ***********************************************************************/
+static inline uint32_t nextGeneration(executionContext context, 
+                                      uint32_t generation)
+{
+        if (++generation == 0) {
+                forgetSites(context);
+                generation = 1;
+        }
+        return generation;
+}
+
+/******************************* wordAt() *******************************
+ *  Purpose: SEG_LOAD and SEG_STORE on a segment found by siteSegment
+ *  Parameters: Segment segment: the segment accessed
+ *              uint32_t offset: the word to access
+ *              uint32_t value: for storeWordAt, the value to store
+ *              bool checked: false when guard pages check the offset
+ *  Returns: for wordAt, the word
+ *  Effects: With guard pages, an offset beyond the reach of the segment's
+ *           guard (or of a segment that has none) is still checked
+ *  Expects: segment must exist
+ ***********************************************************************/
+static inline uint32_t wordAt(Segment segment, uint32_t offset, bool checked)
+{
+        return checked || offset >= segment->reach ? getWord(segment, offset)
+                                                   : segment->words[offset];
+}
+
+static inline void storeWordAt(Segment segment, uint32_t offset, 
+                               uint32_t value, bool checked)
+{
+        if (checked || offset >= segment->reach) {
+                setWord(segment, offset, value);
+        } else {
+                segment->words[offset] = value;
+        }
+}
+
+/****************************** readByte() ******************************
+ *  Purpose: INPUT on register values
+ *  Parameters: executionContext context: the running context
+ *              uint64_t retired: instructions retired before this one,
+ *                                for the latency tracker
+ *  Returns: the next byte of its input, or all ones at the end of input
+ *  Effects: Counts the byte, so that a checkpoint knows how much input
+ *           was consumed
+ ***********************************************************************/
+static inline uint32_t readByte(executionContext context, uint64_t retired)
+{
+        if (context->latency != NULL) {
+                latencyWaiting(context->latency, retired);
+        }
+        int byte = getc(context->input);
+        if (context->latency != NULL) {
+                latencyRead(context->latency, byte, retired + 1);
+        }
+        if (byte == EOF) {
+                UM_PROBE2(input, ~(uint32_t) 0, context->input_bytes);
+                return ~(uint32_t) 0;
+        }
+        context->input_bytes++;
+        UM_PROBE2(input, byte, context->input_bytes);
+        return (uint32_t) byte;
+}
+
+/****************************** writeByte() ******************************
+ *  Purpose: OUTPUT on register values
+ *  Parameters: executionContext context: the running context
+ *              uint32_t byte: the byte, at most 255
+ *  Returns: None
+ *  Effects: Counts the byte
+ ***********************************************************************/
+static inline void writeByte(executionContext context, uint32_t byte)
+{
+        UM_PROBE1(output, byte);
+        if (context->output_bytes++ == 0) {
+                context->first_output = clockNow(CLOCK_MONOTONIC);
+        }
+        if (context->latency != NULL) {
+                latencyOutput(context->latency);
+        }
+        putc(byte, context->output);
+}
+
+/****************************** hypercall() ******************************
+ *  Purpose: HCALL on register values
+ *  Parameters: executionContext context: the running context
+ *              uint32_t operation: an Um_hypercall
+ *              uint32_t block, offset: the segment and offset of its 
+ *                                      operands, see isa.h
+ *  Returns: None
+ *  Effects: Copies or fills the words in bulk; words written into segment
+ *           0 are forgotten by the code cache, by hand or, under the 
+ *           write barrier, by its fault handler
+ *  Expects: operation must be known, and the operands and every word
+ *           they name must be inside their segments
+ ***********************************************************************/
+static void hypercall(executionContext context, uint32_t operation,
+                      uint32_t block, uint32_t offset)
+{
+        segmentTable segments = context->segments;
+        Segment operands = getSegment(segments, block);
+        uint32_t target, target_offset, count;
+        if (operation == UM_HCALL_COPY) {
+                assert((uint64_t) offset + 5 <= operands->length);
+                uint32_t *word = operands->words + offset;
+                target = word[0];
+                target_offset = word[1];
+                count = word[4];
+                copyWords(segments, target, target_offset, word[2],
+                          word[3], count);
+        } else if (operation == UM_HCALL_FILL) {
+                assert((uint64_t) offset + 4 <= operands->length);
+                uint32_t *word = operands->words + offset;
+                target = word[0];
+                target_offset = word[1];
+                count = word[3];
+                fillWords(segments, target, target_offset, word[2],
+                          count);
+        } else {
+                fprintf(stderr, "Not a valid hypercall\n");
+                exit(EXIT_FAILURE);
+        }
+        if (target == 0 && !context->barrier) {
+                forgetCode(context, target_offset, count);
+        }
+}
+
+/******************************* growth() *******************************
+ *  Purpose: Finds the memory a RESIZE asks for
+ *  Parameters: segmentTable segments: the segments of the program
+ *              uint32_t identifier: the segment to resize
+ *              uint32_t length: its new number of words
+ *  Returns: how many words the segment grows by, 0 if it shrinks or does
+ *           not exist (which resizeSegment then reports)
+ ***********************************************************************/
+static uint32_t growth(segmentTable segments, uint32_t identifier,
+                       uint32_t length)
+{
+        if (!segmentMapped(segments, identifier)) {
+                return 0;
+        }
+        uint32_t old_length = segments->lengths[identifier];
+        return length > old_length ? length - old_length : 0;
+}
+
+/***************************** foldEntries() *****************************
+ *  Purpose: Turns the block starts counted since the last call into 
+ *           counts of the opcodes executed
+ *  Parameters: executionContext context: a context counting opcodes
+ *  Returns: None
+ *  Effects: Empties entries. A word runs once for each block started at
+ *           it or at an earlier word the block runs straight into, since
+ *           only LOAD_PROGRAM (and HALT) end a block, so one pass over 
+ *           segment 0 suffices. A run that stops in the middle of a block
+ *           takes back the start at the word it stops at (see run()).
+ *  Expects: segment 0 is the code the entries were counted on
+ ***********************************************************************/
+static void foldEntries(executionContext context)
+{
+        uint64_t *entries = context->entries;
+        if (entries == NULL) {
+                return;
+        }
+        const uint32_t *words = getSegment(context->segments, 0)->words;
+        uint64_t running = 0;
+        for (uint32_t i = 0; i < context->code_length; i++) {
+                running += entries[i];
+                entries[i] = 0;
+                if (running == 0) {
+                        continue;
+                }
+                unsigned opcode = Um_opcodeOf(words[i]);
+                context->opcode_counts[opcode] += running;
+                if (opcode == LOAD_PROGRAM || opcode == HALT) {
+                        running = 0;
+                }
+        }
+}
+
+/****************************** countLoop() ******************************
+ *  Purpose: Counts what a loop run in bulk executed as the interpreter
+ *           would have
+ *  Parameters: executionContext context: the running context
+ *              const uint32_t *words: segment 0
+ *              uint32_t head: the loop's first word
+ *              uint32_t loop_length: its number of words
+ *              uint64_t retired: the instructions it retired, going 
+ *                                through its words in order
+ *  Returns: the iterations begun, the last perhaps cut short
+ *  Effects: Adds the LOAD_PROGRAMs executed to the jumps and, with 
+ *           countOpcodes, every instruction to the counts of its opcode
+ ***********************************************************************/
+static uint64_t countLoop(executionContext context, const uint32_t *words,
+                          uint32_t head, uint32_t loop_length,
+                          uint64_t retired)
+{
+        uint64_t passes = retired / loop_length;
+        uint64_t rest = retired % loop_length;
+        for (uint32_t i = 0; i < loop_length; i++) {
+                uint64_t runs = passes + (i < rest ? 1 : 0);
+                unsigned opcode = Um_opcodeOf(words[head + i]);
+                if (opcode == LOAD_PROGRAM) {
+                        context->jumps += runs;
                 }
-                
-                switch (opcode) {
-                        
-                        case COND_MOV:
-                        conditionalMove(registers, genInfo->ra,
-                                                   genInfo->rb, 
-                                                   genInfo->rc);
+                if (context->entries != NULL) {
+                        context->opcode_counts[opcode] += runs;
+                }
+        }
+        return passes + (rest != 0 ? 1 : 0);
+}
+
+/******************************* runLoop() *******************************
+ *  Purpose: Runs the copy, fill or compare loop starting at a LOAD_PROGRAM
+ *           target in bulk, if there is one
+ *  Parameters: executionContext context: the running context
+ *              uint32_t *pc: the target; moved past the loop
+ *              uint32_t r[8]: the registers
+ *              uint64_t *instructions: instructions retired so far, 
+ *                                      increased by those of the loop
+ *  Returns: true if the loop was run, never with a heat map
+ *  Effects: Remembers in the decoded instruction whether a loop starts 
+ *           at *pc; runIdiom checks the words again before each run, so
+ *           this never goes stale in a way that matters. Counts the 
+ *           loop's jumps and opcodes as if it had been interpreted, and
+ *           fires um:bulk__loop with the iterations it ran.
+ *  Expects: the instruction limit was not reached
+ ***********************************************************************/
+static bool runLoop(executionContext context, uint32_t *pc, uint32_t r[8],
+                    uint64_t *instructions)
+{
+        uint32_t head = *pc;
+        if (context->heat != NULL) {
+                return false;
+        }
+        decodedInstruction instruction = &context->code[head];
+        Segment segment_0 = getSegment(context->segments, 0);
+        if (instruction->idiom == IDIOM_UNKNOWN) {
+                instruction->idiom = findIdiom(segment_0->words, 
+                                               segment_0->length, *pc);
+        }
+        if (instruction->idiom == IDIOM_NONE) {
+                return false;
+        }
+        uint32_t loop_length;
+        uint64_t retired = runIdiom(segment_0->words, segment_0->length, pc,
+                                    r, context->segments,
+                                    context->instruction_limit - 
+                                    *instructions, &loop_length);
+        if (retired == 0) {
+                return false;
+        }
+        *instructions += retired;
+        UM_PROBE2(bulk__loop, head, countLoop(context, segment_0->words, head,
+                                              loop_length, retired));
+        if (context->entries != NULL) {
+                /* countLoop counted the loop; the block resumes after it */
+                context->entries[head]--;
+                context->entries[*pc]++;
+                context->idiom_instructions += retired;
+        }
+        return true;
+}
+
+/****************************** newContext() ******************************
+ *  Purpose: Creates a context ready to execute a program from its first
+ *           instruction, with no limits placed on it
+ *  Parameters: Segment segment_0: the 0th segment representing all the
+ *                               instructions of a program, created with
+ *                               by the functions in fetcher.c
+ *  Returns: a new executionContext which owns segment_0
+ *  Effects: Mallocs space for the context, its registers and its memory
+ *  Expects: segment_0 must exist
+ ***********************************************************************/
+executionContext newContext(Segment segment_0)
+{
+        assert(segment_0 != NULL);
+        executionContext context = malloc(sizeof(struct executionContext));
+        assert(context);
+
+        context->registers = createRegisters();
+        context->segments = newSegmentTable(segment_0);
+        context->pc = 0;
+        context->status = EXECUTION_RUNNING;
+        context->instructions = 0;
+        context->instruction_limit = UINT64_MAX;
+        context->instruction_check = UINT64_MAX;
+        context->pack_interval = 0;
+        context->next_pack = UINT64_MAX;
+        context->live = NULL;
+        context->next_publish = UINT64_MAX;
+        context->heat = NULL;
+        context->next_heat = UINT64_MAX;
+        context->latency = NULL;
+        context->timeout = 0;
+        context->input = stdin;
+        context->output = stdout;
+        context->input_bytes = 0;
+        context->jumps = 0;
+        context->output_bytes = 0;
+        context->first_output = 0;
+        context->entries = NULL;
+        memset(context->opcode_counts, 0, sizeof(context->opcode_counts));
+        context->idiom_instructions = 0;
+        context->report_requested = 0;
+        context->report = NULL;
+        context->report_closure = NULL;
+        context->code = NULL;
+        context->cache_directory = NULL;
+        context->code_mapping = 0;
+        context->barrier = segment_0->paged && writeBarrierEnabled();
+        context->engine = ENGINE_THREADED;
+        context->extensions = false;
+        context->sites = NULL;
+        context->generation = 1;
+        context->site_hits = 0;
+        context->site_misses = 0;
+        resetCode(context);
+
+        return context;
+}
+
+/************************* setInstructionBudget() *************************
+ *  Purpose: Limits how many more instructions a context may execute
+ *  Parameters: executionContext context: the context to limit
+ *              uint64_t budget: instructions allowed from now on, or 0 to
+ *                               remove the limit
+ *  Returns: None
+ *  Effects: The budget is enforced at block boundaries (LOAD_PROGRAM), so
+ *           run() may retire the rest of the current block before it stops
+ *  Expects: context must exist
+ ***********************************************************************/
+void setInstructionBudget(executionContext context, uint64_t budget)
+{
+        assert(context != NULL);
+        if (budget == 0 || budget > UINT64_MAX - context->instructions) {
+                context->instruction_limit = UINT64_MAX;
+        } else {
+                context->instruction_limit = context->instructions + budget;
+        }
+        scheduleCheck(context);
+}
+
+/************************** setColdCompression() **************************
+ *  Purpose: Has a context compress the segments its program stops using
+ *  Parameters: executionContext context: the context to configure
+ *              uint64_t interval: instructions between two packings; a 
+ *                                 segment is packed when it was not used
+ *                                 during a whole interval
+ *  Returns: None
+ *  Effects: Packing happens at block boundaries, like the limits. A 
+ *           packed segment is unpacked by the next instruction that uses
+ *           it, so programs behave the same, only slower when a segment
+ *           they return to has to be unpacked.
+ *  Expects: context must exist and interval must not be 0
+ ***********************************************************************/
+void setColdCompression(executionContext context, uint64_t interval)
+{
+        assert(context != NULL && interval != 0);
+        enablePacking(context->segments);
+        context->pack_interval = interval;
+        context->next_pack = 
+                context->instructions < UINT64_MAX - interval ?
+                context->instructions + interval : UINT64_MAX;
+        scheduleCheck(context);
+}
+
+/***************************** setLiveStats() *****************************
+ *  Purpose: Makes the executor keep a live statistics page up to date
+ *  Parameters: executionContext context: the context
+ *              liveStats stats: the page, which the caller closes after
+ *                               the context is done with it
+ *  Returns: None
+ *  Effects: The page is updated when run() starts and stops, and every
+ *           LIVE_STATS_INTERVAL instructions in between (at a block
+ *           boundary)
+ *  Expects: context and stats must exist
+ ***********************************************************************/
+void setLiveStats(executionContext context, liveStats stats)
+{
+        assert(context != NULL && stats != NULL);
+        context->live = stats;
+        context->next_publish = context->instructions;
+        scheduleCheck(context);
+}
+
+/****************************** setHeatMap() ******************************
+ *  Purpose: Makes the executor record every SEG_LOAD and SEG_STORE in a
+ *           heat map
+ *  Parameters: executionContext context: the context
+ *              heatMap heat: the heat map, which the caller frees after
+ *                            the context is done with it
+ *  Returns: None
+ *  Effects: Windows start every HEAT_WINDOW instructions from now, at a
+ *           block boundary. The copy, fill and compare loops are no 
+ *           longer run in bulk, so that each of their accesses is seen.
+ *  Expects: context and heat must exist
+ ***********************************************************************/
+void setHeatMap(executionContext context, heatMap heat)
+{
+        assert(context != NULL && heat != NULL);
+        context->heat = heat;
+        context->next_heat = 
+                context->instructions < UINT64_MAX - HEAT_WINDOW ?
+                context->instructions + HEAT_WINDOW : UINT64_MAX;
+        scheduleCheck(context);
+}
+
+/************************** setLatencyTracker() **************************
+ *  Purpose: Makes the executor tell a latency tracker about every INPUT
+ *           and OUTPUT
+ *  Parameters: executionContext context: the context
+ *              latencyTracker tracker: the tracker, which the caller frees
+ *                                      after the context is done with it
+ *  Returns: None
+ *  Effects: The command in progress when the program halts ends there
+ *  Expects: context and tracker must exist
+ ***********************************************************************/
+void setLatencyTracker(executionContext context, latencyTracker tracker)
+{
+        assert(context != NULL && tracker != NULL);
+        context->latency = tracker;
+}
+
+/***************************** countOpcodes() *****************************
+ *  Purpose: Makes a context count the instructions it executes by opcode
+ *  Parameters: executionContext context: the context
+ *  Returns: None
+ *  Effects: The engines count how many blocks start at each word of 
+ *           segment 0, a store per LOAD_PROGRAM, and the counts are 
+ *           turned into opcodes only when read or when segment 0 is 
+ *           replaced. Words a program stores into its own segment 0 are
+ *           counted as the opcodes they hold when the counts are turned.
+ *  Expects: context must exist and not be running; one resumed from a
+ *           checkpoint counts from where it resumed
+ ***********************************************************************/
+void countOpcodes(executionContext context)
+{
+        assert(context != NULL);
+        if (context->entries == NULL) {
+                context->entries = calloc((size_t) context->code_length + 1,
+                                          sizeof(uint64_t));
+                assert(context->entries != NULL);
+        }
+}
+
+/************************** setReportCallback() **************************
+ *  Purpose: Says what requestReport calls
+ *  Parameters: executionContext context: the context
+ *              reportCallback report: called with closure and context, 
+ *                                     or NULL for nothing
+ *              void *closure: passed to report
+ *  Returns: None
+ *  Expects: context must exist
+ ***********************************************************************/
+void setReportCallback(executionContext context, reportCallback report,
+                       void *closure)
+{
+        assert(context != NULL);
+        context->report = report;
+        context->report_closure = closure;
+}
+
+/***************************** requestReport() *****************************
+ *  Purpose: Asks a running context to call its report callback
+ *  Parameters: executionContext context: the context
+ *  Returns: None
+ *  Effects: The callback runs at the next block boundary, where the 
+ *           accessors give a consistent picture. Safe to call from a 
+ *           signal handler.
+ *  Expects: context must exist
+ ***********************************************************************/
+void requestReport(executionContext context)
+{
+        context->report_requested = 1;
+        context->instruction_check = 0;
+}
+
+/****************************** setTimeout() ******************************
+ *  Purpose: Limits how long each call to run() may take
+ *  Parameters: executionContext context: the context to limit
+ *              double seconds: wall clock allowance, or 0 for no limit
+ *  Returns: None
+ *  Effects: The clock is read once every CLOCK_POLL_INTERVAL block
+ *           boundaries, never on the per-instruction path
+ *  Expects: context must exist and seconds must not be negative
+ ***********************************************************************/
+void setTimeout(executionContext context, double seconds)
+{
+        assert(context != NULL);
+        assert(seconds >= 0);
+        context->timeout = seconds;
+}
+
+/**************************** setMemoryLimit() ****************************
+ *  Purpose: Limits how much memory the segments of a context may take
+ *  Parameters: executionContext context: the context to limit
+ *              uint64_t bytes: the most the words of the segments, with
+ *                              the overhead of each segment, may take
+ *                              (see memoryBytes), or 0 for no limit
+ *  Returns: None
+ *  Effects: A MAP, or a RESIZE that grows a segment, that would go over
+ *           the limit stops run() with EXECUTION_MEMORY_LIMIT just before
+ *           the instruction, leaving the segments as they were
+ *  Expects: context must exist
+ ***********************************************************************/
+void setMemoryLimit(executionContext context, uint64_t bytes)
+{
+        assert(context != NULL);
+        context->segments->usage.limit = bytes;
+}
+
+/***************************** setStreams() *****************************
+ *  Purpose: Chooses where a program reads its input and writes its output
+ *  Parameters: executionContext context: the context to configure
+ *              FILE *input: read by INPUT instead of stdin
+ *              FILE *output: written by OUTPUT instead of stdout
+ *  Returns: None
+ *  Effects: None; the caller still owns and closes both streams
+ *  Expects: context, input and output must exist
+ ***********************************************************************/
+void setStreams(executionContext context, FILE *input, FILE *output)
+{
+        assert(context != NULL && input != NULL && output != NULL);
+        context->input = input;
+        context->output = output;
+}
+
+/***************************** setCodeCache() *****************************
+ *  Purpose: Keeps the decoded images of segment 0 in a directory, so that
+ *           later runs and LOAD_PROGRAMs of the same image skip decoding
+ *  Parameters: executionContext context: the context to configure
+ *              const char *directory: the code cache, see codecache.c
+ *  Returns: None
+ *  Effects: Starts over the decoded copy of the current segment 0 from 
+ *           the directory
+ *  Expects: context and directory must exist, and directory must outlive
+ *           the context
+ ***********************************************************************/
+void setCodeCache(executionContext context, const char *directory)
+{
+        assert(context != NULL && directory != NULL);
+        context->cache_directory = directory;
+        resetCode(context);
+}
+
+/**************************** setExtensions() ****************************
+ *  Purpose: Enables or disables the extension opcodes of isa.h
+ *  Parameters: executionContext context: the context to configure
+ *              bool enabled: if true, HCALL and RESIZE execute; otherwise
+ *                            they are invalid instructions, as in the
+ *                            Universal Machine
+ *  Returns: None
+ *  Expects: context must exist
+ ***********************************************************************/
+void setExtensions(executionContext context, bool enabled)
+{
+        assert(context != NULL);
+        context->extensions = enabled;
+}
+
+/****************************** setEngine() ******************************
+ *  Purpose: Chooses how run() executes instructions
+ *  Parameters: executionContext context: the context to configure
+ *              executionEngine engine: ENGINE_THREADED dispatches on the
+ *                                      opcode and reads operands from the
+ *                                      decoded instruction;
+ *                                      ENGINE_SPECIALIZED has a handler 
+ *                                      for each opcode and register triple
+ *  Returns: None
+ *  Effects: Both engines give the same results; they differ in speed
+ *  Expects: context must exist
+ ***********************************************************************/
+void setEngine(executionContext context, executionEngine engine)
+{
+        assert(context != NULL);
+        context->engine = engine;
+}
+
+/***************************** runThreaded() *****************************
+ *  Purpose: The ENGINE_THREADED implementation of run()
+ *  Parameters: executionContext context: the context to run
+ *  Returns: None, context->status tells why it stopped
+ *  Effects: Calls functions from isa, instructionSet, memory, Hanson
+ *           sequence, and register modules
+ *  Expects: context must exist and not have halted
+ ***********************************************************************/
+static void runThreaded(executionContext context)
+{
+        /* necessary data items initialized */
+        uint32_t pc = context->pc;
+        Seq_T registers = context->registers;
+        segmentTable segments = context->segments;
+        decodedInstruction code = context->code;
+        uint32_t code_length = context->code_length;
+        segmentSite sites = context->sites;
+        uint32_t generation = context->generation;
+        siteCounters counters = { 0, 0 };
+        bool extensions = context->extensions;
+        memoryUsage memory = &segments->usage;
+
+        /* with checkpoints, stores mark the pages they write; with a 
+        heat map, loads and stores are recorded in it */
+        bool tracking = segments->dirty != NULL;
+        heatMap heat = context->heat;
+
+        /* every jump goes in the flight recorder, and with countOpcodes 
+        each block start is counted */
+        flightRecorder flight = flightRecorderOf();
+        struct flightEntry *jump;
+        uint64_t *entries = context->entries;
+
+        /* with guard pages the hardware checks segment offsets */
+        bool checked = !guardPagesEnabled();
+        guardWatch(segments, &pc);
+
+        /* under the write barrier, stores to segment 0 are caught by the
+        fault handler; otherwise each store checks its target itself */
+        bool barrier = context->barrier;
+
+        /* the current block starts at block_start; limits are checked
+        when it ends */
+        uint32_t block_start = pc;
+        uint64_t instructions = context->instructions;
+        double deadline = startClock(context);
+        int clock_countdown = CLOCK_POLL_INTERVAL;
+
+        /* Threaded dispatch: every handler ends by jumping straight to the
+        handler of the next instruction. The table has a slot for each
+        opcode of UM_ISA and UNDECODED. */
+        static void *const dispatch[UNDECODED + 1] = {
+#define UM_HANDLER(name, mnemonic, format) [name] = __extension__ &&do_##name,
+                UM_ISA(UM_HANDLER)
+#undef UM_HANDLER
+                [UNDECODED] = __extension__ &&do_decode
+        };
+        decodedInstruction instruction;
+#define DISPATCH()                                                      \
+        do {                                                            \
+                assert(pc < code_length);                               \
+                instruction = &code[pc];                                \
+                __extension__ ({ goto *dispatch[instruction->opcode]; });\
+        } while (0)
+#define NEXT()                                                          \
+        do {                                                            \
+                pc++;                                                   \
+                DISPATCH();                                             \
+        } while (0)
+
+        DISPATCH();
+
+        do_decode: {
+                uint32_t word = getSegment(segments, 0)->words[pc];
+                if (barrier && !barrierCache(pc)) {
+                        /* page left writable: don't cache */
+                        instruction = &code[code_length];
+                }
+                decodeInstruction(word, instruction);
+                __extension__ ({ goto *dispatch[instruction->opcode]; });
+        }
+
+        do_COND_MOV:
+        conditionalMove(registers, instruction->ra, instruction->rb, 
+                                   instruction->rc);
+        NEXT();
+
+        do_SEG_LOAD: {
+                uint32_t identifier = getRegister(registers, 
+                                                  instruction->rb);
+                uint32_t offset = getRegister(registers, instruction->rc);
+                Segment segment = siteSegment(&sites[pc], segments,
+                                              identifier, generation, 
+                                              &counters);
+                setRegister(registers, instruction->ra, 
+                            wordAt(segment, offset, checked));
+                if (heat != NULL) {
+                        heatRecord(heat, identifier, offset, false);
+                }
+        }
+        NEXT();
+
+        do_SEG_STORE: {
+                Segment segment = siteSegment(&sites[pc], segments,
+                                              getRegister(registers, 
+                                                          instruction->ra),
+                                              generation, &counters);
+                storeWordAt(segment, getRegister(registers, instruction->rb),
+                            getRegister(registers, instruction->rc), checked);
+                if (tracking) {
+                        markWritten(segments, 
+                                    getRegister(registers, instruction->ra),
+                                    getRegister(registers, instruction->rb));
+                }
+                if (heat != NULL) {
+                        heatRecord(heat, getRegister(registers, 
+                                                     instruction->ra),
+                                   getRegister(registers, instruction->rb),
+                                   true);
+                }
+        }
+        /* the store may invalidate this very instruction */
+        if (!barrier && getRegister(registers, instruction->ra) == 0) {
+                forgetCode(context, getRegister(registers, instruction->rb),
+                           1);
+        }
+        NEXT();
+
+        do_ADD:
+        add(registers, instruction->ra, instruction->rb, instruction->rc);
+        NEXT();
+
+        do_MULT:
+        multiply(registers, instruction->ra, instruction->rb, 
+                            instruction->rc);
+        NEXT();
+
+        do_DIV:
+        divide(registers, instruction->ra, instruction->rb, instruction->rc);
+        NEXT();
+
+        do_NAND: 
+        nand(registers, instruction->ra, instruction->rb, instruction->rc);
+        NEXT();
+
+        do_HALT:
+        instructions += pc - block_start + 1;
+        context->status = EXECUTION_HALTED;
+        goto stopped;
+
+        do_MAP:
+        if (!memoryAllows(memory, getRegister(registers, instruction->rc),
+                          1)) {
+                goto memory_limit;
+        }
+        mapSegment(registers, segments, instruction->rb, instruction->rc);
+        generation = nextGeneration(context, generation);
+        NEXT();
+
+        do_UNMAP:
+        unmapSegment(registers, segments, instruction->rc);
+        generation = nextGeneration(context, generation);
+        NEXT();
+
+        do_OUTPUT:
+        assert(getRegister(registers, instruction->rc) <= 255);
+        writeByte(context, getRegister(registers, instruction->rc));
+        NEXT();
+
+        do_INPUT:
+        setRegister(registers, instruction->rc, 
+                    readByte(context, instructions + pc - block_start));
+        NEXT();
+
+        do_LOAD_PROGRAM:
+        /* loadProgram sets pc itself, so there is no pc++ */
+        jump = flightSlot(flight);
+        jump->from = pc;
+        context->jumps++;
+        instructions += pc - block_start + 1;
+        if (getRegister(registers, instruction->rb) == 0) {
+                loadProgram(segments, registers, instruction->rb, 
+                            instruction->rc, &pc);
+        } else {
+                /* segment 0 is replaced: start a new cache */
+                if (entries != NULL) {
+                        foldEntries(context);
+                }
+                barrierDetach();
+                loadProgram(segments, registers, instruction->rb, 
+                            instruction->rc, &pc);
+                replaceCode(context);
+                code = context->code;
+                code_length = context->code_length;
+                sites = context->sites;
+                entries = context->entries;
+        }
+        block_start = pc;
+        if (entries != NULL) {
+                entries[pc]++;
+        }
+        jump->instructions = instructions;
+        jump->to = pc;
+        for (int i = 0; i < 8; i++) {
+                jump->registers[i] = getRegister(registers, i);
+        }
+
+        /* block boundary: enforce the limits */
+        if (limitReached(context, instructions, pc, deadline, 
+                         &clock_countdown)) {
+                goto stopped;
+        }
+        if (code[pc].idiom != IDIOM_NONE) {
+                uint32_t r[8];
+                for (int i = 0; i < 8; i++) {
+                        r[i] = getRegister(registers, i);
+                }
+                if (runLoop(context, &pc, r, &instructions)) {
+                        for (int i = 0; i < 8; i++) {
+                                setRegister(registers, i, r[i]);
+                        }
+                        block_start = pc;
+                        if (limitReached(context, instructions, pc, deadline,
+                                         &clock_countdown)) {
+                                goto stopped;
+                        }
+                }
+        }
+        DISPATCH();
+
+        do_LOAD_VAL:
+        loadValue(registers, instruction->ra, instruction->value);
+        NEXT();
+
+        do_HCALL:
+        if (!extensions) {
+                goto do_invalid;
+        }
+        hypercall(context, getRegister(registers, instruction->ra),
+                  getRegister(registers, instruction->rb),
+                  getRegister(registers, instruction->rc));
+        NEXT();
+
+        do_RESIZE: {
+                if (!extensions) {
+                        goto do_invalid;
+                }
+                uint32_t identifier = getRegister(registers, instruction->rb);
+                uint32_t length = getRegister(registers, instruction->rc);
+                if (!memoryAllows(memory, growth(segments, identifier,
+                                                 length), 0)) {
+                        goto memory_limit;
+                }
+                resizeSegment(segments, identifier, length);
+                generation = nextGeneration(context, generation);
+        }
+        NEXT();
+
+        do_invalid:
+        fprintf(stderr, "Not a valid instruction\n");
+        exit(EXIT_FAILURE);
+
+        memory_limit:
+        instructions += pc - block_start;
+        context->status = EXECUTION_MEMORY_LIMIT;
+
+#undef NEXT
+#undef DISPATCH
+stopped:
+        guardWatch(NULL, NULL);
+        context->pc = pc;
+        context->instructions = instructions;
+        context->generation = generation;
+        context->site_hits += counters.hits;
+        context->site_misses += counters.misses;
+}
+
+/* The handlers of the specialized engine. Each one is generated for fixed
+registers, so r[a], r[b] and r[c] are constant offsets into a local array
+the compiler can keep in machine registers. */
+#define SPECIAL_DISPATCH()                                              \
+        do {                                                            \
+                assert(pc < code_length);                               \
+                instruction = &code[pc];                                \
+                __extension__ ({ goto *handlers[instruction->handler]; });\
+        } while (0)
+#define SPECIAL_NEXT()                                                  \
+        do {                                                            \
+                pc++;                                                   \
+                SPECIAL_DISPATCH();                                     \
+        } while (0)
+
+#define SPECIAL_COND_MOV(a, b, c)                                       \
+        if (r[c] != 0) {                                                \
+                r[a] = r[b];                                            \
+        }                                                               \
+        SPECIAL_NEXT()
+#define SPECIAL_SEG_LOAD(a, b, c)                                       \
+        do {                                                            \
+                uint32_t identifier = r[b], offset = r[c];              \
+                r[a] = wordAt(siteSegment(&sites[pc], segments,         \
+                                          identifier, generation,       \
+                                          &counters),                   \
+                              offset, checked);                         \
+                if (heat != NULL) {                                     \
+                        heatRecord(heat, identifier, offset, false);    \
+                }                                                       \
+        } while (0);                                                    \
+        SPECIAL_NEXT()
+#define SPECIAL_SEG_STORE(a, b, c)                                      \
+        storeWordAt(siteSegment(&sites[pc], segments, r[a],      \
+                                generation, &counters),                 \
+                    r[b], r[c], checked);                               \
+        if (tracking) {                                                 \
+                markWritten(segments, r[a], r[b]);                      \
+        }                                                               \
+        if (heat != NULL) {                                             \
+                heatRecord(heat, r[a], r[b], true);                     \
+        }                                                               \
+        if (!barrier && r[a] == 0) {                                    \
+                forgetCode(context, r[b], 1);                           \
+        }                                                               \
+        SPECIAL_NEXT()
+#define SPECIAL_ADD(a, b, c)                                            \
+        r[a] = r[b] + r[c];                                             \
+        SPECIAL_NEXT()
+#define SPECIAL_MULT(a, b, c)                                           \
+        r[a] = r[b] * r[c];                                             \
+        SPECIAL_NEXT()
+#define SPECIAL_DIV(a, b, c)                                            \
+        assert(r[c] != 0);                                              \
+        r[a] = r[b] / r[c];                                             \
+        SPECIAL_NEXT()
+#define SPECIAL_NAND(a, b, c)                                           \
+        r[a] = ~(r[b] & r[c]);                                          \
+        SPECIAL_NEXT()
+#define SPECIAL_HALT()                                                  \
+        goto special_halt
+#define SPECIAL_MAP(b, c)                                               \
+        if (!memoryAllows(memory, r[c], 1)) {                           \
+                goto special_memory_limit;                              \
+        }                                                               \
+        r[b] = mapSegmentOf(segments, r[c]);                            \
+        generation = nextGeneration(context, generation);               \
+        SPECIAL_NEXT()
+#define SPECIAL_UNMAP(c)                                                \
+        unmapSegmentOf(segments, r[c]);                                 \
+        generation = nextGeneration(context, generation);               \
+        SPECIAL_NEXT()
+#define SPECIAL_OUTPUT(c)                                               \
+        assert(r[c] <= 255);                                            \
+        writeByte(context, r[c]);                                       \
+        SPECIAL_NEXT()
+#define SPECIAL_INPUT(c)                                                \
+        r[c] = readByte(context, instructions + pc - block_start);      \
+        SPECIAL_NEXT()
+#define SPECIAL_LOAD_PROGRAM(b, c)                                      \
+        jump_segment = r[b];                                            \
+        jump_target = r[c];                                             \
+        goto special_load_program
+#define SPECIAL_LOAD_VAL(a)                                             \
+        r[a] = instruction->value;                                      \
+        SPECIAL_NEXT()
+#define SPECIAL_HCALL(a, b, c)                                          \
+        if (!extensions) {                                              \
+                goto special_invalid;                                   \
+        }                                                               \
+        hypercall(context, r[a], r[b], r[c]);                           \
+        SPECIAL_NEXT()
+#define SPECIAL_RESIZE(b, c)                                            \
+        if (!extensions) {                                              \
+                goto special_invalid;                                   \
+        }                                                               \
+        if (!memoryAllows(memory, growth(segments, r[b], r[c]), 0)) {   \
+                goto special_memory_limit;                              \
+        }                                                               \
+        resizeSegment(segments, r[b], r[c]);                            \
+        generation = nextGeneration(context, generation);               \
+        SPECIAL_NEXT()
+
+/* Handler labels and table entries, named after the operands the format
+of each opcode uses */
+#define SPECIAL_LABEL_NONE(name, a, b, c) s_##name
+#define SPECIAL_LABEL_C(name, a, b, c) s_##name##_##c
+#define SPECIAL_LABEL_BC(name, a, b, c) s_##name##_##b##_##c
+#define SPECIAL_LABEL_ABC(name, a, b, c) s_##name##_##a##_##b##_##c
+#define SPECIAL_LABEL_AV(name, a, b, c) s_##name##_##a
+
+#define SPECIAL_ENTRY(name, format, a, b, c)                            \
+        [SPECIAL_INDEX(name, a, b, c)] =                                \
+                __extension__ &&SPECIAL_LABEL_##format(name, a, b, c),
+#define SPECIAL_ENTRIES(name, mnemonic, format)                         \
+        UM_EACH_A(SPECIAL_ENTRY, name, format)
+
+#define SPECIAL_HANDLER_C(name, c) s_##name##_##c: SPECIAL_##name(c);
+#define SPECIAL_HANDLER_BC(name, b, c)                                  \
+        s_##name##_##b##_##c: SPECIAL_##name(b, c);
+#define SPECIAL_HANDLER_ABC(name, a, b, c)                              \
+        s_##name##_##a##_##b##_##c: SPECIAL_##name(a, b, c);
+#define SPECIAL_HANDLER_AV(name, a) s_##name##_##a: SPECIAL_##name(a);
+
+#define SPECIAL_HANDLERS_NONE(name) s_##name: SPECIAL_##name();
+#define SPECIAL_HANDLERS_C(name) UM_EACH_C(SPECIAL_HANDLER_C, name)
+#define SPECIAL_HANDLERS_BC(name) UM_EACH_B(SPECIAL_HANDLER_BC, name)
+#define SPECIAL_HANDLERS_ABC(name) UM_EACH_A(SPECIAL_HANDLER_ABC, name)
+#define SPECIAL_HANDLERS_AV(name) UM_EACH_C(SPECIAL_HANDLER_AV, name)
+#define SPECIAL_HANDLERS(name, mnemonic, format) SPECIAL_HANDLERS_##format(name)
+
+/**************************** runSpecialized() ****************************
+ *  Purpose: The ENGINE_SPECIALIZED implementation of run()
+ *  Parameters: executionContext context: the context to run
+ *  Returns: None, context->status tells why it stopped
+ *  Effects: Keeps the registers in a local array while it runs, and 
+ *           dispatches each instruction straight to the handler for its
+ *           opcode and registers, so no operand is decoded at run time
+ *  Expects: context must exist and not have halted
+ ***********************************************************************/
+static void runSpecialized(executionContext context)
+{
+        uint32_t pc = context->pc;
+        segmentTable segments = context->segments;
+        decodedInstruction code = context->code;
+        uint32_t code_length = context->code_length;
+        segmentSite sites = context->sites;
+        uint32_t generation = context->generation;
+        siteCounters counters = { 0, 0 };
+        bool checked = !guardPagesEnabled();
+        bool barrier = context->barrier;
+        bool extensions = context->extensions;
+        memoryUsage memory = &segments->usage;
+        bool tracking = segments->dirty != NULL;
+        heatMap heat = context->heat;
+        flightRecorder flight = flightRecorderOf();
+        struct flightEntry *jump;
+        uint64_t *entries = context->entries;
+        guardWatch(segments, &pc);
+
+        uint32_t block_start = pc;
+        uint64_t instructions = context->instructions;
+        double deadline = startClock(context);
+        int clock_countdown = CLOCK_POLL_INTERVAL;
+        uint32_t jump_segment, jump_target;
+
+        uint32_t r[8];
+        for (int i = 0; i < 8; i++) {
+                r[i] = getRegister(context->registers, i);
+        }
+
+        static void *const handlers[SPECIAL_INVALID + 1] = {
+                [SPECIAL_UNDECODED] = __extension__ &&special_decode,
+                UM_ISA(SPECIAL_ENTRIES)
+                [SPECIAL_INVALID] = __extension__ &&special_invalid
+        };
+        decodedInstruction instruction;
+
+        SPECIAL_DISPATCH();
+
+        special_decode: {
+                uint32_t word = getSegment(segments, 0)->words[pc];
+                if (barrier && !barrierCache(pc)) {
+                        /* page left writable: don't cache */
+                        instruction = &code[code_length];
+                }
+                decodeInstruction(word, instruction);
+                __extension__ ({ goto *handlers[instruction->handler]; });
+        }
+
+        UM_ISA(SPECIAL_HANDLERS)
+
+        special_load_program:
+        jump = flightSlot(flight);
+        jump->from = pc;
+        context->jumps++;
+        instructions += pc - block_start + 1;
+        if (jump_segment != 0) {
+                /* segment 0 is replaced: start a new cache */
+                if (entries != NULL) {
+                        foldEntries(context);
+                }
+                barrierDetach();
+                pc = loadProgramOf(segments, jump_segment, jump_target);
+                replaceCode(context);
+                code = context->code;
+                code_length = context->code_length;
+                sites = context->sites;
+                entries = context->entries;
+        } else {
+                pc = loadProgramOf(segments, 0, jump_target);
+        }
+        block_start = pc;
+        if (entries != NULL) {
+                entries[pc]++;
+        }
+        jump->instructions = instructions;
+        jump->to = pc;
+        memcpy(jump->registers, r, sizeof(jump->registers));
+        if (limitReached(context, instructions, pc, deadline, 
+                         &clock_countdown)) {
+                goto stopped;
+        }
+        if (code[pc].idiom != IDIOM_NONE && 
+            runLoop(context, &pc, r, &instructions)) {
+                block_start = pc;
+                if (limitReached(context, instructions, pc, deadline, 
+                                 &clock_countdown)) {
+                        goto stopped;
+                }
+        }
+        SPECIAL_DISPATCH();
+
+        special_halt:
+        instructions += pc - block_start + 1;
+        context->status = EXECUTION_HALTED;
+        goto stopped;
+
+        special_invalid:
+        fprintf(stderr, "Not a valid instruction\n");
+        exit(EXIT_FAILURE);
+
+        special_memory_limit:
+        instructions += pc - block_start;
+        context->status = EXECUTION_MEMORY_LIMIT;
+
+stopped:
+        guardWatch(NULL, NULL);
+        for (int i = 0; i < 8; i++) {
+                setRegister(context->registers, i, r[i]);
+        }
+        context->pc = pc;
+        context->instructions = instructions;
+        context->generation = generation;
+        context->site_hits += counters.hits;
+        context->site_misses += counters.misses;
+}
+
+/* The registers of the lockstep engine: element l of a vector belongs to
+lane l. GCC lowers the arithmetic to the widest vector unit the target
+has, e.g. one AVX2 instruction per operation with -mavx2. */
+typedef uint32_t laneVector __attribute__((vector_size(LOCKSTEP_LANES * 4)));
+
+/* On x86-64 runLockstep is also built for AVX2, where a laneVector fits
+one register, and the dynamic loader picks the version the machine runs;
+the baseline build would split each operation in two */
+#if defined(__x86_64__)
+#define LOCKSTEP_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define LOCKSTEP_TARGETS
+#endif
+
+/***************************** laneSegment() *****************************
+ *  Purpose: Finds the segment a lane accesses in lockstep, through the 
+ *           lane's own segment site, without the assertions that would 
+ *           stop every lane
+ *  Parameters: executionContext lane: the context of the lane
+ *              uint32_t pc: the SEG_LOAD or SEG_STORE
+ *              uint32_t identifier, offset: the word accessed
+ *  Returns: the segment, or NULL if the access would fail
+ *  Effects: Counts the hit or miss in the lane's context
+ ***********************************************************************/
+static inline Segment laneSegment(executionContext lane, uint32_t pc,
+                                  uint32_t identifier, uint32_t offset)
+{
+        segmentSite site = &lane->sites[pc];
+        Segment segment = site->segment;
+        if (site->identifier == identifier && 
+            (identifier == 0 || site->generation == lane->generation)) {
+                lane->site_hits++;
+        } else if (segmentMapped(lane->segments, identifier)) {
+                lane->site_misses++;
+                segment = getSegment(lane->segments, identifier);
+                site->segment = segment;
+                site->identifier = identifier;
+                site->generation = lane->generation;
+        } else {
+                return NULL;
+        }
+        return offset < segment->length ? segment : NULL;
+}
+
+/****************************** laneMapped() ******************************
+ *  Purpose: Tells whether a segment of a lane is mapped
+ *  Parameters: executionContext lane: the context of the lane
+ *              uint32_t identifier: the segment
+ *  Returns: true if UNMAP or LOAD_PROGRAM may use the segment
+ ***********************************************************************/
+static inline bool laneMapped(executionContext lane, uint32_t identifier)
+{
+        return segmentMapped(lane->segments, identifier);
+}
+
+/*************************** newLockstepCode() ***************************
+ *  Purpose: Starts the decoded copy of segment 0 shared by the lanes
+ *  Parameters: struct decodedInstruction *code: the previous copy, or NULL
+ *              uint32_t length: the length of segment 0
+ *  Returns: a copy with every instruction still to be decoded
+ *  Effects: Frees code
+ ***********************************************************************/
+static struct decodedInstruction *newLockstepCode(
+        struct decodedInstruction *code, uint32_t length)
+{
+        free(code);
+        code = malloc((size_t) (length + 1) * 
+                      sizeof(struct decodedInstruction));
+        assert(code != NULL);
+        for (uint32_t i = 0; i < length; i++) {
+                code[i].opcode = UNDECODED;
+        }
+        return code;
+}
+
+/**************************** leaveLockstep() ****************************
+ *  Purpose: Hands a lane back to its own context
+ *  Parameters: executionContext lane: the context of the lane
+ *              laneVector r[8]: the registers of every lane
+ *              int index: the lane's element of r
+ *              uint32_t pc: the first instruction the lane did not run
+ *              uint64_t instructions: instructions the lane retired
+ *  Returns: None
+ *  Effects: Copies the lane's registers into its context and empties the
+ *           context's instruction cache, which lockstep did not keep up to
+ *           date. The status is left as it is, so a lane that is still
+ *           EXECUTION_RUNNING resumes with run().
+ ***********************************************************************/
+static void leaveLockstep(executionContext lane, laneVector r[8], int index,
+                          uint32_t pc, uint64_t instructions)
+{
+        for (int i = 0; i < 8; i++) {
+                setRegister(lane->registers, i, r[i][index]);
+        }
+        lane->pc = pc;
+        lane->instructions = instructions;
+        forgetCode(lane, 0, lane->code_length);
+}
+
+/***************************** runLockstep() *****************************
+ *  Purpose: Runs up to LOCKSTEP_LANES copies of one program, each with its
+ *           own input, in lockstep
+ *  Parameters: executionContext *lanes: the contexts, one per lane
+ *              int count: the number of lanes, within 1-LOCKSTEP_LANES
+ *  Returns: None
+ *  Effects: All lanes share one decoded instruction and execute it 
+ *           together; arithmetic runs on vectors of registers, memory,
+ *           MAP and i/o on each lane's own segments and streams. A lane
+ *           leaves the group, before the instruction that would make it
+ *           differ, when it jumps elsewhere than the most lanes do, loads
+ *           a program from another segment, finds different code at pc,
+ *           or would fail. A lane that halts or reaches a limit in lockstep
+ *           ends with that status; every other lane is left 
+ *           EXECUTION_RUNNING and finishes with run().
+ *  Expects: the contexts hold identical programs at the same pc and
+ *           instruction count, e.g. fresh from newContext
+ ***********************************************************************/
+LOCKSTEP_TARGETS void runLockstep(executionContext *lanes, int count)
+{
+        assert(lanes != NULL && count >= 1 && count <= LOCKSTEP_LANES);
+        uint32_t pc = lanes[0]->pc;
+        uint64_t instructions = lanes[0]->instructions;
+        uint32_t code_length = lanes[0]->code_length;
+        uint32_t block_start = pc;
+
+        laneVector r[8];
+        double deadline[LOCKSTEP_LANES];
+        int clock_countdown[LOCKSTEP_LANES];
+        uint32_t active = 0;
+        for (int l = 0; l < count; l++) {
+                assert(lanes[l]->pc == pc && 
+                       lanes[l]->instructions == instructions &&
+                       lanes[l]->code_length == code_length);
+                for (int i = 0; i < 8; i++) {
+                        r[i][l] = getRegister(lanes[l]->registers, i);
+                }
+                deadline[l] = startClock(lanes[l]);
+                clock_countdown[l] = CLOCK_POLL_INTERVAL;
+                if (lanes[l]->status == EXECUTION_RUNNING) {
+                        active |= 1u << l;
+                }
+        }
+
+        /* one decoded copy of segment 0 for the whole group; a store into
+        segment 0 by any lane sends the word back to be compared */
+        struct decodedInstruction *code = newLockstepCode(NULL, code_length);
+
+/* Applies statement to each lane still in lockstep, as lane l */
+#define EACH_LANE(statement)                                            \
+        do {                                                            \
+                for (uint32_t lanes_left = active; lanes_left != 0;     \
+                     lanes_left &= lanes_left - 1) {                    \
+                        int l = __builtin_ctz(lanes_left);              \
+                        statement;                                      \
+                }                                                       \
+        } while (0)
+/* Lane l stops running in lockstep before the instruction at pc */
+#define LEAVE(l)                                                        \
+        do {                                                            \
+                leaveLockstep(lanes[l], r, l, pc,                       \
+                              instructions + (pc - block_start));       \
+                active &= ~(1u << (l));                                 \
+        } while (0)
+
+        while (active != 0) {
+                if (pc >= code_length) {
+                        /* ran off the end: let each lane fail alone */
+                        EACH_LANE(LEAVE(l));
                         break;
+                }
+                decodedInstruction instruction = &code[pc];
+                if (instruction->opcode == UNDECODED) {
+                        uint32_t word = getSegment(lanes[__builtin_ctz(active)]
+                                                   ->segments, 0)
+                                        ->words[pc];
+                        EACH_LANE(
+                                if (getSegment(lanes[l]->segments, 0)
+                                    ->words[pc] != word) {
+                                        LEAVE(l);
+                                });
+                        decodeInstruction(word, instruction);
+                }
+                unsigned a = instruction->ra;
+                unsigned b = instruction->rb;
+                unsigned c = instruction->rc;
 
-                        case SEG_LOAD:
-                        segLoad(registers, mapped_segments, genInfo->ra,
-                                                            genInfo->rb,
-                                                            genInfo->rc);
+                switch (instruction->opcode) {
+                case COND_MOV: {
+                        laneVector moved = (laneVector) (r[c] != 0);
+                        r[a] = (r[b] & moved) | (r[a] & ~moved);
                         break;
-                        
-                        case SEG_STORE:
-                        segStore(registers, mapped_segments, genInfo->ra,
-                                                             genInfo->rb,
-                                                             genInfo->rc);
+                }
+                case SEG_LOAD:
+                        EACH_LANE(
+                                Segment segment = laneSegment(lanes[l], pc,
+                                                              r[b][l],
+                                                              r[c][l]);
+                                if (segment == NULL) {
+                                        LEAVE(l);
+                                } else {
+                                        r[a][l] = segment->words[r[c][l]];
+                                });
                         break;
-                      
-                        case ADD:
-                        add(registers, genInfo->ra, genInfo->rb, genInfo->rc);
+                case SEG_STORE:
+                        EACH_LANE(
+                                Segment segment = laneSegment(lanes[l], pc,
+                                                              r[a][l],
+                                                              r[b][l]);
+                                if (segment == NULL) {
+                                        LEAVE(l);
+                                } else {
+                                        segment->words[r[b][l]] = r[c][l];
+                                        if (r[a][l] == 0) {
+                                                code[r[b][l]].opcode =
+                                                        UNDECODED;
+                                        }
+                                });
                         break;
-
-                        case MULT:
-                        multiply(registers, genInfo->ra,
-                                            genInfo->rb,
-                                            genInfo->rc);
+                case ADD:
+                        r[a] = r[b] + r[c];
                         break;
-
-                        case DIV:
-                        divide(registers, genInfo->ra,
-                                          genInfo->rb, 
-                                          genInfo->rc);
+                case MULT:
+                        r[a] = r[b] * r[c];
                         break;
-
-                        case NAND: 
-                        nand(registers, genInfo->ra, genInfo->rb, genInfo->rc);
+                case DIV: {
+                        EACH_LANE(
+                                if (r[c][l] == 0) {
+                                        LEAVE(l);
+                                });
+                        /* lanes that left may still divide by zero */
+                        laneVector zero = (laneVector) (r[c] == 0);
+                        r[a] = r[b] / (r[c] | (zero & 1));
                         break;
-
-                        case HALT:
-                        executing = false;
+                }
+                case NAND:
+                        r[a] = ~(r[b] & r[c]);
                         break;
-                        
-                        case MAP:
-                        mapSegment(registers, mapped_segments,
-                                              unmapped_identifiers,
-                                              genInfo->rb, genInfo->rc);
+                case HALT:
+                        instructions += pc - block_start + 1;
+                        EACH_LANE(
+                                lanes[l]->status = EXECUTION_HALTED;
+                                leaveLockstep(lanes[l], r, l, pc, 
+                                              instructions));
+                        active = 0;
                         break;
-
-                        case UNMAP:
-                        unmapSegment(registers, mapped_segments,
-                                                unmapped_identifiers,
-                                                genInfo->rc);
+                case MAP:
+                        EACH_LANE(
+                                if (!memoryAllows(
+                                            &lanes[l]->segments->usage,
+                                            r[c][l], 1)) {
+                                        LEAVE(l);
+                                });
+                        EACH_LANE(
+                                r[b][l] = mapSegmentOf(lanes[l]->segments,
+                                                       r[c][l]);
+                                lanes[l]->generation = nextGeneration(
+                                        lanes[l], lanes[l]->generation));
                         break;
-
-                        case OUTPUT:
-                        output(registers, genInfo->rc);
+                case UNMAP:
+                        EACH_LANE(
+                                if (r[c][l] == 0 || 
+                                    !laneMapped(lanes[l], r[c][l])) {
+                                        LEAVE(l);
+                                });
+                        EACH_LANE(
+                                unmapSegmentOf(lanes[l]->segments, 
+                                               r[c][l]);
+                                lanes[l]->generation = nextGeneration(
+                                        lanes[l], lanes[l]->generation));
                         break;
-
-                        case INPUT:
-                        input(registers, genInfo->rc);
+                case OUTPUT:
+                        EACH_LANE(
+                                if (r[c][l] > 255) {
+                                        LEAVE(l);
+                                } else {
+                                        writeByte(lanes[l], r[c][l]);
+                                });
                         break;
-
-                        case LOAD_PROGRAM:
-                        loadProgram(mapped_segments, unmapped_identifiers,
-                                                     registers, genInfo->rb,
-                                                     genInfo->rc, &pc);
+                case INPUT:
+                        EACH_LANE(r[c][l] = readByte(lanes[l], 
+                                                     instructions + pc - 
+                                                     block_start));
                         break;
-                        
-                        case LOAD_VAL:
-                        loadValue(registers, loadInfo->ra, loadInfo->value);
+                case LOAD_PROGRAM: {
+                        /* follow the jump most lanes agree on */
+                        uint32_t source = 0, target = 0;
+                        int votes = 0;
+                        EACH_LANE(
+                                int agree = 0;
+                                for (uint32_t others = active; others != 0;
+                                     others &= others - 1) {
+                                        int o = __builtin_ctz(others);
+                                        agree += r[b][o] == r[b][l] && 
+                                                 r[c][o] == r[c][l];
+                                }
+                                if (agree > votes) {
+                                        votes = agree;
+                                        source = r[b][l];
+                                        target = r[c][l];
+                                });
+                        EACH_LANE(
+                                if (r[b][l] != source || r[c][l] != target ||
+                                    (source == 0 && target >= code_length) ||
+                                    !laneMapped(lanes[l], source)) {
+                                        LEAVE(l);
+                                });
+                        EACH_LANE(lanes[l]->jumps++);
+                        instructions += pc - block_start + 1;
+                        pc = target;
+                        block_start = pc;
+                        if (source != 0 && active != 0) {
+                                /* every lane replaces its segment 0; the
+                                words are compared as they are decoded */
+                                EACH_LANE(
+                                        loadProgramOf(lanes[l]->segments,
+                                                      source, target);
+                                        resetCode(lanes[l]));
+                                code_length = lanes[__builtin_ctz(active)]
+                                              ->code_length;
+                                EACH_LANE(
+                                        if (lanes[l]->code_length != 
+                                            code_length) {
+                                                LEAVE(l);
+                                        });
+                                code = newLockstepCode(code, code_length);
+                        }
+                        EACH_LANE(
+                                if (limitReached(lanes[l], instructions, 
+                                                 pc, deadline[l],
+                                                 &clock_countdown[l])) {
+                                        LEAVE(l);
+                                });
+                        continue;
+                }
+                case LOAD_VAL:
+                        r[a] = (laneVector) { 0 } + instruction->value;
+                        break;
+                default:
+                        EACH_LANE(LEAVE(l));
                         break;
-
-                        default:
-                        fprintf(stderr, "Not a valid instruction\n");
-                        exit(EXIT_FAILURE);
-                }   
-                
-                /* If loadprogram is called then we do NOT want to
-                increment the program counter */
-                if (opcode != 12) {
-                        pc++;
-                }    
-                
-                /* free newLoad and newGeneral structs */
-                if (opcode == 13) {
-                        free(loadInfo);
-                } else {
-                        free(genInfo);
                 }
+                pc++;
         }
+#undef LEAVE
+#undef EACH_LANE
+        free(code);
+}
 
-        /* free registers */
-        Seq_free(&registers);
-
-        /* free unmapped_identifiers */
-        Seq_free(&unmapped_identifiers);
-
-        /* free mapped_segments */
-        for(int i = 0; i < segmentLength(mapped_segments); i++)
-        {
-                assert(mapped_segments != NULL);
-                Seq_T segment = Seq_get(mapped_segments, i);
-                if (segment != NULL) { 
-                        Seq_free(&segment);
-                }
+/******************************** run() *******************************
+ *  Purpose: Executes the instructions of the program held by a context
+ *  Parameters: executionContext context: the context to run
+ *  Returns: EXECUTION_HALTED once the program halts, or the limit that
+ *           stopped it
+ *  Effects: Runs the engine chosen with setEngine. Instructions are 
+ *           counted per block (from one LOAD_PROGRAM target to the next
+ *           jump) rather than one by one, which is also where limits are
+ *           checked.
+ *  Expects: context must exist, keeps running until halt instruction, end
+ *           of file or a limit is reached
+ ***********************************************************************/
+executionStatus run(executionContext context)
+{
+        assert(context != NULL);
+        if (context->status == EXECUTION_HALTED) {
+                return context->status;
         }
-        Seq_free(&mapped_segments);
+        context->status = EXECUTION_RUNNING;
+
+        /* under the write barrier, stores to segment 0 are caught by the
+        fault handler; otherwise each store checks its target itself */
+        if (context->barrier) {
+                forgetCode(context, 0, context->code_length);
+                barrierAttach(getSegment(context->segments, 0), 
+                              forgetCode, context);
+        }
+
+        UM_PROBE2(run__start, context->pc, context->instructions);
+        if (context->live != NULL) {
+                publishLive(context, context->instructions);
+        }
+
+        /* the run starts a block at pc, and unless it halts it stops 
+        before the word at pc, which the block counts must not include */
+        if (context->entries != NULL) {
+                context->entries[context->pc]++;
+        }
+        if (context->engine == ENGINE_SPECIALIZED) {
+                runSpecialized(context);
+        } else {
+                runThreaded(context);
+        }
+        if (context->entries != NULL && 
+            context->status != EXECUTION_HALTED) {
+                context->entries[context->pc]--;
+        }
+        if (context->latency != NULL && 
+            context->status == EXECUTION_HALTED) {
+                latencyWaiting(context->latency, context->instructions);
+        }
+        UM_PROBE2(run__done, context->status, context->instructions);
+        if (context->live != NULL) {
+                publishLive(context, context->instructions);
+        }
+
+        barrierDetach();
+        return context->status;
 }
 
-/**************************** newLoad() ****************************
- *  Purpose: Initializes a loadInstruction struct
- *  Parameters: None
- *  Returns: a new loadInstruction struct with members set to 0
- *  Effects: Mallocs space for a new struct
- *  Expects: None
+/************************* context accessors *************************
+ *  Purpose: Expose the final (or current) state of a context, so that a
+ *           program stopped by a limit can be reported on
+ *  Parameters: executionContext context: the context of interest
+ *              int index: for contextRegister, the register within 0-7
+ *  Returns: the program counter, number of instructions retired, the
+ *           value of a register, or why the program last stopped
+ *  Effects: None
+ *  Expects: context must exist
+ ***********************************************************************/
+uint32_t contextProgramCounter(executionContext context)
+{
+        assert(context != NULL);
+        return context->pc;
+}
+
+uint64_t contextInstructions(executionContext context)
+{
+        assert(context != NULL);
+        return context->instructions;
+}
+
+uint32_t contextRegister(executionContext context, int index)
+{
+        assert(context != NULL);
+        return getRegister(context->registers, index);
+}
+
+executionStatus contextStatus(executionContext context)
+{
+        assert(context != NULL);
+        return context->status;
+}
+
+/************************* checkpoint accessors *************************
+ *  Purpose: Expose what a checkpoint records of a context beyond its 
+ *           registers and program counter
+ *  Parameters: executionContext context: the context of interest
+ *  Returns: the number of bytes INPUT has read, or the segment table,
+ *           which the caller may read but only change through memory.h
+ *  Effects: None
+ *  Expects: context must exist
  ***********************************************************************/
-loadInstruction newLoad() {
-        loadInstruction new = malloc(sizeof(struct loadInstruction));
-        assert(new);
-        new->ra = 0;
-        new->value = 0;
+uint64_t contextInputBytes(executionContext context)
+{
+        assert(context != NULL);
+        return context->input_bytes;
+}
 
-        return new;
+segmentTable contextSegments(executionContext context)
+{
+        assert(context != NULL);
+        return context->segments;
 }
 
-/**************************** newGeneral() ****************************
- *  Purpose: Initializes a generalInstruction struct
- *  Parameters: None
- *  Returns: a new generalInstruction struct with members set to 0
- *  Effects: Mallocs space for a new struct
- *  Expects: None
+/**************************** resumeContext() ****************************
+ *  Purpose: Puts a context in the state a checkpoint recorded
+ *  Parameters: executionContext context: a context whose segments were
+ *                                        rebuilt from the checkpoint
+ *              uint32_t pc: the program counter
+ *              const uint32_t registers[8]: the registers
+ *              uint64_t instructions: instructions retired so far
+ *              uint64_t input_bytes: bytes of input already consumed, 
+ *                                    which the caller has skipped
+ *  Returns: None
+ *  Effects: Starts a new cache of decoded instructions, since segment 0
+ *           may have been replaced
+ *  Expects: context must exist and not be running, and pc must be within
+ *           segment 0
  ***********************************************************************/
-generalInstruction newGeneral() {
-        generalInstruction new = malloc(sizeof(struct generalInstruction));
-        assert(new);
-        new->opcode = 0;
-        new->ra = 0;
-        new->rb = 0;
-        new->rc = 0;
+void resumeContext(executionContext context, uint32_t pc,
+                   const uint32_t registers[8], uint64_t instructions,
+                   uint64_t input_bytes)
+{
+        assert(context != NULL && registers != NULL);
+        resetCode(context);
+        assert(pc < context->code_length);
+        for (int i = 0; i < 8; i++) {
+                setRegister(context->registers, i, registers[i]);
+        }
+        context->pc = pc;
+        context->instructions = instructions;
+        context->input_bytes = input_bytes;
+        context->status = EXECUTION_RUNNING;
+}
 
-        return new;
+/*************************** contextSiteStats() ***************************
+ *  Purpose: Reports how well the segment sites of SEG_LOAD and SEG_STORE
+ *           did, for profiling
+ *  Parameters: executionContext context: the context of interest
+ *              uint64_t *hits, *misses: where to store the number of
+ *                                       accesses that found their segment
+ *                                       in the site, and that looked it up
+ *  Returns: None
+ *  Effects: None
+ *  Expects: context, hits and misses must exist
+ ***********************************************************************/
+void contextSiteStats(executionContext context, uint64_t *hits, 
+                      uint64_t *misses)
+{
+        assert(context != NULL && hits != NULL && misses != NULL);
+        *hits = context->site_hits;
+        *misses = context->site_misses;
 }
 
-/**************************** unpackLoad() ****************************
- *  Purpose: Unpacks a 32 bit instruction for and returns a struct containing 
- *           the unbitpacked information, for load value instruction format
- *           specifically
- *  Parameters: uint32_t instruction: universal machine load value instruction
- *  Returns: a loadInstruction struct with values corresponding to the 
-             bitpacked instruction
- *  Effects: Mallocs space for a new struct and uses bitpack module to unpack
- *  Expects: instruction must be valid and packed in the correct manner
+/************************** contextMemoryStats() **************************
+ *  Purpose: Reports how much memory the segments of a context take
+ *  Parameters: executionContext context: the context of interest
+ *              struct memoryUsage *usage: where to store the current use,
+ *                                         the high-water marks and the
+ *                                         limit
+ *  Returns: None
+ *  Effects: None
+ *  Expects: context and usage must exist
  ***********************************************************************/
-loadInstruction unpackLoad(uint32_t instruction) 
+void contextMemoryStats(executionContext context, struct memoryUsage *usage)
 {
-        /* instantantiate a loadInstruction struct */
-        loadInstruction newInstruction = newLoad();
+        assert(context != NULL && usage != NULL);
+        *usage = context->segments->usage;
+}
 
-        /* using Bitpack_getu, extract r[A], and value */
-        newInstruction->ra = Bitpack_getu(instruction, 3, 25);
-        newInstruction->value = Bitpack_getu(instruction, 25, 0);
-        
-        return newInstruction;
+/**************************** report accessors ****************************
+ *  Purpose: Expose what a report on a run says beyond its state
+ *  Parameters: executionContext context: the context of interest
+ *              uint64_t counts[16]: for contextOpcodeCounts, where to 
+ *                                   store the instructions executed by
+ *                                   opcode
+ *              uint64_t *looped: and the instructions of the copy, fill
+ *                                and compare loops run in bulk, which 
+ *                                counts includes
+ *  Returns: the LOAD_PROGRAMs executed, the bytes OUTPUT has written, or
+ *           when it wrote the first one on the monotonic clock (0 if it
+ *           has not)
+ *  Effects: contextOpcodeCounts stores zeros unless countOpcodes was
+ *           called
+ *  Expects: context, counts and looped must exist
+ ***********************************************************************/
+uint64_t contextJumps(executionContext context)
+{
+        assert(context != NULL);
+        return context->jumps;
 }
 
-/**************************** unpackGeneral() ****************************
- *  Purpose: Unpacks a 32 bit instruction and returns a struct containing the
- *           unbitpacked information
- *  Parameters: uint32_t instruction: a universal machine instruction
- *  Returns: a generalInstruction struct with values corresponding to the 
-             bitpacked instruction
- *  Effects: Mallocs space for a new struct and uses bitpack module to unpack
- *  Expects: instruction must be valid and packed in the correct manner
+uint64_t contextOutputBytes(executionContext context)
+{
+        assert(context != NULL);
+        return context->output_bytes;
+}
+
+double contextFirstOutput(executionContext context)
+{
+        assert(context != NULL);
+        return context->first_output;
+}
+
+void contextOpcodeCounts(executionContext context, uint64_t counts[16],
+                         uint64_t *looped)
+{
+        assert(context != NULL && counts != NULL && looped != NULL);
+        foldEntries(context);
+        memcpy(counts, context->opcode_counts, 
+               sizeof(context->opcode_counts));
+        *looped = context->idiom_instructions;
+}
+
+/****************************** statusName() ******************************
+ *  Purpose: Describes an executionStatus in words for reports
+ *  Parameters: executionStatus status: the status to describe
+ *  Returns: a static string
+ *  Effects: None
+ *  Expects: None
  ***********************************************************************/
-generalInstruction unpackGeneral(uint32_t instruction)
+const char *statusName(executionStatus status)
 {
-        generalInstruction newInstruction = newGeneral();
-        newInstruction->opcode = Bitpack_getu(instruction, 4, 28);
-        newInstruction->ra = Bitpack_getu(instruction, 3, 6);
-        newInstruction->rb = Bitpack_getu(instruction, 3, 3);
-        newInstruction->rc = Bitpack_getu(instruction, 3, 0);
+        switch (status) {
+                case EXECUTION_RUNNING: return "running";
+                case EXECUTION_HALTED: return "halted";
+                case EXECUTION_INSTRUCTION_LIMIT: 
+                        return "instruction limit reached";
+                case EXECUTION_TIMEOUT: return "timed out";
+                case EXECUTION_MEMORY_LIMIT: return "memory limit reached";
+        }
+        return "unknown";
+}
 
-        return newInstruction;
+/****************************** engineName() ******************************
+ *  Purpose: Names an executionEngine for reports
+ *  Parameters: executionEngine engine: the engine to name
+ *  Returns: a static string, as the --engine option spells it
+ ***********************************************************************/
+const char *engineName(executionEngine engine)
+{
+        return engine == ENGINE_SPECIALIZED ? "specialized" : "threaded";
 }
 
+/***************************** freeContext() *****************************
+ *  Purpose: Frees a context together with the machine state it owns
+ *  Parameters: executionContext *context: reference to the context
+ *  Returns: None
+ *  Effects: Frees the registers, every segment and the context itself,
+ *           and sets *context to NULL
+ *  Expects: context and *context must exist
+ ***********************************************************************/
+void freeContext(executionContext *context)
+{
+        assert(context != NULL && *context != NULL);
 
+        /* free registers */
+        Seq_free(&(*context)->registers);
+
+        /* free every segment */
+        freeSegmentTable(&(*context)->segments);
+
+        releaseCode(*context);
+        free((*context)->sites);
+        free((*context)->entries);
+        free(*context);
+        *context = NULL;
+}
+
+/******************************** execute() *******************************
+ *  Purpose: Executes the instructions of the entire program.
+ *  Parameters: Segment segment_0: the 0th segment representing all the
+                                 instructions of a program, created with
+                                by the functions in fetcher.c
+ *  Returns: None
+ *  Effects: Runs the program in a fresh, unlimited context and frees it
+ *  Expects: segment_0 must exist, keeps running until halt instruction or end
+ *           of file is reached
+ ***********************************************************************/
+void execute(Segment segment_0)
+{
+        executionContext context = newContext(segment_0);
+        run(context);
+        freeContext(&context);
+}
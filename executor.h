@@ -8,6 +8,12 @@
  *
  *    This file contains the interface for executor, a module that
  *    executes the universal machine instructions of an entire program. 
+ *
+ *    A program runs inside an executionContext, which owns the machine
+ *    state (registers, segments, program counter) and the limits placed
+ *    on it. A context stops cleanly when the program halts or when one
+ *    of its limits is reached; in the latter case its final state stays
+ *    available and run() may be called again to resume it.
  *    
  **************************************************************/
 #ifndef EXECUTOR_H
@@ -21,24 +27,139 @@
 #include "assert.h"
 #include "bitpack.h"
 #include "executor.h"
+#include "heatmap.h"
 #include "instructionSet.h"
+#include "latency.h"
+#include "livestats.h"
 #include "memory.h"
 #include "registers.h"
 #include "seq.h"
 
-typedef struct loadInstruction *loadInstruction;
-typedef struct generalInstruction *generalInstruction;
+typedef struct decodedInstruction *decodedInstruction;
+typedef struct executionContext *executionContext;
 
-loadInstruction 
-unpackLoad(uint32_t instruction);
+/* Why a call to run() returned */
+typedef enum executionStatus {
+        EXECUTION_RUNNING = 0, EXECUTION_HALTED,
+        EXECUTION_INSTRUCTION_LIMIT, EXECUTION_TIMEOUT, 
+        EXECUTION_MEMORY_LIMIT
+} executionStatus;
 
-generalInstruction 
-unpackGeneral(uint32_t instruction);
+/* Most programs runLockstep() runs together */
+#define LOCKSTEP_LANES 8
 
-void 
-unpackInstruction(Seq_T registers, uint32_t instruction);
+/* How run() executes instructions, see setEngine() */
+typedef enum executionEngine {
+        ENGINE_THREADED = 0, ENGINE_SPECIALIZED
+} executionEngine;
+
+/* What requestReport() has a running context call */
+typedef void (*reportCallback)(void *closure, executionContext context);
+
+executionContext
+newContext(Segment segment_0);
+
+void
+setInstructionBudget(executionContext context, uint64_t budget);
+
+void
+setTimeout(executionContext context, double seconds);
+
+void
+setMemoryLimit(executionContext context, uint64_t bytes);
+
+void
+setColdCompression(executionContext context, uint64_t interval);
+
+void
+setLiveStats(executionContext context, liveStats stats);
+
+void
+setHeatMap(executionContext context, heatMap heat);
+
+void
+setLatencyTracker(executionContext context, latencyTracker tracker);
+
+void
+countOpcodes(executionContext context);
+
+void
+setReportCallback(executionContext context, reportCallback report,
+                  void *closure);
+
+void
+requestReport(executionContext context);
+
+void
+setEngine(executionContext context, executionEngine engine);
+
+void
+setExtensions(executionContext context, bool enabled);
+
+void
+setStreams(executionContext context, FILE *input, FILE *output);
+
+void
+setCodeCache(executionContext context, const char *directory);
+
+executionStatus
+run(executionContext context);
+
+void
+runLockstep(executionContext *lanes, int count);
+
+uint32_t
+contextProgramCounter(executionContext context);
+
+uint64_t
+contextInstructions(executionContext context);
+
+uint32_t
+contextRegister(executionContext context, int index);
+
+executionStatus
+contextStatus(executionContext context);
+
+uint64_t
+contextInputBytes(executionContext context);
+
+segmentTable
+contextSegments(executionContext context);
+
+void
+resumeContext(executionContext context, uint32_t pc,
+              const uint32_t registers[8], uint64_t instructions,
+              uint64_t input_bytes);
+
+void
+contextSiteStats(executionContext context, uint64_t *hits, uint64_t *misses);
+
+void
+contextMemoryStats(executionContext context, struct memoryUsage *usage);
+
+uint64_t
+contextJumps(executionContext context);
+
+uint64_t
+contextOutputBytes(executionContext context);
+
+double
+contextFirstOutput(executionContext context);
+
+void
+contextOpcodeCounts(executionContext context, uint64_t counts[16],
+                    uint64_t *looped);
+
+const char *
+statusName(executionStatus status);
+
+const char *
+engineName(executionEngine engine);
+
+void
+freeContext(executionContext *context);
 
 void 
-execute(Seq_T segment_0);
+execute(Segment segment_0);
 
 #endif
\ No newline at end of file
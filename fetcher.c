@@ -18,6 +18,7 @@
 #include "seq.h"
 #include "bitpack.h"
 #include "fetcher.h"
+#include "memory.h"
 
 const int INSTRUCTION_SIZE = 4;
 
@@ -44,16 +45,16 @@ uint32_t packProgramInstructions(unsigned char *word)
  *  Purpose: Read in UM instructions from a file and create a sequence that
  *           contains each instruction of the entire program
  *  Parameters: char *filename: name of file containing UM instructions
- *              Seq_T segment_0: segment to have instructions put into
+ *              Segment segment_0: segment to have instructions put into
  *              int program_size: number of how many instructions are in the
                                   file
  *  Returns: None
- *  Effects: Uses Hanson sequence modules to modify a sequence and calls helper
+ *  Effects: Fills in the words of segment_0 and calls helper
  *           function packProgramInstructions to convert characters in the file
  *           to a 32 bit instruction
  *  Expects: Expects that all parameters exist and the file has UM instructions
  ***********************************************************************/
-void loadProgramInstructions(char *filename, Seq_T segment_0, int program_size)
+void loadProgramInstructions(char *filename, Segment segment_0, int program_size)
 {
         int one_byte; 
         unsigned char word[4];
@@ -79,7 +80,7 @@ void loadProgramInstructions(char *filename, Seq_T segment_0, int program_size)
                         word[inner] = one_byte;
                 }
                 uint32_t packed_word = packProgramInstructions(word);
-                Seq_addhi(segment_0, (void *) (uintptr_t) packed_word);
+                setWord(segment_0, outer, packed_word);
         }
         fclose(fp);
 }
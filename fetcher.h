@@ -20,10 +20,11 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include "bitpack.h"
+#include "memory.h"
 #include "seq.h"
 
 void 
-loadProgramInstructions(char *filename, Seq_T segment_0, int program_size);
+loadProgramInstructions(char *filename, Segment segment_0, int program_size);
 
 uint32_t 
 packProgramInstructions(unsigned char *word);
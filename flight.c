@@ -0,0 +1,172 @@
+/******************************************************************************
+ *
+ *                              flight.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for flight, the flight recorder
+ *    of the um.
+ *
+ *    The executor takes an entry at every LOAD_PROGRAM, since between two
+ *    jumps a program runs straight through its code: the jumps and the
+ *    registers at each are enough to retrace the path to a failure. An
+ *    entry is a fixed size store into a ring whose size is a power of
+ *    two, so recording is a handful of stores per jump and stays on by
+ *    default. A stopped recorder is a ring of one spare entry that is
+ *    never shown, so the executor records without testing anything.
+ *
+ *    The ring is written from signal handlers, so the dump builds its
+ *    lines with signaltext, which uses write() alone. SIGABRT (a failed
+ *    assert ends in abort()), SIGSEGV, SIGBUS, SIGFPE and SIGILL dump the
+ *    ring and then take their default action; SIGUSR2 dumps it and lets the
+ *    program carry on. A dump taken while the program runs may show the
+ *    newest entry half written.
+ *
+ *****************************************************************************/
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "flight.h"
+#include "signaltext.h"
+
+/* The signals that end the um and dump the ring on their way */
+static const int FATAL_SIGNALS[] = { SIGABRT, SIGSEGV, SIGBUS, SIGFPE,
+                                     SIGILL };
+
+/* The one recorder, the spare entry of a stopped recorder, and whether
+the handlers are in place */
+static struct flightEntry spare;
+static struct flightRecorder recorder = { &spare, 0, 0 };
+static bool recording = false;
+static bool installed = false;
+
+/************************** dumpFlightRecorder() **************************
+ *  Purpose: Writes the ring to stderr, oldest jump first
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Writes nothing while the recorder is stopped. Safe to call
+ *           from a signal handler.
+ ***********************************************************************/
+void dumpFlightRecorder(void)
+{
+        if (!recording) {
+                return;
+        }
+        uint64_t count = recorder.count;
+        uint64_t kept = count < (uint64_t) recorder.mask + 1 ?
+                        count : (uint64_t) recorder.mask + 1;
+
+        struct signalLine line = { .length = 0 };
+        lineText(&line, "um: flight recorder: last ");
+        lineDecimal(&line, kept);
+        lineText(&line, " of ");
+        lineDecimal(&line, count);
+        lineText(&line, " jumps, oldest first");
+        writeLine(&line);
+        for (uint64_t i = count - kept; i < count; i++) {
+                const struct flightEntry *entry =
+                        &recorder.entries[i & recorder.mask];
+                lineText(&line, "um:   after ");
+                lineDecimal(&line, entry->instructions);
+                lineText(&line, ": pc ");
+                lineDecimal(&line, entry->from);
+                lineText(&line, " -> ");
+                lineDecimal(&line, entry->to);
+                lineText(&line, ", r =");
+                for (int r = 0; r < 8; r++) {
+                        lineText(&line, " ");
+                        lineHex(&line, entry->registers[r]);
+                }
+                writeLine(&line);
+        }
+}
+
+/**************************** fatalHandler() ****************************
+ *  Purpose: Dumps the ring on the way out of a fatal signal
+ *  Parameters: int signal: the signal
+ *  Returns: None
+ *  Effects: Restores the default action and raises the signal again, so
+ *           the um ends as it would have without the recorder
+ ***********************************************************************/
+static void fatalHandler(int signal)
+{
+        dumpFlightRecorder();
+        struct sigaction fallback;
+        memset(&fallback, 0, sizeof(fallback));
+        fallback.sa_handler = SIG_DFL;
+        sigemptyset(&fallback.sa_mask);
+        sigaction(signal, &fallback, NULL);
+        raise(signal);
+}
+
+/*************************** requestHandler() ***************************
+ *  Purpose: Dumps the ring when asked to with SIGUSR2
+ *  Parameters: int signal: SIGUSR2
+ *  Returns: None
+ ***********************************************************************/
+static void requestHandler(int signal)
+{
+        (void) signal;
+        dumpFlightRecorder();
+}
+
+/************************* startFlightRecorder() *************************
+ *  Purpose: Gives the recorder a ring, or stops it
+ *  Parameters: size_t entries: jumps to keep, rounded up to a power of
+ *                              two, or 0 to stop recording
+ *  Returns: None
+ *  Effects: Forgets the jumps recorded so far. The first call installs
+ *           the handlers that dump the ring, before anything else can
+ *           install its own, so that a module which handles some of the
+ *           same signals (guard.c) falls back to them.
+ *  Expects: No program runs
+ ***********************************************************************/
+void startFlightRecorder(size_t entries)
+{
+        if (recorder.entries != &spare) {
+                free(recorder.entries);
+        }
+        recorder.entries = &spare;
+        recorder.mask = 0;
+        recorder.count = 0;
+        recording = entries != 0;
+        if (recording) {
+                size_t size = 1;
+                while (size < entries && size <= UINT32_MAX / 2) {
+                        size *= 2;
+                }
+                recorder.entries = calloc(size, sizeof(struct flightEntry));
+                assert(recorder.entries != NULL);
+                recorder.mask = size - 1;
+        }
+
+        if (installed) {
+                return;
+        }
+        installed = true;
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        sigemptyset(&action.sa_mask);
+        action.sa_handler = fatalHandler;
+        for (size_t i = 0; i < sizeof(FATAL_SIGNALS) / sizeof(int); i++) {
+                sigaction(FATAL_SIGNALS[i], &action, NULL);
+        }
+        action.sa_handler = requestHandler;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR2, &action, NULL);
+}
+
+/************************** flightRecorderOf() **************************
+ *  Purpose: Gives the executor the recorder to record into
+ *  Parameters: None
+ *  Returns: the recorder, stopped unless startFlightRecorder started it
+ ***********************************************************************/
+flightRecorder flightRecorderOf(void)
+{
+        return &recorder;
+}
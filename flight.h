@@ -0,0 +1,65 @@
+/*************************************************************
+ *
+ *                     flight.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for flight, a module that keeps
+ *    a ring of the last jumps a program took, with its registers at
+ *    each one, and writes it to stderr when the um aborts, dies of a
+ *    fatal signal or receives SIGUSR2.
+ *
+ **************************************************************/
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Entries of the ring unless --flight-recorder says otherwise */
+#define FLIGHT_DEFAULT_ENTRIES 1024
+
+/* One jump: the LOAD_PROGRAM at from, which retired the given number of
+instructions and went to to, and the registers after it */
+struct flightEntry
+{
+        uint64_t instructions;
+        uint32_t from;
+        uint32_t to;
+        uint32_t registers[8];
+};
+
+/* The ring: count entries were recorded so far, the last mask + 1 of
+them are kept, and entries[count & mask] is next */
+typedef struct flightRecorder
+{
+        struct flightEntry *entries;
+        uint32_t mask;
+        uint64_t count;
+} *flightRecorder;
+
+void
+startFlightRecorder(size_t entries);
+
+flightRecorder
+flightRecorderOf(void);
+
+void
+dumpFlightRecorder(void);
+
+/*************************** flightSlot() ***************************
+ *  Purpose: Takes the entry of the ring the next jump goes in
+ *  Parameters: flightRecorder flight: the recorder
+ *  Returns: the entry, which the caller fills in
+ *  Effects: Overwrites the oldest entry once the ring is full. A
+ *           stopped recorder hands out the same spare entry every time.
+ *  Expects: flight comes from flightRecorderOf
+ ******************************************************************/
+static inline struct flightEntry *flightSlot(flightRecorder flight)
+{
+        return &flight->entries[flight->count++ & flight->mask];
+}
+
+#endif
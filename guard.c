@@ -0,0 +1,429 @@
+/******************************************************************************
+ *
+ *                              guard.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for guard, a module that
+ *    allocates segments inside mmap regions followed by inaccessible
+ *    guard pages, and that turns the fault raised by an out of bounds
+ *    access into a precise Universal Machine failure report.
+ *
+ *    A guarded block is placed so that it ends exactly on a page boundary
+ *    and is followed by a span of bytes that are reserved but never
+ *    accessible. By default the span is 16 GiB: since a UM offset is a 32
+ *    bit word index, every offset past the end of a segment then lands in
+ *    its own guard, so loads and stores need no software bounds check at
+ *    all. Each such reservation costs 16 GiB of address space, which caps
+ *    a 47 bit address space at about 8000 live segments. A segment that
+ *    finds no address space left for its guard gets pages without one,
+ *    and a reach of 0, so that its accesses are checked in software.
+ *    guardSetSpan trades coverage for more segments: an offset beyond
+ *    the span (the segment's reach) is then checked in software, so an
+ *    access never lands outside the reservation of its own segment.
+ *
+ *    The same fault handler implements the write barrier on segment 0.
+ *    An executor that caches decoded instructions asks for the page
+ *    holding an instruction to be write protected before caching it; the
+ *    first store to a protected page faults, the page is made writable
+ *    again and the executor is told to forget what it cached from that
+ *    page. Stores to every other segment pay nothing for the detection.
+ *    A page that keeps faulting (code sharing a page with data written in
+ *    a loop) is left writable for good and its instructions are decoded
+ *    without being cached.
+ *
+ *****************************************************************************/
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "guard.h"
+#include "memory.h"
+#include "seq.h"
+#include "signaltext.h"
+
+/* 2^32 words of 4 bytes: the furthest any offset can reach */
+#define FULL_GUARD_SPAN ((size_t) 1 << 34)
+
+/* bytes of guard that follow every guarded block */
+static size_t guard_span = FULL_GUARD_SPAN;
+
+/* Freed reservations of up to RECYCLED_PAGES pages are kept for reuse, 
+   since mmap and munmap cost far more than clearing a few pages. Each 
+   list is linked through the first word of its reservations; blocks
+   allocated without a guard are kept apart from those with one. */
+#define RECYCLED_PAGES 16
+static void *recycled[RECYCLED_PAGES + 1];
+static void *recycled_unguarded[RECYCLED_PAGES + 1];
+
+/* set when a reservation fails, so that no more are tried until a guarded
+   block gives its address space back */
+static bool guard_exhausted = false;
+
+/* faults a page may take before the barrier stops protecting it */
+#define BARRIER_MAX_FAULTS 64
+
+/* segment 0 while it is under the write barrier, and its pages */
+static Segment barrier_code = NULL;
+static char *barrier_start;
+static size_t barrier_pages;
+static bool *barrier_protected;
+static unsigned *barrier_faults;
+static barrierCallback barrier_invalidate;
+static void *barrier_closure;
+
+/* state read by the fault handler to describe a fault */
+static segmentTable watched_segments = NULL;
+static const uint32_t *watched_pc = NULL;
+
+/* What SIGSEGV did before guardInstallHandler, for faults that are not
+ours */
+static struct sigaction fallback_action;
+
+/**************************** roundToPages() ****************************
+ *  Purpose: Rounds a size in bytes up to a whole number of pages
+ *  Parameters: size_t bytes: the size to round
+ *  Returns: the rounded size
+ *  Effects: None
+ *  Expects: None
+ ***********************************************************************/
+static size_t roundToPages(size_t bytes)
+{
+        size_t page = sysconf(_SC_PAGESIZE);
+        return (bytes + page - 1) / page * page;
+}
+
+/***************************** guardSetSpan() *****************************
+ *  Purpose: Changes the size of the guard that follows each block
+ *  Parameters: size_t bytes: the new size, rounded up to whole pages
+ *  Returns: None
+ *  Effects: Blocks allocated from now on get the new guard; their reach,
+ *           the offsets left unchecked, shrinks to the words of the guard
+ *  Expects: No block is currently allocated, bytes must be greater than 0
+ ***********************************************************************/
+void guardSetSpan(size_t bytes)
+{
+        guard_span = roundToPages(bytes);
+        if (guard_span > FULL_GUARD_SPAN) {
+                guard_span = FULL_GUARD_SPAN;
+        }
+}
+
+/***************************** guardReach() *****************************
+ *  Purpose: Tells which offsets the guard span covers
+ *  Parameters: None
+ *  Returns: the number of words in the span, or UINT32_MAX for the full
+ *           span, past which no offset can reach
+ ***********************************************************************/
+static uint32_t guardReach(void)
+{
+        return guard_span >= FULL_GUARD_SPAN ? UINT32_MAX
+                                             : (uint32_t) (guard_span / 4);
+}
+
+/**************************** guardAllocate() ****************************
+ *  Purpose: Allocates a zeroed block that ends on a page boundary and is
+ *           followed by the guard span of inaccessible bytes
+ *  Parameters: size_t bytes: size of the block
+ *              uint32_t *reach: set to the offsets its guard covers, 0 if
+ *                               it has none
+ *  Returns: a pointer to the block
+ *  Effects: Reserves address space with mmap and makes only the pages of
+ *           the block accessible. When the address space for the guard is
+ *           exhausted, the block gets pages of its own without a guard,
+ *           and stderr is told once; no reservation is tried again until
+ *           guardFree gives one back; exits with failure if even those
+ *           cannot be had.
+ *  Expects: bytes must be greater than 0
+ ***********************************************************************/
+void *guardAllocate(size_t bytes, uint32_t *reach)
+{
+        static bool warned = false;
+        size_t usable = roundToPages(bytes);
+        size_t pages = usable / sysconf(_SC_PAGESIZE);
+        *reach = guardReach();
+        if (pages <= RECYCLED_PAGES && recycled[pages] != NULL) {
+                char *base = recycled[pages];
+                recycled[pages] = *(void **) base;
+                memset(base, 0, usable);
+                return base + usable - bytes;
+        }
+
+        char *base = MAP_FAILED;
+        if (!guard_exhausted) {
+                base = mmap(NULL, usable + guard_span, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                            -1, 0);
+        }
+        if (base != MAP_FAILED &&
+            mprotect(base, usable, PROT_READ | PROT_WRITE) == 0) {
+                return base + usable - bytes;
+        }
+        if (base != MAP_FAILED) {
+                munmap(base, usable + guard_span);
+        }
+
+        guard_exhausted = true;
+        *reach = 0;
+        if (pages <= RECYCLED_PAGES && recycled_unguarded[pages] != NULL) {
+                base = recycled_unguarded[pages];
+                recycled_unguarded[pages] = *(void **) base;
+                memset(base, 0, usable);
+                return base + usable - bytes;
+        }
+        if (!warned) {
+                fprintf(stderr, "um: out of address space for guard pages, "
+                                "checking the bounds of further segments "
+                                "(see --guard-span)\n");
+                warned = true;
+        }
+        base = mmap(NULL, usable, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+                fprintf(stderr, "um: out of memory for segments\n");
+                exit(EXIT_FAILURE);
+        }
+        return base + usable - bytes;
+}
+
+/****************************** guardFree() ******************************
+ *  Purpose: Releases a block allocated by guardAllocate, with its guard
+ *  Parameters: void *block: the block to release
+ *              size_t bytes: size the block was allocated with
+ *              bool guarded: whether it got a guard (a reach other than 0)
+ *  Returns: None
+ *  Effects: Keeps small blocks for reuse and unmaps the others along
+ *           with their guard, which lets guarded blocks be tried again
+ *  Expects: block must come from guardAllocate(bytes)
+ ***********************************************************************/
+void guardFree(void *block, size_t bytes, bool guarded)
+{
+        size_t usable = roundToPages(bytes);
+        size_t pages = usable / sysconf(_SC_PAGESIZE);
+        char *base = (char *) block + bytes - usable;
+        if (pages <= RECYCLED_PAGES) {
+                void **list = guarded ? recycled : recycled_unguarded;
+                *(void **) base = list[pages];
+                list[pages] = base;
+        } else if (guarded) {
+                munmap(base, usable + guard_span);
+                guard_exhausted = false;
+        } else {
+                munmap(base, usable);
+        }
+}
+
+/***************************** barrierAttach() *****************************
+ *  Purpose: Puts segment 0 under the write barrier
+ *  Parameters: Segment code: segment 0, allocated by guardAllocate
+ *              barrierCallback invalidate: called from the fault handler
+ *                                          with closure and the range of
+ *                                          words of a page that was written
+ *              void *closure: passed back to invalidate
+ *  Returns: None
+ *  Effects: All pages start writable; barrierCache protects them one by
+ *           one as instructions get cached
+ *  Expects: No other segment is under the barrier
+ ***********************************************************************/
+void barrierAttach(Segment code, barrierCallback invalidate, void *closure)
+{
+        assert(barrier_code == NULL);
+        size_t page = sysconf(_SC_PAGESIZE);
+        char *end = (char *) (code->words + code->length);
+
+        barrier_start = (char *) ((uintptr_t) code / page * page);
+        barrier_pages = roundToPages(end - barrier_start) / page;
+        barrier_protected = calloc(barrier_pages, sizeof(bool));
+        barrier_faults = calloc(barrier_pages, sizeof(unsigned));
+        assert(barrier_protected != NULL && barrier_faults != NULL);
+        barrier_invalidate = invalidate;
+        barrier_closure = closure;
+        barrier_code = code;
+}
+
+/***************************** barrierDetach() *****************************
+ *  Purpose: Takes segment 0 out of the write barrier
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Makes every page of the segment writable again, so that it
+ *           may be freed
+ *  Expects: None
+ ***********************************************************************/
+void barrierDetach(void)
+{
+        if (barrier_code == NULL) {
+                return;
+        }
+        size_t page = sysconf(_SC_PAGESIZE);
+        mprotect(barrier_start, barrier_pages * page, PROT_READ | PROT_WRITE);
+        free(barrier_protected);
+        free(barrier_faults);
+        barrier_code = NULL;
+}
+
+/***************************** barrierCache() *****************************
+ *  Purpose: Protects the page holding a word of segment 0 before the
+ *           executor caches the instruction decoded from it
+ *  Parameters: uint32_t index: the index of the word in segment 0
+ *  Returns: true if the page is protected and the instruction may be
+ *           cached, false if the page is left writable for good
+ *  Effects: May write protect a page of segment 0
+ *  Expects: A segment is under the barrier and index is within it
+ ***********************************************************************/
+bool barrierCache(uint32_t index)
+{
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t number = ((char *) &barrier_code->words[index] - 
+                         barrier_start) / page;
+        if (barrier_protected[number]) {
+                return true;
+        }
+        if (barrier_faults[number] >= BARRIER_MAX_FAULTS) {
+                return false;
+        }
+        mprotect(barrier_start + number * page, page, PROT_READ);
+        barrier_protected[number] = true;
+        return true;
+}
+
+/*************************** barrierFault() ***************************
+ *  Purpose: Handles a store to a write protected page of segment 0
+ *  Parameters: char *address: the faulting address
+ *  Returns: true if the fault was a barrier fault and has been handled
+ *  Effects: Makes the page writable again, so that the store is retried
+ *           when the handler returns, and invalidates its words
+ *  Expects: Only called from the fault handler
+ ***********************************************************************/
+static bool barrierFault(char *address)
+{
+        size_t page = sysconf(_SC_PAGESIZE);
+        if (barrier_code == NULL || address < barrier_start ||
+            address >= barrier_start + barrier_pages * page) {
+                return false;
+        }
+        size_t number = (address - barrier_start) / page;
+        if (!barrier_protected[number]) {
+                return false;
+        }
+        char *first = barrier_start + number * page;
+        mprotect(first, page, PROT_READ | PROT_WRITE);
+        barrier_protected[number] = false;
+        barrier_faults[number]++;
+
+        /* the words of segment 0 that lie within the page */
+        char *words = (char *) barrier_code->words;
+        uint32_t low = first <= words ? 0 : (first - words) / 4;
+        uint32_t high = (first + page - words) / 4;
+        if (high > barrier_code->length) {
+                high = barrier_code->length;
+        }
+        if (low < high) {
+                barrier_invalidate(barrier_closure, low, high - low);
+        }
+        return true;
+}
+
+/****************************** guardWatch() ******************************
+ *  Purpose: Tells the fault handler where to find the segments and the
+ *           program counter of the program being executed
+ *  Parameters: segmentTable table: the segments mapped during program
+ *                                  execution, or NULL once the program
+ *                                  stops executing
+ *              const uint32_t *program_counter: the program counter
+ *  Returns: None
+ *  Effects: Replaces the state used to describe a fault
+ *  Expects: program_counter must stay valid while it is watched
+ ***********************************************************************/
+void guardWatch(segmentTable table, const uint32_t *program_counter)
+{
+        watched_segments = table;
+        watched_pc = program_counter;
+}
+
+/**************************** faultHandler() ****************************
+ *  Purpose: Reports a fault inside the guard of a segment as a UM failure
+ *  Parameters: int signal: SIGSEGV
+ *              siginfo_t *info: holds the faulting address
+ *              void *context: unused
+ *  Returns: None
+ *  Effects: If the address belongs to the guard of a mapped segment,
+ *           writes the pc, segment id and offset to stderr and exits with
+ *           failure. Only offsets within a segment's reach go unchecked,
+ *           and reservations never overlap, so the guard that holds the
+ *           address is that of the segment accessed. Otherwise restores 
+ *           the action that was in place before the handler (the flight
+ *           recorder's, or the default), which takes over when the fault
+ *           is raised again once the handler returns.
+ *           The report is built with signaltext and written with write()
+ *           alone, which is all a signal handler may use; output the 
+ *           program left buffered in stdio is lost, as in any crash.
+ *  Expects: Only installed by guardInstallHandler
+ ***********************************************************************/
+static void faultHandler(int signal, siginfo_t *info, void *context)
+{
+        (void) context;
+        char *address = info->si_addr;
+        if (barrierFault(address)) {
+                return;
+        }
+
+        uint32_t count = watched_segments == NULL ? 0
+                                                  : watched_segments->count;
+        for (uint32_t id = 0; id < count; id++) {
+                Segment segment = watched_segments->segments[id];
+                if (segment == NULL || segment->reach == 0) {
+                        continue;
+                }
+                char *words = (char *) segment->words;
+                char *end = (char *) (segment->words + segment->length);
+                if (address < end || address >= end + guard_span) {
+                        continue;
+                }
+
+                struct signalLine report = { .length = 0 };
+                lineText(&report, "um: segment access out of bounds at pc ");
+                lineDecimal(&report, watched_pc == NULL ? 0 : *watched_pc);
+                lineText(&report, ": segment ");
+                lineDecimal(&report, id);
+                lineText(&report, ", offset ");
+                lineDecimal(&report, (uint64_t) (address - words) / 4);
+                lineText(&report, " (length ");
+                lineDecimal(&report, segment->length);
+                lineText(&report, ")");
+                writeLine(&report);
+                _exit(EXIT_FAILURE);
+        }
+
+        /* not a guard fault: let the previous action take over */
+        sigaction(signal, &fallback_action, NULL);
+}
+
+/*************************** guardInstallHandler() ***************************
+ *  Purpose: Installs the handler that reports faults in guard pages
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Replaces the process' SIGSEGV action, keeping the one it
+ *           replaces for faults outside the guards
+ *  Expects: None
+ ***********************************************************************/
+void guardInstallHandler(void)
+{
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = faultHandler;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        struct sigaction previous;
+        sigaction(SIGSEGV, &action, &previous);
+        if ((previous.sa_flags & SA_SIGINFO) == 0 ||
+            previous.sa_sigaction != faultHandler) {
+                fallback_action = previous;
+        }
+}
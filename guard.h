@@ -0,0 +1,53 @@
+/*************************************************************
+ *
+ *                     guard.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for guard, a module that
+ *    allocates segments inside mmap regions followed by inaccessible
+ *    guard pages, and that turns the fault raised by an out of bounds
+ *    access into a precise Universal Machine failure report. It also
+ *    implements the write barrier that detects stores to segment 0.
+ *
+ **************************************************************/
+#ifndef GUARD_H
+#define GUARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "seq.h"
+
+/* Told which words of segment 0 were written: (closure, first, count) */
+typedef void (*barrierCallback)(void *closure, uint32_t first, 
+                                uint32_t count);
+
+void
+guardSetSpan(size_t bytes);
+
+void *
+guardAllocate(size_t bytes, uint32_t *reach);
+
+void
+guardFree(void *block, size_t bytes, bool guarded);
+
+void
+guardInstallHandler(void);
+
+void
+guardWatch(segmentTable table, const uint32_t *program_counter);
+
+void
+barrierAttach(Segment code, barrierCallback invalidate, void *closure);
+
+void
+barrierDetach(void);
+
+bool
+barrierCache(uint32_t index);
+
+#endif
@@ -0,0 +1,278 @@
+/******************************************************************************
+ *
+ *                              heatmap.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for heatmap, the record of
+ *    where a program's loads and stores go that --heatmap writes.
+ *
+ *    Each segment identifier has an array of chunks, grown by doubling
+ *    the first time an access falls past its end, so recording an access
+ *    is two increments and a compare in the common case. Time is counted
+ *    in windows of HEAT_WINDOW instructions, which the executor advances
+ *    at block boundaries, as it does for its limits. A chunk remembers
+ *    the last window it was used in; the first access in a new window
+ *    adds the chunk to that window's working set, so the curve costs
+ *    nothing more per access.
+ *
+ *    Identifiers are what the program sees, so the segments MAP gives
+ *    the same identifier after an UNMAP are counted together, as one
+ *    array the program keeps reallocating.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "heatmap.h"
+#include "timing.h"
+
+/****************************** newHeatMap() ******************************
+ *  Purpose: Creates an empty heat map, in its first window
+ *  Parameters: None
+ *  Returns: the heat map
+ *  Effects: Takes now as the start of the first window
+ ***********************************************************************/
+heatMap newHeatMap(void)
+{
+        heatMap heat = calloc(1, sizeof(struct heatMap));
+        assert(heat != NULL);
+        heat->window_capacity = 16;
+        heat->window_chunks = calloc(heat->window_capacity,
+                                     sizeof(uint64_t));
+        heat->window_starts = calloc(heat->window_capacity,
+                                     sizeof(double));
+        assert(heat->window_chunks != NULL && heat->window_starts != NULL);
+        heat->started = clockNow(CLOCK_MONOTONIC);
+        return heat;
+}
+
+/******************************* heatGrow() *******************************
+ *  Purpose: Makes room for a chunk past those known so far
+ *  Parameters: heatMap heat: the heat map
+ *              uint32_t identifier: the segment
+ *              uint32_t chunk: the chunk within it
+ *  Returns: None
+ *  Effects: Grows the identifiers and the chunks of the segment by
+ *           doubling; new chunks have no accesses and were never used
+ *  Expects: heat must exist
+ ***********************************************************************/
+void heatGrow(heatMap heat, uint32_t identifier, uint32_t chunk)
+{
+        assert(heat != NULL);
+        if (identifier >= heat->capacity) {
+                uint32_t capacity = heat->capacity == 0 ? 16 :
+                                    heat->capacity;
+                while (capacity <= identifier) {
+                        assert(capacity <= UINT32_MAX / 2);
+                        capacity *= 2;
+                }
+                heat->chunks = realloc(heat->chunks,
+                                       capacity * sizeof(*heat->chunks));
+                heat->chunk_counts = realloc(heat->chunk_counts, capacity *
+                                             sizeof(*heat->chunk_counts));
+                assert(heat->chunks != NULL && heat->chunk_counts != NULL);
+                for (uint32_t i = heat->capacity; i < capacity; i++) {
+                        heat->chunks[i] = NULL;
+                        heat->chunk_counts[i] = 0;
+                }
+                heat->capacity = capacity;
+        }
+
+        uint32_t count = heat->chunk_counts[identifier];
+        if (chunk < count) {
+                return;
+        }
+        uint32_t grown = count == 0 ? 1 : count;
+        while (grown <= chunk) {
+                grown *= 2;
+        }
+        struct heatChunk *chunks = realloc(heat->chunks[identifier],
+                                           grown * sizeof(*chunks));
+        assert(chunks != NULL);
+        for (uint32_t i = count; i < grown; i++) {
+                chunks[i].loads = 0;
+                chunks[i].stores = 0;
+                chunks[i].first = HEAT_NEVER;
+                chunks[i].last = HEAT_NEVER;
+        }
+        heat->chunks[identifier] = chunks;
+        heat->chunk_counts[identifier] = grown;
+}
+
+/******************************* heatTouch() *******************************
+ *  Purpose: Records that a chunk is used in the current window
+ *  Parameters: heatMap heat: the heat map
+ *              struct heatChunk *chunk: a chunk not yet used in it
+ *  Returns: None
+ *  Effects: Adds the chunk to the working set of the window
+ *  Expects: heat and chunk must exist
+ ***********************************************************************/
+void heatTouch(heatMap heat, struct heatChunk *chunk)
+{
+        if (chunk->first == HEAT_NEVER) {
+                chunk->first = heat->window;
+        }
+        chunk->last = heat->window;
+        heat->window_chunks[heat->window]++;
+}
+
+/***************************** heatNextWindow() *****************************
+ *  Purpose: Starts the next window of instructions
+ *  Parameters: heatMap heat: the heat map
+ *  Returns: None
+ *  Effects: Takes now as the start of the window
+ *  Expects: heat must exist
+ ***********************************************************************/
+void heatNextWindow(heatMap heat)
+{
+        assert(heat != NULL && heat->window < HEAT_NEVER - 1);
+        heat->window++;
+        if (heat->window == heat->window_capacity) {
+                heat->window_capacity *= 2;
+                heat->window_chunks = realloc(heat->window_chunks,
+                                              heat->window_capacity *
+                                              sizeof(uint64_t));
+                heat->window_starts = realloc(heat->window_starts,
+                                              heat->window_capacity *
+                                              sizeof(double));
+                assert(heat->window_chunks != NULL &&
+                       heat->window_starts != NULL);
+        }
+        heat->window_chunks[heat->window] = 0;
+        heat->window_starts[heat->window] = clockNow(CLOCK_MONOTONIC) - 
+                                            heat->started;
+}
+
+/****************************** putSegment() ******************************
+ *  Purpose: Writes the rows of one segment of the heat map
+ *  Parameters: FILE *file: where to write
+ *              heatMap heat: the heat map
+ *              uint32_t identifier: the segment
+ *  Returns: None
+ *  Effects: Writes a total row, with * for the chunk, when any chunk was
+ *           used, followed by a row per chunk used if more than one was
+ ***********************************************************************/
+static void putSegment(FILE *file, heatMap heat, uint32_t identifier)
+{
+        const struct heatChunk *chunks = heat->chunks[identifier];
+        struct heatChunk total = { 0, 0, HEAT_NEVER, 0 };
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < heat->chunk_counts[identifier]; i++) {
+                if (chunks[i].first == HEAT_NEVER) {
+                        continue;
+                }
+                used++;
+                total.loads += chunks[i].loads;
+                total.stores += chunks[i].stores;
+                if (chunks[i].first < total.first) {
+                        total.first = chunks[i].first;
+                }
+                if (chunks[i].last > total.last) {
+                        total.last = chunks[i].last;
+                }
+        }
+        if (used == 0) {
+                return;
+        }
+        fprintf(file, "%" PRIu32 "\t*\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu32
+                      "\t%" PRIu32 "\n", identifier, total.loads,
+                total.stores, total.first, total.last);
+        if (used == 1) {
+                return;
+        }
+        for (uint32_t i = 0; i < heat->chunk_counts[identifier]; i++) {
+                if (chunks[i].first != HEAT_NEVER) {
+                        fprintf(file, "%" PRIu32 "\t%" PRIu32 "\t%" PRIu64
+                                      "\t%" PRIu64 "\t%" PRIu32 "\t%"
+                                      PRIu32 "\n", identifier, i,
+                                chunks[i].loads, chunks[i].stores,
+                                chunks[i].first, chunks[i].last);
+                }
+        }
+}
+
+/***************************** writeHeatMap() *****************************
+ *  Purpose: Writes the heat map and the working set curve
+ *  Parameters: heatMap heat: the heat map
+ *              const char *path: where to write the heat map; the curve
+ *                                goes to path.wss
+ *  Returns: None
+ *  Effects: Both are tab separated text with a commented header. The
+ *           heat map has a row per segment used and, for a segment of
+ *           more than one chunk, a row per chunk used; the curve has a
+ *           row per window. Says on stderr when a file cannot be written.
+ *  Expects: heat and path must exist
+ ***********************************************************************/
+void writeHeatMap(heatMap heat, const char *path)
+{
+        assert(heat != NULL && path != NULL);
+        FILE *file = fopen(path, "w");
+        if (file == NULL) {
+                fprintf(stderr, "um: heatmap %s: %s\n", path,
+                        strerror(errno));
+                return;
+        }
+        fprintf(file, "# um heatmap: SEG_LOADs and SEG_STOREs per segment "
+                      "and per %u KiB chunk\n# first and last are windows "
+                      "of %u instructions (see %s.wss)\n"
+                      "# segment\tchunk\tloads\tstores\tfirst\tlast\n",
+                (1u << HEAT_CHUNK_SHIFT) * 4 / 1024, HEAT_WINDOW, path);
+        for (uint32_t i = 0; i < heat->capacity; i++) {
+                putSegment(file, heat, i);
+        }
+        fclose(file);
+
+        size_t length = strlen(path);
+        char *curve = malloc(length + sizeof(".wss"));
+        assert(curve != NULL);
+        memcpy(curve, path, length);
+        memcpy(curve + length, ".wss", sizeof(".wss"));
+        file = fopen(curve, "w");
+        if (file == NULL) {
+                fprintf(stderr, "um: heatmap %s: %s\n", curve,
+                        strerror(errno));
+                free(curve);
+                return;
+        }
+        fprintf(file, "# um working set: chunks used in each window of %u "
+                      "instructions\n# window\tinstruction\tseconds\t"
+                      "chunks\tkib\n", HEAT_WINDOW);
+        for (uint32_t w = 0; w <= heat->window; w++) {
+                fprintf(file, "%" PRIu32 "\t%" PRIu64 "\t%.6f\t%" PRIu64
+                              "\t%" PRIu64 "\n", w, (uint64_t) w *
+                                                    HEAT_WINDOW,
+                        heat->window_starts[w], heat->window_chunks[w],
+                        heat->window_chunks[w] *
+                        ((1u << HEAT_CHUNK_SHIFT) * 4 / 1024));
+        }
+        fclose(file);
+        free(curve);
+}
+
+/****************************** freeHeatMap() ******************************
+ *  Purpose: Frees a heat map
+ *  Parameters: heatMap *heat: reference to the heat map
+ *  Returns: None
+ *  Effects: Sets *heat to NULL
+ *  Expects: heat and *heat must exist
+ ***********************************************************************/
+void freeHeatMap(heatMap *heat)
+{
+        assert(heat != NULL && *heat != NULL);
+        for (uint32_t i = 0; i < (*heat)->capacity; i++) {
+                free((*heat)->chunks[i]);
+        }
+        free((*heat)->chunks);
+        free((*heat)->chunk_counts);
+        free((*heat)->window_chunks);
+        free((*heat)->window_starts);
+        free(*heat);
+        *heat = NULL;
+}
@@ -0,0 +1,101 @@
+/*************************************************************
+ *
+ *                     heatmap.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for heatmap, a module that
+ *    records where a program's SEG_LOADs and SEG_STOREs go (--heatmap):
+ *    per segment identifier and per 4 KiB chunk of each segment, how
+ *    many loads and stores it took and the first and last window of
+ *    instructions in which it was used, together with how many chunks
+ *    each window touched, the program's working set over time.
+ *
+ **************************************************************/
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A chunk is 1 << HEAT_CHUNK_SHIFT words, 4 KiB */
+#define HEAT_CHUNK_SHIFT 10
+
+/* Instructions per window of the working set curve */
+#define HEAT_WINDOW (1u << 22)
+
+/* The accesses to one chunk, and the windows it was first and last used
+in (HEAT_NEVER until it is) */
+struct heatChunk
+{
+        uint64_t loads;
+        uint64_t stores;
+        uint32_t first;
+        uint32_t last;
+};
+
+#define HEAT_NEVER UINT32_MAX
+
+/* Struct that holds the chunks of each segment identifier, and the
+working set of each window so far */
+typedef struct heatMap
+{
+        struct heatChunk **chunks;
+        uint32_t *chunk_counts;
+        uint32_t capacity;
+        uint32_t window;
+        uint64_t *window_chunks;
+        double *window_starts;
+        uint32_t window_capacity;
+        double started;
+} *heatMap;
+
+heatMap
+newHeatMap(void);
+
+void
+heatGrow(heatMap heat, uint32_t identifier, uint32_t chunk);
+
+void
+heatTouch(heatMap heat, struct heatChunk *chunk);
+
+void
+heatNextWindow(heatMap heat);
+
+void
+writeHeatMap(heatMap heat, const char *path);
+
+void
+freeHeatMap(heatMap *heat);
+
+/***************************** heatRecord() *****************************
+ *  Purpose: Records a SEG_LOAD or SEG_STORE
+ *  Parameters: heatMap heat: the heat map
+ *              uint32_t identifier: the segment accessed
+ *              uint32_t offset: the word accessed
+ *              bool store: whether it was a store
+ *  Returns: None
+ *  Effects: Counts the access against its chunk; the first access to a
+ *           chunk in a window goes through heatTouch, and one past the
+ *           chunks known so far through heatGrow
+ *  Expects: heat must exist
+ ***********************************************************************/
+static inline void heatRecord(heatMap heat, uint32_t identifier,
+                              uint32_t offset, bool store)
+{
+        uint32_t index = offset >> HEAT_CHUNK_SHIFT;
+        if (__builtin_expect(identifier >= heat->capacity ||
+                             index >= heat->chunk_counts[identifier], 0)) {
+                heatGrow(heat, identifier, index);
+        }
+        struct heatChunk *chunk = &heat->chunks[identifier][index];
+        chunk->loads += !store;
+        chunk->stores += store;
+        if (chunk->last != heat->window) {
+                heatTouch(heat, chunk);
+        }
+}
+
+#endif
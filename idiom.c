@@ -0,0 +1,427 @@
+/******************************************************************************
+ *
+ *                              idiom.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for idiom, a module that
+ *    recognizes the canonical copy, fill and compare loops of segment 0
+ *    and runs them as bulk operations.
+ *
+ *    A loop is described as a pattern of instructions over roles (T, S,
+ *    I, ...) rather than registers. Matching a pattern binds each role to
+ *    a register, and the registers a loop writes must not be used for any
+ *    other role. Before running a loop in bulk, runIdiom checks what the
+ *    pattern assumes of the register values (the step is 1, the count
+ *    goes down by 1, the jumps stay in segment 0, every access is in
+ *    bounds); if any check fails the loop is left to the interpreter,
+ *    which then fails exactly where it would have.
+ *
+ *    The loops, continuing to LOOP while C is not 0 and then to EXIT:
+ *
+ *        copy                    copy, two indices       fill
+ *        sload  T, S, I          sload  T, S, I          sstore D, J, V
+ *        sstore D, I, T          sstore D, J, T          add    J, J, K
+ *        add    I, I, K          add    I, I, K          add    C, C, M
+ *        add    C, C, M          add    J, J, K          lv     X, LOOP
+ *        lv     X, LOOP          add    C, C, M          lv     Y, EXIT
+ *        lv     Y, EXIT          lv     X, LOOP          cmov   Y, X, C
+ *        cmov   Y, X, C          lv     Y, EXIT          loadp  Z, Y
+ *        loadp  Z, Y             cmov   Y, X, C
+ *                                loadp  Z, Y
+ *
+ *    and compare, two blocks that leave for MISMATCH when the words of
+ *    S and D at I differ, leaving their difference in U (X holds a word
+ *    only until it is needed for the jump, so the loop fits in 8 
+ *    registers):
+ *
+ *        sload  X, S, I          add    I, I, K
+ *        sload  U, D, I          add    C, C, M
+ *        nand   U, U, U          lv     X, LOOP
+ *        add    U, U, X          lv     Y, EXIT
+ *        add    U, U, K          cmov   Y, X, C
+ *        lv     X, SECOND        loadp  Z, Y
+ *        lv     Y, MISMATCH
+ *        cmov   X, Y, U
+ *        loadp  Z, X
+ *
+ *    where K holds 1, M holds 0xffffffff and Z holds 0. The operands of
+ *    each add may come in either order.
+ *
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "idiom.h"
+#include "isa.h"
+#include "memory.h"
+
+typedef enum idiomRole {
+        ROLE_T, ROLE_U, ROLE_S, ROLE_D, ROLE_I, ROLE_J, ROLE_C,
+        ROLE_K, ROLE_M, ROLE_V, ROLE_X, ROLE_Y, ROLE_Z, ROLE_COUNT,
+        ROLE_ANY = ROLE_COUNT
+} idiomRole;
+
+/* Values a LOAD_VAL of a pattern must load, or captures */
+typedef enum idiomValue {
+        VALUE_LOOP, VALUE_SECOND, VALUE_EXIT, VALUE_MISMATCH
+} idiomValue;
+
+/* One instruction of a pattern; for LOAD_VAL, b is an idiomValue */
+typedef struct idiomStep {
+        uint8_t opcode, a, b, c;
+} idiomStep;
+
+#define MAX_STEPS 16
+
+typedef struct idiomPattern {
+        idiomKind kind;
+        int length;
+        idiomStep steps[MAX_STEPS];
+        /* bit set of the roles the loop writes */
+        unsigned written;
+} idiomPattern;
+
+#define ROLE(role) (1u << (role))
+
+#define LOOP_EXIT                                               \
+        { LOAD_VAL, ROLE_X, VALUE_LOOP, 0 },                    \
+        { LOAD_VAL, ROLE_Y, VALUE_EXIT, 0 },                    \
+        { COND_MOV, ROLE_Y, ROLE_X, ROLE_C },                   \
+        { LOAD_PROGRAM, ROLE_ANY, ROLE_Z, ROLE_Y }
+
+static const idiomPattern patterns[] = {
+        { IDIOM_COPY, 8, {
+                { SEG_LOAD, ROLE_T, ROLE_S, ROLE_I },
+                { SEG_STORE, ROLE_D, ROLE_I, ROLE_T },
+                { ADD, ROLE_I, ROLE_I, ROLE_K },
+                { ADD, ROLE_C, ROLE_C, ROLE_M },
+                LOOP_EXIT },
+          ROLE(ROLE_T) | ROLE(ROLE_I) | ROLE(ROLE_C) | ROLE(ROLE_X) |
+          ROLE(ROLE_Y) },
+        { IDIOM_COPY, 9, {
+                { SEG_LOAD, ROLE_T, ROLE_S, ROLE_I },
+                { SEG_STORE, ROLE_D, ROLE_J, ROLE_T },
+                { ADD, ROLE_I, ROLE_I, ROLE_K },
+                { ADD, ROLE_J, ROLE_J, ROLE_K },
+                { ADD, ROLE_C, ROLE_C, ROLE_M },
+                LOOP_EXIT },
+          ROLE(ROLE_T) | ROLE(ROLE_I) | ROLE(ROLE_J) | ROLE(ROLE_C) |
+          ROLE(ROLE_X) | ROLE(ROLE_Y) },
+        { IDIOM_FILL, 7, {
+                { SEG_STORE, ROLE_D, ROLE_J, ROLE_V },
+                { ADD, ROLE_J, ROLE_J, ROLE_K },
+                { ADD, ROLE_C, ROLE_C, ROLE_M },
+                LOOP_EXIT },
+          ROLE(ROLE_J) | ROLE(ROLE_C) | ROLE(ROLE_X) | ROLE(ROLE_Y) },
+        { IDIOM_COMPARE, 15, {
+                { SEG_LOAD, ROLE_X, ROLE_S, ROLE_I },
+                { SEG_LOAD, ROLE_U, ROLE_D, ROLE_I },
+                { NAND, ROLE_U, ROLE_U, ROLE_U },
+                { ADD, ROLE_U, ROLE_U, ROLE_X },
+                { ADD, ROLE_U, ROLE_U, ROLE_K },
+                { LOAD_VAL, ROLE_X, VALUE_SECOND, 0 },
+                { LOAD_VAL, ROLE_Y, VALUE_MISMATCH, 0 },
+                { COND_MOV, ROLE_X, ROLE_Y, ROLE_U },
+                { LOAD_PROGRAM, ROLE_ANY, ROLE_Z, ROLE_X },
+                { ADD, ROLE_I, ROLE_I, ROLE_K },
+                { ADD, ROLE_C, ROLE_C, ROLE_M },
+                LOOP_EXIT },
+          ROLE(ROLE_U) | ROLE(ROLE_I) | ROLE(ROLE_C) | ROLE(ROLE_X) |
+          ROLE(ROLE_Y) }
+};
+
+#define PATTERN_COUNT (sizeof(patterns) / sizeof(patterns[0]))
+
+/* Position of the second block of a compare loop */
+#define COMPARE_SECOND 9
+
+/* A pattern matched at a word: the register of each role and the targets
+of its jumps */
+typedef struct idiomMatch {
+        const idiomPattern *pattern;
+        int reg[ROLE_COUNT];
+        uint32_t start, exit, mismatch;
+} idiomMatch;
+
+/***************************** bindRole() *****************************
+ *  Purpose: Binds a role to a register, or checks an earlier binding
+ *  Returns: true if the role is (now) bound to that register
+ ***********************************************************************/
+static bool bindRole(idiomMatch *match, int role, unsigned reg)
+{
+        if (role == ROLE_ANY) {
+                return true;
+        }
+        if (match->reg[role] < 0) {
+                match->reg[role] = reg;
+        }
+        return match->reg[role] == (int) reg;
+}
+
+/***************************** matchStep() *****************************
+ *  Purpose: Matches one instruction against one step of a pattern
+ *  Parameters: idiomMatch *match: bindings so far, extended on success
+ *              const idiomStep *step: the step
+ *              uint32_t word: the instruction
+ *  Returns: true if the instruction fits the step
+ ***********************************************************************/
+static bool matchStep(idiomMatch *match, const idiomStep *step,
+                      uint32_t word)
+{
+        if (Um_opcodeOf(word) != step->opcode) {
+                return false;
+        }
+        if (step->opcode == LOAD_VAL) {
+                uint32_t value = Um_lvValue(word);
+                switch (step->b) {
+                        case VALUE_LOOP:
+                        if (value != match->start) {
+                                return false;
+                        }
+                        break;
+                        case VALUE_SECOND:
+                        if (value != match->start + COMPARE_SECOND) {
+                                return false;
+                        }
+                        break;
+                        case VALUE_EXIT:
+                        match->exit = value;
+                        break;
+                        default:
+                        match->mismatch = value;
+                }
+                return bindRole(match, step->a, Um_lvRegister(word));
+        }
+
+        idiomMatch saved = *match;
+        if (bindRole(match, step->a, Um_ra(word)) &&
+            bindRole(match, step->b, Um_rb(word)) &&
+            bindRole(match, step->c, Um_rc(word))) {
+                return true;
+        }
+        *match = saved;
+        if (step->opcode != ADD) {
+                return false;
+        }
+        /* addition commutes */
+        return bindRole(match, step->a, Um_ra(word)) &&
+               bindRole(match, step->b, Um_rc(word)) &&
+               bindRole(match, step->c, Um_rb(word));
+}
+
+/**************************** matchPattern() ****************************
+ *  Purpose: Matches a pattern against the words of segment 0 at pc
+ *  Returns: true if every step matches and the registers written by the
+ *           loop are used for nothing else
+ ***********************************************************************/
+static bool matchPattern(const idiomPattern *pattern, const uint32_t *words,
+                         uint32_t length, uint32_t pc, idiomMatch *match)
+{
+        if ((uint64_t) pc + pattern->length > length) {
+                return false;
+        }
+        match->pattern = pattern;
+        match->start = pc;
+        for (int role = 0; role < ROLE_COUNT; role++) {
+                match->reg[role] = -1;
+        }
+        for (int i = 0; i < pattern->length; i++) {
+                if (!matchStep(match, &pattern->steps[i], words[pc + i])) {
+                        return false;
+                }
+        }
+        for (int role = 0; role < ROLE_COUNT; role++) {
+                if (!(pattern->written & ROLE(role))) {
+                        continue;
+                }
+                for (int other = 0; other < ROLE_COUNT; other++) {
+                        if (other != role && match->reg[other] >= 0 &&
+                            match->reg[other] == match->reg[role]) {
+                                return false;
+                        }
+                }
+        }
+        return true;
+}
+
+/****************************** findIdiom() ******************************
+ *  Purpose: Tells which loop, if any, starts at a word of segment 0
+ *  Parameters: const uint32_t *words: the words of segment 0
+ *              uint32_t length: how many there are
+ *              uint32_t pc: the word, a LOAD_PROGRAM target
+ *  Returns: the kind of loop, or IDIOM_NONE
+ *  Effects: None; the result only depends on the words, so callers may
+ *           keep it as long as they re-run the check through runIdiom
+ ***********************************************************************/
+idiomKind findIdiom(const uint32_t *words, uint32_t length, uint32_t pc)
+{
+        idiomMatch match;
+        for (unsigned i = 0; i < PATTERN_COUNT; i++) {
+                if (matchPattern(&patterns[i], words, length, pc, &match)) {
+                        return patterns[i].kind;
+                }
+        }
+        return IDIOM_NONE;
+}
+
+/**************************** segmentRange() ****************************
+ *  Purpose: Finds the words a loop will access in a segment
+ *  Parameters: segmentTable table: the segments of the program
+ *              uint32_t identifier: the segment
+ *              uint32_t first: index of the first word
+ *              uint64_t count: number of words
+ *  Returns: a pointer to the first word, or NULL if the segment does not
+ *           exist or the words are not all inside it
+ ***********************************************************************/
+static uint32_t *segmentRange(segmentTable table, uint32_t identifier,
+                              uint32_t first, uint64_t count)
+{
+        if (!segmentMapped(table, identifier) || 
+            first + count > table->lengths[identifier]) {
+                return NULL;
+        }
+        return getSegment(table, identifier)->words + first;
+}
+
+/******************************* runIdiom() *******************************
+ *  Purpose: Runs the loop starting at pc in bulk
+ *  Parameters: const uint32_t *words, uint32_t length: segment 0
+ *              uint32_t *pc: the loop's first word; set to where the
+ *                            interpreter continues
+ *              uint32_t r[8]: the registers, updated as the loop would
+ *              segmentTable table: the segments of the program
+ *              uint64_t max_instructions: how many instructions the loop
+ *                                         may retire at most
+ *              uint32_t *loop_length: where to store the words of the
+ *                                     loop, which it went through in 
+ *                                     order until it retired as many
+ *  Returns: the number of instructions retired, or 0 if the loop was left
+ *           to the interpreter (nothing is changed then)
+ *  Effects: Stops after the last whole iteration allowed by
+ *           max_instructions, in which case *pc is the loop's start again.
+ *           A compare that finds a difference stops partway through an
+ *           iteration.
+ *  Expects: Segment 0 is not a destination of the loop (checked)
+ ***********************************************************************/
+uint64_t runIdiom(const uint32_t *words, uint32_t length, uint32_t *pc,
+                  uint32_t r[8], segmentTable table,
+                  uint64_t max_instructions, uint32_t *loop_length)
+{
+        idiomMatch match;
+        unsigned i;
+        for (i = 0; i < PATTERN_COUNT; i++) {
+                if (matchPattern(&patterns[i], words, length, *pc, &match)) {
+                        break;
+                }
+        }
+        if (i == PATTERN_COUNT) {
+                return 0;
+        }
+        const int *reg = match.reg;
+        const idiomPattern *pattern = match.pattern;
+        bool compare = pattern->kind == IDIOM_COMPARE;
+
+        /* what the pattern assumes of the register values */
+        if (r[reg[ROLE_K]] != 1 || r[reg[ROLE_M]] != UINT32_MAX ||
+            r[reg[ROLE_Z]] != 0 || r[reg[ROLE_C]] == 0 ||
+            match.exit >= length ||
+            (compare && match.mismatch >= length)) {
+                return 0;
+        }
+        uint64_t count = r[reg[ROLE_C]];
+        if (count > max_instructions / pattern->length) {
+                count = max_instructions / pattern->length;
+        }
+        if (count == 0) {
+                return 0;
+        }
+
+        uint32_t *source = NULL, *destination = NULL;
+        uint32_t index = 0, first = 0;
+        if (pattern->kind != IDIOM_FILL) {
+                index = r[reg[ROLE_I]];
+                source = segmentRange(table, r[reg[ROLE_S]],
+                                      index, count);
+        }
+        if (pattern->kind == IDIOM_COPY && reg[ROLE_J] < 0) {
+                first = index;
+        } else if (pattern->kind == IDIOM_COMPARE) {
+                first = index;
+        } else {
+                first = r[reg[ROLE_J]];
+        }
+        destination = segmentRange(table, r[reg[ROLE_D]], first, count);
+        if (destination == NULL || (pattern->kind != IDIOM_FILL &&
+                                    source == NULL)) {
+                return 0;
+        }
+        if (!compare && r[reg[ROLE_D]] == 0) {
+                /* stores into the code are left to the interpreter */
+                return 0;
+        }
+        *loop_length = pattern->length;
+
+        uint64_t done = count;
+        uint64_t retired = count * pattern->length;
+        switch (pattern->kind) {
+                case IDIOM_COPY:
+                if (destination <= source || destination >= source + count) {
+                        memmove(destination, source, count * 4);
+                } else {
+                        /* overlapping forwards: repeat as the loop does */
+                        for (uint64_t k = 0; k < count; k++) {
+                                destination[k] = source[k];
+                        }
+                }
+                r[reg[ROLE_T]] = source[count - 1];
+                break;
+
+                case IDIOM_FILL:
+                for (uint64_t k = 0; k < count; k++) {
+                        destination[k] = r[reg[ROLE_V]];
+                }
+                break;
+
+                default:
+                for (done = 0; done < count; done++) {
+                        if (source[done] != destination[done]) {
+                                break;
+                        }
+                }
+                if (done < count) {
+                        /* the words differ: leave from the first block */
+                        r[reg[ROLE_I]] += done;
+                        r[reg[ROLE_C]] -= done;
+                        r[reg[ROLE_U]] = source[done] - destination[done];
+                        r[reg[ROLE_X]] = match.mismatch;
+                        r[reg[ROLE_Y]] = match.mismatch;
+                        *pc = match.mismatch;
+                        return done * pattern->length + COMPARE_SECOND;
+                }
+                r[reg[ROLE_U]] = 0;
+        }
+        if (!compare && table->dirty != NULL) {
+                markWrittenRange(table, r[reg[ROLE_D]], first, count);
+        }
+
+        if (pattern->kind != IDIOM_FILL) {
+                r[reg[ROLE_I]] += done;
+        }
+        if (reg[ROLE_J] >= 0) {
+                r[reg[ROLE_J]] += done;
+        }
+        r[reg[ROLE_C]] -= done;
+        r[reg[ROLE_X]] = match.start;
+        if (r[reg[ROLE_C]] == 0) {
+                r[reg[ROLE_Y]] = match.exit;
+                *pc = match.exit;
+        } else {
+                r[reg[ROLE_Y]] = match.start;
+                *pc = match.start;
+        }
+        return retired;
+}
@@ -0,0 +1,34 @@
+/*************************************************************
+ *
+ *                     idiom.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for idiom, a module that
+ *    recognizes the canonical copy, fill and compare loops of segment 0
+ *    and runs them as bulk operations on the segments they touch, leaving
+ *    the registers exactly as interpreting the loop would.
+ *
+ **************************************************************/
+#ifndef IDIOM_H
+#define IDIOM_H
+
+#include <stdint.h>
+#include "memory.h"
+
+/* What findIdiom knows about the block starting at a word */
+typedef enum idiomKind {
+        IDIOM_UNKNOWN = 0, IDIOM_NONE, IDIOM_COPY, IDIOM_FILL, IDIOM_COMPARE
+} idiomKind;
+
+idiomKind
+findIdiom(const uint32_t *words, uint32_t length, uint32_t pc);
+
+uint64_t
+runIdiom(const uint32_t *words, uint32_t length, uint32_t *pc, uint32_t r[8],
+         segmentTable table, uint64_t max_instructions,
+         uint32_t *loop_length);
+
+#endif
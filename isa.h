@@ -0,0 +1,237 @@
+/*************************************************************
+ *
+ *                     isa.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the one description of the Universal Machine
+ *    instruction set. UM_ISA lists every opcode once, in opcode order,
+ *    with its mnemonic and the operands it uses; the opcode enum, the
+ *    encoders used by umlab.c, the disassembler and the executor's
+ *    dispatch table are all generated from it.
+ *
+ *    Operand formats:
+ *        NONE   no operands                     halt
+ *        C      register C                      out r1
+ *        BC     registers B and C               loadp r1, r2
+ *        ABC    registers A, B and C            add r1, r2, r3
+ *        AV     register A and a 25 bit value   lv r1, 72
+ *
+ *    The last two opcodes, HCALL and RESIZE, are not part of the 
+ *    Universal Machine: they ask the host to copy, fill or resize 
+ *    segments in bulk, and are invalid instructions unless the program
+ *    runs with the extensions enabled (um --ext).
+ *
+ *    Everything here is static inline so that field extraction is a
+ *    constant shift and mask at each use.
+ *
+ **************************************************************/
+#ifndef ISA_H
+#define ISA_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* X(name, mnemonic, format) for each opcode, in opcode order; HCALL and
+RESIZE are extensions, valid only when the executor enables them */
+#define UM_ISA(X)                               \
+        X(COND_MOV,     cmov,   ABC)            \
+        X(SEG_LOAD,     sload,  ABC)            \
+        X(SEG_STORE,    sstore, ABC)            \
+        X(ADD,          add,    ABC)            \
+        X(MULT,         mul,    ABC)            \
+        X(DIV,          div,    ABC)            \
+        X(NAND,         nand,   ABC)            \
+        X(HALT,         halt,   NONE)           \
+        X(MAP,          map,    BC)             \
+        X(UNMAP,        unmap,  C)              \
+        X(OUTPUT,       out,    C)              \
+        X(INPUT,        in,     C)              \
+        X(LOAD_PROGRAM, loadp,  BC)             \
+        X(LOAD_VAL,     lv,     AV)             \
+        X(HCALL,        hcall,  ABC)            \
+        X(RESIZE,       resize, BC)
+
+typedef uint32_t Um_instruction;
+
+typedef enum Um_opcode {
+#define UM_ENUM(name, mnemonic, format) name,
+        UM_ISA(UM_ENUM)
+#undef UM_ENUM
+        UM_OPCODE_COUNT
+} Um_opcode;
+
+/* Operations of HCALL A, B, C, selected by $r[A]. The operands are the 
+words of segment $r[B] from offset $r[C]:
+        UM_HCALL_COPY   target, target offset, source, source offset, count
+        UM_HCALL_FILL   target, target offset, value, count */
+typedef enum Um_hypercall {
+        UM_HCALL_COPY = 0, UM_HCALL_FILL
+} Um_hypercall;
+
+/* Largest value a LOAD_VAL can hold */
+#define UM_VALUE_MAX ((1u << 25) - 1)
+
+/******************************** decoder ********************************
+ *  Purpose: Extract the fields of an instruction word
+ *  Parameters: Um_instruction word: an instruction
+ *  Returns: the opcode, a register number within 0-7, or the value of a
+ *           LOAD_VAL
+ *  Expects: Um_ra, Um_rb and Um_rc are meant for three register
+ *           instructions, Um_lvRegister and Um_lvValue for LOAD_VAL
+ ***********************************************************************/
+static inline unsigned Um_opcodeOf(Um_instruction word)
+{
+        return word >> 28;
+}
+
+static inline unsigned Um_ra(Um_instruction word)
+{
+        return (word >> 6) & 7;
+}
+
+static inline unsigned Um_rb(Um_instruction word)
+{
+        return (word >> 3) & 7;
+}
+
+static inline unsigned Um_rc(Um_instruction word)
+{
+        return word & 7;
+}
+
+static inline unsigned Um_lvRegister(Um_instruction word)
+{
+        return (word >> 25) & 7;
+}
+
+static inline uint32_t Um_lvValue(Um_instruction word)
+{
+        return word & UM_VALUE_MAX;
+}
+
+/******************************** encoders ********************************
+ *  Purpose: Um_pack builds a three register instruction; UM_ISA then
+ *           generates one encoder per opcode named after its mnemonic,
+ *           taking only the operands of its format, e.g. Um_add(a, b, c),
+ *           Um_loadp(b, c), Um_halt() and Um_lv(a, value)
+ *  Returns: the instruction word
+ *  Expects: registers within 0-7 and values within UM_VALUE_MAX
+ ***********************************************************************/
+static inline Um_instruction Um_pack(Um_opcode op, unsigned ra, unsigned rb,
+                                     unsigned rc)
+{
+        return (uint32_t) op << 28 | (ra & 7) << 6 | (rb & 7) << 3 | (rc & 7);
+}
+
+#define UM_ENCODER_NONE(name, mnemonic)                                 \
+        static inline Um_instruction Um_##mnemonic(void)                \
+        {                                                               \
+                return Um_pack(name, 0, 0, 0);                          \
+        }
+#define UM_ENCODER_C(name, mnemonic)                                    \
+        static inline Um_instruction Um_##mnemonic(unsigned rc)         \
+        {                                                               \
+                return Um_pack(name, 0, 0, rc);                         \
+        }
+#define UM_ENCODER_BC(name, mnemonic)                                   \
+        static inline Um_instruction Um_##mnemonic(unsigned rb,         \
+                                                   unsigned rc)         \
+        {                                                               \
+                return Um_pack(name, 0, rb, rc);                        \
+        }
+#define UM_ENCODER_ABC(name, mnemonic)                                  \
+        static inline Um_instruction Um_##mnemonic(unsigned ra,         \
+                                                   unsigned rb,         \
+                                                   unsigned rc)         \
+        {                                                               \
+                return Um_pack(name, ra, rb, rc);                       \
+        }
+#define UM_ENCODER_AV(name, mnemonic)                                   \
+        static inline Um_instruction Um_##mnemonic(unsigned ra,         \
+                                                   uint32_t value)      \
+        {                                                               \
+                return (uint32_t) name << 28 | (ra & 7) << 25 |         \
+                       (value & UM_VALUE_MAX);                          \
+        }
+#define UM_ENCODER(name, mnemonic, format) UM_ENCODER_##format(name, mnemonic)
+UM_ISA(UM_ENCODER)
+#undef UM_ENCODER
+
+/**************************** operand triples ****************************
+ *  Purpose: Generate code for every combination of register operands.
+ *           UM_EACH_C(X, ...) expands to X(..., c) for c in 0-7, 
+ *           UM_EACH_B(X, ...) to X(..., b, c) for the 64 pairs and 
+ *           UM_EACH_A(X, ...) to X(..., a, b, c) for the 512 triples, 
+ *           with each register number a literal that can be pasted into
+ *           names
+ ***********************************************************************/
+#define UM_EACH_C(X, ...)                                               \
+        X(__VA_ARGS__, 0) X(__VA_ARGS__, 1) X(__VA_ARGS__, 2)           \
+        X(__VA_ARGS__, 3) X(__VA_ARGS__, 4) X(__VA_ARGS__, 5)           \
+        X(__VA_ARGS__, 6) X(__VA_ARGS__, 7)
+#define UM_EACH_B(X, ...)                                               \
+        UM_EACH_C(X, __VA_ARGS__, 0) UM_EACH_C(X, __VA_ARGS__, 1)       \
+        UM_EACH_C(X, __VA_ARGS__, 2) UM_EACH_C(X, __VA_ARGS__, 3)       \
+        UM_EACH_C(X, __VA_ARGS__, 4) UM_EACH_C(X, __VA_ARGS__, 5)       \
+        UM_EACH_C(X, __VA_ARGS__, 6) UM_EACH_C(X, __VA_ARGS__, 7)
+#define UM_EACH_A(X, ...)                                               \
+        UM_EACH_B(X, __VA_ARGS__, 0) UM_EACH_B(X, __VA_ARGS__, 1)       \
+        UM_EACH_B(X, __VA_ARGS__, 2) UM_EACH_B(X, __VA_ARGS__, 3)       \
+        UM_EACH_B(X, __VA_ARGS__, 4) UM_EACH_B(X, __VA_ARGS__, 5)       \
+        UM_EACH_B(X, __VA_ARGS__, 6) UM_EACH_B(X, __VA_ARGS__, 7)
+
+/***************************** Um_mnemonic() *****************************
+ *  Purpose: Names an opcode
+ *  Parameters: unsigned opcode: an opcode within 0-15
+ *  Returns: a static string, "invalid" for opcodes outside the ISA
+ ***********************************************************************/
+static inline const char *Um_mnemonic(unsigned opcode)
+{
+        switch (opcode) {
+#define UM_NAME(name, mnemonic, format) case name: return #mnemonic;
+                UM_ISA(UM_NAME)
+#undef UM_NAME
+        }
+        return "invalid";
+}
+
+/**************************** Um_disassemble() ****************************
+ *  Purpose: Writes the assembly form of an instruction, listing only the
+ *           operands its format uses
+ *  Parameters: Um_instruction word: the instruction
+ *              char *text: where to write
+ *              size_t size: room in text, 32 is always enough
+ *  Returns: None
+ ***********************************************************************/
+#define UM_PRINT_NONE(word, text, size, mnemonic)                       \
+        snprintf(text, size, "%s", mnemonic)
+#define UM_PRINT_C(word, text, size, mnemonic)                          \
+        snprintf(text, size, "%s r%u", mnemonic, Um_rc(word))
+#define UM_PRINT_BC(word, text, size, mnemonic)                         \
+        snprintf(text, size, "%s r%u, r%u", mnemonic, Um_rb(word),      \
+                 Um_rc(word))
+#define UM_PRINT_ABC(word, text, size, mnemonic)                        \
+        snprintf(text, size, "%s r%u, r%u, r%u", mnemonic, Um_ra(word), \
+                 Um_rb(word), Um_rc(word))
+#define UM_PRINT_AV(word, text, size, mnemonic)                         \
+        snprintf(text, size, "%s r%u, %u", mnemonic,                    \
+                 Um_lvRegister(word), (unsigned) Um_lvValue(word))
+
+static inline void Um_disassemble(Um_instruction word, char *text,
+                                  size_t size)
+{
+        switch (Um_opcodeOf(word)) {
+#define UM_PRINT(name, mnemonic, format)                                \
+                case name:                                              \
+                UM_PRINT_##format(word, text, size, #mnemonic);         \
+                return;
+                UM_ISA(UM_PRINT)
+#undef UM_PRINT
+        }
+        snprintf(text, size, "invalid");
+}
+
+#endif
@@ -0,0 +1,325 @@
+/******************************************************************************
+ *
+ *                              latency.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for latency, the command
+ *    latencies of --latency.
+ *
+ *    The executor tells the tracker when INPUT is about to wait for a
+ *    byte, what it read, and when OUTPUT writes, with the instructions
+ *    retired so far; INPUT and the first OUTPUT of a command read the
+ *    monotonic clock, every other OUTPUT costs a test. A command is the
+ *    work between the newline that ends a line of input and the next
+ *    INPUT, which is where an interactive program waits for its user.
+ *    A command that writes nothing has no response latency but still
+ *    counts its instructions.
+ *
+ *    A histogram has a bucket for each value below 2^HISTOGRAM_BITS and,
+ *    above that, 2^(HISTOGRAM_BITS - 1) buckets for each power of two,
+ *    as in HdrHistogram: every value is kept to within 1.6% over the
+ *    whole range of 64 bit counts, in a fixed 30 KiB. Percentiles are
+ *    the highest value of the bucket they fall in.
+ *
+ *****************************************************************************/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "latency.h"
+#include "timing.h"
+
+/* Precision of a histogram, and how many buckets that takes */
+#define HISTOGRAM_BITS 7
+#define HISTOGRAM_HALF (1u << (HISTOGRAM_BITS - 1))
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_BITS + 2) * HISTOGRAM_HALF)
+
+/* Most expensive commands kept, and how much of each one's text */
+#define LATENCY_TOP 5
+#define COMMAND_TEXT 48
+
+struct histogram
+{
+        uint64_t counts[HISTOGRAM_BUCKETS];
+        uint64_t total;
+        uint64_t max;
+};
+
+/* A command, as kept among the most expensive */
+struct command
+{
+        uint64_t instructions;
+        double busy;
+        char text[COMMAND_TEXT];
+};
+
+/* Struct that holds the histograms, the most expensive commands, the
+command in progress, if any, and the line being read */
+struct latencyTracker
+{
+        struct histogram response;
+        struct histogram busy;
+        struct histogram instructions;
+        struct command top[LATENCY_TOP];
+        uint64_t commands;
+
+        bool open;
+        bool answered;
+        double started;
+        uint64_t start_retired;
+        char text[COMMAND_TEXT];
+
+        char line[COMMAND_TEXT];
+        size_t line_length;
+};
+
+/****************************** bucketOf() ******************************
+ *  Purpose: Finds the bucket of a value
+ *  Parameters: uint64_t value: the value
+ *  Returns: its bucket: the value itself below 2^HISTOGRAM_BITS, and
+ *           above, its power of two and its next HISTOGRAM_BITS - 1 bits
+ ***********************************************************************/
+static unsigned bucketOf(uint64_t value)
+{
+        if (value < 2 * HISTOGRAM_HALF) {
+                return (unsigned) value;
+        }
+        unsigned shift = 63 - __builtin_clzll(value) - (HISTOGRAM_BITS - 1);
+        return shift * HISTOGRAM_HALF + (unsigned) (value >> shift);
+}
+
+/**************************** bucketHighest() ****************************
+ *  Purpose: Finds the highest value that falls in a bucket
+ *  Parameters: unsigned bucket: the bucket
+ *  Returns: the value
+ ***********************************************************************/
+static uint64_t bucketHighest(unsigned bucket)
+{
+        if (bucket < 2 * HISTOGRAM_HALF) {
+                return bucket;
+        }
+        unsigned shift = bucket / HISTOGRAM_HALF - 1;
+        uint64_t mantissa = bucket - shift * HISTOGRAM_HALF;
+        return ((mantissa + 1) << shift) - 1;
+}
+
+/***************************** addValue() *****************************
+ *  Purpose: Adds a value to a histogram
+ *  Parameters: struct histogram *histogram: the histogram
+ *              uint64_t value: the value
+ *  Returns: None
+ ***********************************************************************/
+static void addValue(struct histogram *histogram, uint64_t value)
+{
+        histogram->counts[bucketOf(value)]++;
+        histogram->total++;
+        if (value > histogram->max) {
+                histogram->max = value;
+        }
+}
+
+/***************************** percentile() *****************************
+ *  Purpose: Finds a percentile of a histogram
+ *  Parameters: const struct histogram *histogram: a histogram that is
+ *                                                 not empty
+ *              double fraction: the percentile, within 0-1
+ *  Returns: the highest value of the bucket it falls in, at most the
+ *           highest value added
+ ***********************************************************************/
+static uint64_t percentile(const struct histogram *histogram,
+                           double fraction)
+{
+        uint64_t rank = (uint64_t) (fraction * histogram->total + 0.999999);
+        if (rank == 0) {
+                rank = 1;
+        }
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                seen += histogram->counts[i];
+                if (seen >= rank) {
+                        uint64_t highest = bucketHighest(i);
+                        return highest < histogram->max ? highest :
+                                                          histogram->max;
+                }
+        }
+        return histogram->max;
+}
+
+/************************** newLatencyTracker() **************************
+ *  Purpose: Creates a tracker with no commands
+ *  Parameters: None
+ *  Returns: the tracker
+ ***********************************************************************/
+latencyTracker newLatencyTracker(void)
+{
+        latencyTracker tracker = calloc(1, sizeof(struct latencyTracker));
+        assert(tracker != NULL);
+        return tracker;
+}
+
+/**************************** keepCommand() ****************************
+ *  Purpose: Keeps a command among the most expensive if it is one
+ *  Parameters: latencyTracker tracker: the tracker
+ *              uint64_t instructions: what the command executed
+ *              double busy: the seconds it took
+ *  Returns: None
+ *  Effects: top stays sorted by instructions, most first
+ ***********************************************************************/
+static void keepCommand(latencyTracker tracker, uint64_t instructions,
+                        double busy)
+{
+        int slot = LATENCY_TOP;
+        while (slot > 0 &&
+               tracker->top[slot - 1].instructions < instructions) {
+                slot--;
+        }
+        if (slot == LATENCY_TOP) {
+                return;
+        }
+        memmove(&tracker->top[slot + 1], &tracker->top[slot],
+                (LATENCY_TOP - 1 - slot) * sizeof(struct command));
+        tracker->top[slot].instructions = instructions;
+        tracker->top[slot].busy = busy;
+        memcpy(tracker->top[slot].text, tracker->text, COMMAND_TEXT);
+}
+
+/**************************** latencyWaiting() ****************************
+ *  Purpose: Ends the command in progress, as INPUT is about to wait
+ *  Parameters: latencyTracker tracker: the tracker
+ *              uint64_t retired: instructions retired before the INPUT
+ *  Returns: None
+ *  Effects: Adds the command's instructions and busy time to their
+ *           histograms
+ *  Expects: tracker must exist
+ ***********************************************************************/
+void latencyWaiting(latencyTracker tracker, uint64_t retired)
+{
+        if (!tracker->open) {
+                return;
+        }
+        tracker->open = false;
+        uint64_t instructions = retired - tracker->start_retired;
+        double busy = clockNow(CLOCK_MONOTONIC) - tracker->started;
+        addValue(&tracker->instructions, instructions);
+        addValue(&tracker->busy, (uint64_t) (busy * 1e9));
+        tracker->commands++;
+        keepCommand(tracker, instructions, busy);
+}
+
+/***************************** latencyRead() *****************************
+ *  Purpose: Follows the byte INPUT read
+ *  Parameters: latencyTracker tracker: the tracker
+ *              int byte: the byte, or EOF
+ *              uint64_t retired: instructions retired with the INPUT
+ *  Returns: None
+ *  Effects: A newline starts a command, named by the line it ends
+ *  Expects: tracker must exist
+ ***********************************************************************/
+void latencyRead(latencyTracker tracker, int byte, uint64_t retired)
+{
+        if (byte == EOF) {
+                return;
+        }
+        if (byte != '\n') {
+                if (tracker->line_length < COMMAND_TEXT - 1) {
+                        tracker->line[tracker->line_length++] =
+                                byte >= ' ' && byte < 127 ? byte : '?';
+                }
+                return;
+        }
+        tracker->line[tracker->line_length] = '\0';
+        memcpy(tracker->text, tracker->line, COMMAND_TEXT);
+        tracker->line_length = 0;
+        tracker->open = true;
+        tracker->answered = false;
+        tracker->start_retired = retired;
+        tracker->started = clockNow(CLOCK_MONOTONIC);
+}
+
+/**************************** latencyOutput() ****************************
+ *  Purpose: Follows an OUTPUT
+ *  Parameters: latencyTracker tracker: the tracker
+ *  Returns: None
+ *  Effects: The first OUTPUT of a command adds its response latency to
+ *           the histogram
+ *  Expects: tracker must exist
+ ***********************************************************************/
+void latencyOutput(latencyTracker tracker)
+{
+        if (tracker->open && !tracker->answered) {
+                tracker->answered = true;
+                double seconds = clockNow(CLOCK_MONOTONIC) - 
+                                 tracker->started;
+                addValue(&tracker->response, (uint64_t) (seconds * 1e9));
+        }
+}
+
+/**************************** putHistogram() ****************************
+ *  Purpose: Writes the percentiles of a histogram on stderr
+ *  Parameters: const char *name: what it holds
+ *              const struct histogram *histogram: the histogram
+ *              double scale: what to divide values by
+ *              const char *unit: the unit after dividing
+ *  Returns: None
+ ***********************************************************************/
+static void putHistogram(const char *name, const struct histogram *histogram,
+                         double scale, const char *unit)
+{
+        fprintf(stderr, "um:   %-13s", name);
+        if (histogram->total == 0) {
+                fprintf(stderr, " none\n");
+                return;
+        }
+        fprintf(stderr, " p50 %.4g%s, p99 %.4g%s, p99.9 %.4g%s, "
+                        "max %.4g%s (%" PRIu64 ")\n",
+                percentile(histogram, 0.5) / scale, unit,
+                percentile(histogram, 0.99) / scale, unit,
+                percentile(histogram, 0.999) / scale, unit,
+                histogram->max / scale, unit, histogram->total);
+}
+
+/**************************** reportLatency() ****************************
+ *  Purpose: Describes on stderr how the program answered its commands
+ *  Parameters: latencyTracker tracker: the tracker
+ *  Returns: None
+ *  Effects: Reports the commands finished so far
+ *  Expects: tracker must exist
+ ***********************************************************************/
+void reportLatency(latencyTracker tracker)
+{
+        assert(tracker != NULL);
+        fflush(stdout);
+        fprintf(stderr, "um: latency: %" PRIu64 " commands\n",
+                tracker->commands);
+        putHistogram("response", &tracker->response, 1e6, " ms");
+        putHistogram("busy", &tracker->busy, 1e6, " ms");
+        putHistogram("instructions", &tracker->instructions, 1, "");
+        for (int i = 0; i < LATENCY_TOP && i < (int) tracker->commands;
+             i++) {
+                const struct command *command = &tracker->top[i];
+                fprintf(stderr, "um:   %s %" PRIu64 " instructions in "
+                                "%.3f ms: \"%s\"\n",
+                        i == 0 ? "costliest:" : "          ",
+                        command->instructions, command->busy * 1e3,
+                        command->text);
+        }
+}
+
+/************************** freeLatencyTracker() **************************
+ *  Purpose: Frees a tracker
+ *  Parameters: latencyTracker *tracker: reference to the tracker
+ *  Returns: None
+ *  Effects: Sets *tracker to NULL
+ *  Expects: tracker and *tracker must exist
+ ***********************************************************************/
+void freeLatencyTracker(latencyTracker *tracker)
+{
+        assert(tracker != NULL && *tracker != NULL);
+        free(*tracker);
+        *tracker = NULL;
+}
@@ -0,0 +1,45 @@
+/*************************************************************
+ *
+ *                     latency.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for latency, a module that
+ *    measures how an interactive program answers its commands
+ *    (--latency). A command starts when INPUT reads a newline; its
+ *    response latency runs to the first OUTPUT after that, and it ends
+ *    when the program next asks for INPUT. The latencies and the
+ *    instructions of each command go into log-linear (HDR style)
+ *    histograms, reported with their p50, p99 and p99.9 and the most
+ *    expensive commands.
+ *
+ **************************************************************/
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct latencyTracker *latencyTracker;
+
+latencyTracker
+newLatencyTracker(void);
+
+void
+latencyWaiting(latencyTracker tracker, uint64_t retired);
+
+void
+latencyRead(latencyTracker tracker, int byte, uint64_t retired);
+
+void
+latencyOutput(latencyTracker tracker);
+
+void
+reportLatency(latencyTracker tracker);
+
+void
+freeLatencyTracker(latencyTracker *tracker);
+
+#endif
@@ -0,0 +1,191 @@
+/******************************************************************************
+ *
+ *                              livestats.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for livestats, the shared page
+ *    of counters of a running um (--live-stats).
+ *
+ *    The page is a file in /dev/shm that the um maps shared and rewrites
+ *    every time the executor publishes, a few times a second. Readers map
+ *    it read only and never write, so they cannot disturb the um; they
+ *    tell a consistent copy from a torn one by the sequence number, which
+ *    the um makes odd before it writes and even again after (a seqlock).
+ *    The um removes its page when it exits; a page left behind by a um
+ *    that was killed names a pid that no longer exists, and may have
+ *    been left odd. A reader therefore checks the pid before it copies
+ *    and gives up after READ_ATTEMPTS tries, so it never spins forever.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "livestats.h"
+#include "timing.h"
+
+/* Identifies a page and the layout of struct liveStatsPage */
+static const char LIVE_STATS_MAGIC[8] = "UMLIVE1";
+
+/* Copies readLiveStats tries before it calls a page not ready; the um
+writes a page in well under a microsecond */
+#define READ_ATTEMPTS 1000
+
+/* Struct that holds the page of this um, and the counters at the start
+of the second the rates are measured over */
+struct liveStats
+{
+        struct liveStatsPage *page;
+        char path[64];
+        double window_start;
+        struct liveCounters window;
+};
+
+/***************************** openLiveStats() *****************************
+ *  Purpose: Creates the page of this um
+ *  Parameters: const char *program: the program it runs, for readers
+ *  Returns: the page, with every counter 0
+ *  Effects: Creates /dev/shm/um.<pid>; exits if it cannot
+ *  Expects: program must exist
+ ***********************************************************************/
+liveStats openLiveStats(const char *program)
+{
+        assert(program != NULL);
+        liveStats stats = malloc(sizeof(struct liveStats));
+        assert(stats != NULL);
+        snprintf(stats->path, sizeof(stats->path), "%s/%s%ld",
+                 LIVE_STATS_DIRECTORY, LIVE_STATS_PREFIX, (long) getpid());
+
+        int fd = open(stats->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1 ||
+            ftruncate(fd, sizeof(struct liveStatsPage)) != 0) {
+                fprintf(stderr, "um: live statistics %s: %s\n", stats->path,
+                        strerror(errno));
+                exit(EXIT_FAILURE);
+        }
+        stats->page = mmap(NULL, sizeof(struct liveStatsPage),
+                           PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        assert(stats->page != MAP_FAILED);
+
+        struct liveStatsPage *page = stats->page;
+        memset(page, 0, sizeof(*page));
+        page->pid = getpid();
+        const char *name = strrchr(program, '/');
+        name = name == NULL ? program : name + 1;
+        strncpy(page->program, name, sizeof(page->program) - 1);
+        strcpy(page->state, "starting");
+        page->started = clockNow(CLOCK_REALTIME);
+        page->updated = page->started;
+        stats->window_start = clockNow(CLOCK_MONOTONIC);
+        memset(&stats->window, 0, sizeof(stats->window));
+
+        /* readers ignore the page until the magic is in place */
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(page->magic, LIVE_STATS_MAGIC, sizeof(LIVE_STATS_MAGIC));
+        return stats;
+}
+
+/*************************** publishLiveStats() ***************************
+ *  Purpose: Rewrites the page with the latest counters
+ *  Parameters: liveStats stats: the page
+ *              const struct liveCounters *counters: the counters
+ *              const char *state: what the program is doing
+ *  Returns: None
+ *  Effects: Recomputes the rates once a second has passed since they
+ *           were last computed
+ *  Expects: stats, counters and state must exist
+ ***********************************************************************/
+void publishLiveStats(liveStats stats, const struct liveCounters *counters,
+                      const char *state)
+{
+        assert(stats != NULL && counters != NULL && state != NULL);
+        struct liveStatsPage *page = stats->page;
+        double now = clockNow(CLOCK_MONOTONIC);
+        double elapsed = now - stats->window_start;
+
+        __atomic_store_n(&page->sequence, page->sequence + 1,
+                         __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        page->counters = *counters;
+        strncpy(page->state, state, sizeof(page->state) - 1);
+        page->updated = clockNow(CLOCK_REALTIME);
+        if (elapsed >= 1) {
+                page->mips = (counters->instructions -
+                              stats->window.instructions) / elapsed / 1e6;
+                page->map_rate = (counters->maps - stats->window.maps) /
+                                 elapsed;
+                page->unmap_rate = (counters->unmaps -
+                                    stats->window.unmaps) / elapsed;
+                stats->window_start = now;
+                stats->window = *counters;
+        }
+        __atomic_store_n(&page->sequence, page->sequence + 1,
+                         __ATOMIC_RELEASE);
+}
+
+/**************************** closeLiveStats() ****************************
+ *  Purpose: Removes the page of this um
+ *  Parameters: liveStats *stats: reference to the page
+ *  Returns: None
+ *  Effects: Unmaps and deletes the file; sets *stats to NULL
+ *  Expects: stats and *stats must exist
+ ***********************************************************************/
+void closeLiveStats(liveStats *stats)
+{
+        assert(stats != NULL && *stats != NULL);
+        munmap((*stats)->page, sizeof(struct liveStatsPage));
+        unlink((*stats)->path);
+        free(*stats);
+        *stats = NULL;
+}
+
+/***************************** readLiveStats() *****************************
+ *  Purpose: Copies a page another um is writing
+ *  Parameters: const struct liveStatsPage *page: the page, mapped
+ *              struct liveStatsPage *copy: where to copy it
+ *  Returns: false if the page is not one, its um is no longer alive, or
+ *           it is not ready (still being written after READ_ATTEMPTS
+ *           tries)
+ *  Effects: Copies the page again until no write overlapped the copy,
+ *           yielding the processor to the writer between tries
+ *  Expects: page and copy must exist
+ ***********************************************************************/
+bool readLiveStats(const struct liveStatsPage *page,
+                   struct liveStatsPage *copy)
+{
+        assert(page != NULL && copy != NULL);
+        /* the pid is written once, before the page is first published */
+        int64_t pid = __atomic_load_n(&page->pid, __ATOMIC_RELAXED);
+        if (pid <= 0 || (kill((pid_t) pid, 0) != 0 && errno != EPERM)) {
+                return false;
+        }
+        for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+                uint64_t before = __atomic_load_n(&page->sequence,
+                                                  __ATOMIC_ACQUIRE);
+                if (before % 2 == 0) {
+                        memcpy(copy, (const void *) page, sizeof(*copy));
+                        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                        if (__atomic_load_n(&page->sequence,
+                                            __ATOMIC_RELAXED) == before) {
+                                copy->program[sizeof(copy->program) - 1] =
+                                        '\0';
+                                copy->state[sizeof(copy->state) - 1] = '\0';
+                                return memcmp(copy->magic, LIVE_STATS_MAGIC,
+                                              sizeof(LIVE_STATS_MAGIC)) == 0;
+                        }
+                }
+                sched_yield();
+        }
+        return false;
+}
@@ -0,0 +1,73 @@
+/*************************************************************
+ *
+ *                     livestats.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for livestats, a module that
+ *    publishes the counters of a running um in a small shared memory
+ *    file, /dev/shm/um.<pid>, for um-top and other readers to watch
+ *    without stopping or slowing the program.
+ *
+ **************************************************************/
+#ifndef LIVESTATS_H
+#define LIVESTATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Where the pages are, and what their names start with */
+#define LIVE_STATS_DIRECTORY "/dev/shm"
+#define LIVE_STATS_PREFIX "um."
+
+/* What the executor reports each time it publishes */
+struct liveCounters
+{
+        uint64_t instructions;
+        uint64_t segments;
+        uint64_t words;
+        uint64_t maps;
+        uint64_t unmaps;
+        uint64_t jumps;
+        uint64_t input_bytes;
+        uint64_t output_bytes;
+};
+
+/* The shared page. sequence is odd while the um writes the page, so a
+reader copies it between two equal, even reads of sequence. state is
+"running" or, once a run() is over, why it stopped (see statusName); the
+rates are per second over the last whole second, and times are seconds
+since the epoch. */
+struct liveStatsPage
+{
+        char magic[8];
+        uint64_t sequence;
+        int64_t pid;
+        char program[64];
+        char state[32];
+        double started;
+        double updated;
+        struct liveCounters counters;
+        double mips;
+        double map_rate;
+        double unmap_rate;
+};
+
+typedef struct liveStats *liveStats;
+
+liveStats
+openLiveStats(const char *program);
+
+void
+publishLiveStats(liveStats stats, const struct liveCounters *counters,
+                 const char *state);
+
+void
+closeLiveStats(liveStats *stats);
+
+bool
+readLiveStats(const struct liveStatsPage *page, struct liveStatsPage *copy);
+
+#endif
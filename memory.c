@@ -11,6 +11,25 @@
  *    The memory module is responsible for mapping, unmapping, and duplicating 
  *    segments, as well as loading values into segments and extracting values 
  *    from segments.
+ *
+ *    The segments of a machine live in a segmentTable: parallel arrays of
+ *    segment pointers and lengths indexed by identifier, which grow by 
+ *    doubling, and a stack of unmapped identifiers. MAP takes the 
+ *    identifier unmapped last, so a program that maps and unmaps in a 
+ *    loop keeps reusing the same few, cache-warm, entries.
+ *
+ *    With packing enabled, packColdSegments compresses every segment that
+ *    was not looked up since the last call, and the next getSegment of a
+ *    packed segment unpacks it again. Executors call it every so many
+ *    instructions and drop the segment pointers they keep, so that each
+ *    segment a program still uses is looked up, and marked, once per 
+ *    period.
+ *
+ *    With dirty tracking enabled, every write to a segment sets the bit
+ *    of its page in a word kept for that segment (and, past page 62, in
+ *    a bitmap of its own), and mapping, unmapping or resizing marks the 
+ *    whole segment, until clearDirty. A MAP thus costs no allocation.
+ *    Checkpoints use it to write only what changed.
  *    
  *****************************************************************************/
 #include <stdlib.h>
@@ -18,90 +37,809 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <assert.h>
+#include <string.h>
+#include "compress.h"
+#include "guard.h"
 #include "memory.h"
+#include "probes.h"
 #include "registers.h"
 #include "seq.h"
 
+/* true once segments are allocated behind guard pages */
+static bool guard_pages = false;
+
+/* true once segment 0 is write protected to detect self-modifying code */
+static bool write_barrier = false;
+
+/* A packed segment: its words as compressWords left them */
+struct packedSegment
+{
+        size_t size;
+        uint8_t bytes[];
+};
+
+/* Segments shorter than this are never packed */
+#define PACK_MIN_WORDS 64
+
+/* The touched entry of a segment that did not pack well enough to keep
+packed, so that it is not tried again until it is used */
+#define PACK_REFUSED UINT32_MAX
+
+/**************************** useGuardPages() ****************************
+ *  Purpose: Switches memory to its fast mode, where every segment created
+ *           from now on lives in an mmap region followed by guard pages
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Installs the fault handler of the guard module. Executors may
+ *           then use segLoadUnchecked and segStoreUnchecked, leaving out of
+ *           bounds accesses for the hardware to catch.
+ *  Expects: Called before any segment is created
+ ************************************************************************/
+void useGuardPages(void)
+{
+        guard_pages = true;
+        guardInstallHandler();
+}
+
+/************************** guardPagesEnabled() **************************
+ *  Purpose: Tells whether segments are protected by guard pages
+ *  Parameters: None
+ *  Returns: true if useGuardPages was called
+ *  Effects: None
+ *  Expects: None
+ ************************************************************************/
+bool guardPagesEnabled(void)
+{
+        return guard_pages;
+}
+
+/*************************** useWriteBarrier() ***************************
+ *  Purpose: Gives segment 0 pages of its own, so that executors can write
+ *           protect it instead of checking the target of every store
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Installs the fault handler of the guard module, which holds
+ *           the write barrier
+ *  Expects: Called before segment 0 is created
+ ************************************************************************/
+void useWriteBarrier(void)
+{
+        write_barrier = true;
+        guardInstallHandler();
+}
+
+/************************* writeBarrierEnabled() *************************
+ *  Purpose: Tells whether segment 0 can be put under the write barrier
+ *  Parameters: None
+ *  Returns: true if useWriteBarrier was called
+ *  Effects: None
+ *  Expects: None
+ ************************************************************************/
+bool writeBarrierEnabled(void)
+{
+        return write_barrier;
+}
+
+/************************** allocateSegment() **************************
+ *  Purpose: Creates a segment of a given number of words, all 0
+ *  Parameters: uint32_t length: number of words in the segment
+ *              bool paged: whether the segment gets pages of its own
+ *  Returns: the new segment
+ *  Effects: Allocates memory for the segment, with mmap (behind guard
+ *           pages, when there is address space left for them) if it is
+ *           paged
+ *  Expects: None
+ ************************************************************************/
+static Segment allocateSegment(uint32_t length, bool paged)
+{
+        size_t bytes = sizeof(struct Segment) + (size_t) length * 4;
+        Segment segment;
+        uint32_t reach = 0;
+        if (paged) {
+                segment = guardAllocate(bytes, &reach);
+        } else {
+                segment = calloc(1, bytes);
+        }
+        assert(segment != NULL);
+        segment->length = length;
+        segment->reach = reach;
+        segment->paged = paged;
+        return segment;
+}
+
+/**************************** newSegment() ****************************
+ *  Purpose: Creates a segment of a given number of words, all 0
+ *  Parameters: uint32_t length: number of words in the segment
+ *  Returns: the new segment
+ *  Effects: Allocates memory for the segment, behind guard pages in the
+ *           fast mode
+ *  Expects: None
+ ************************************************************************/
+Segment newSegment(uint32_t length)
+{
+        return allocateSegment(length, guard_pages);
+}
+
+/*************************** newCodeSegment() ***************************
+ *  Purpose: Creates a segment meant to become segment 0
+ *  Parameters: uint32_t length: number of words in the segment
+ *  Returns: the new segment
+ *  Effects: Same as newSegment, except that the segment is always paged
+ *           when the write barrier is in use
+ *  Expects: None
+ ************************************************************************/
+Segment newCodeSegment(uint32_t length)
+{
+        return allocateSegment(length, guard_pages || write_barrier);
+}
+
+/**************************** freeSegment() ****************************
+ *  Purpose: Frees a segment created by newSegment
+ *  Parameters: Segment *segment: reference to the segment to free
+ *  Returns: None
+ *  Effects: Frees the memory of the segment and sets *segment to NULL
+ *  Expects: segment and *segment must exist
+ ************************************************************************/
+void freeSegment(Segment *segment)
+{
+        assert(segment != NULL && *segment != NULL);
+        if ((*segment)->paged) {
+                guardFree(*segment, sizeof(struct Segment) +
+                                    (size_t) (*segment)->length * 4,
+                          (*segment)->reach != 0);
+        } else {
+                free(*segment);
+        }
+        *segment = NULL;
+}
  
+/**************************** memoryBytes() ****************************
+ *  Purpose: Tells how much host memory segments take
+ *  Parameters: uint64_t words: their number of words
+ *              uint64_t segments: their number
+ *  Returns: the bytes of the words, plus the header of each segment and
+ *           its entries in the segment table
+ ************************************************************************/
+uint64_t memoryBytes(uint64_t words, uint64_t segments)
+{
+        return words * 4 + 
+               segments * (sizeof(struct Segment) + sizeof(Segment) + 
+                           sizeof(uint32_t));
+}
+
+/**************************** memoryAllows() ****************************
+ *  Purpose: Checks a request for more memory against the limit
+ *  Parameters: memoryUsage usage: what the machine uses now
+ *              uint64_t words, segments: what it asks for on top
+ *  Returns: true if there is no limit or the total stays within it
+ ************************************************************************/
+bool memoryAllows(memoryUsage usage, uint64_t words, uint64_t segments)
+{
+        assert(usage != NULL);
+        return usage->limit == 0 || 
+               memoryBytes(usage->words + words, 
+                           usage->segments + segments) <= usage->limit;
+}
+
+/**************************** countSegment() ****************************
+ *  Purpose: Adds a segment to the memory a machine uses, or takes it away
+ *  Parameters: memoryUsage usage: the machine's usage
+ *              uint32_t length: the number of words of the segment
+ *  Returns: None
+ *  Effects: uncountSegment lowers the counts; countSegment raises them
+ *           and the high-water marks with them
+ *  Expects: usage must exist, and a segment is uncounted only while it 
+ *           is counted
+ ************************************************************************/
+static void countSegment(memoryUsage usage, uint32_t length)
+{
+        assert(usage != NULL);
+        usage->words += length;
+        usage->segments++;
+        if (usage->words > usage->peak_words) {
+                usage->peak_words = usage->words;
+        }
+        if (usage->segments > usage->peak_segments) {
+                usage->peak_segments = usage->segments;
+        }
+        uint64_t bytes = memoryBytes(usage->words, usage->segments);
+        if (bytes > usage->peak_bytes) {
+                usage->peak_bytes = bytes;
+        }
+}
+
+static void uncountSegment(memoryUsage usage, uint32_t length)
+{
+        assert(usage != NULL);
+        assert(usage->words >= length && usage->segments > 0);
+        usage->words -= length;
+        usage->segments--;
+}
+
+/**************************** growArray() ****************************
+ *  Purpose: Makes room for one more element at the end of an array
+ *  Parameters: void *array: the array, or NULL
+ *              uint32_t *capacity: its number of elements, doubled (or
+ *                                  set to 16) when it grows
+ *              uint32_t used: number of elements in use
+ *              size_t size: the size of an element
+ *  Returns: the array, moved if it had to grow
+ ************************************************************************/
+static void *growArray(void *array, uint32_t *capacity, uint32_t used,
+                       size_t size)
+{
+        if (used < *capacity) {
+                return array;
+        }
+        assert(*capacity <= UINT32_MAX / 2);
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        array = realloc(array, (size_t) *capacity * size);
+        assert(array != NULL);
+        return array;
+}
+
+/*************************** newSegmentTable() ***************************
+ *  Purpose: Creates the segment table of a machine
+ *  Parameters: Segment segment_0: the program, mapped as segment 0
+ *  Returns: a table that owns segment_0, with no other segment mapped
+ *  Effects: Counts segment_0 in the table's usage
+ *  Expects: segment_0 must exist
+ ************************************************************************/
+segmentTable newSegmentTable(Segment segment_0)
+{
+        assert(segment_0 != NULL);
+        segmentTable table = calloc(1, sizeof(struct segmentTable));
+        assert(table != NULL);
+        setSegment(table, newIdentifier(table), segment_0);
+        return table;
+}
+
+/************************** freeSegmentTable() **************************
+ *  Purpose: Frees a segment table and every segment mapped in it
+ *  Parameters: segmentTable *table: reference to the table
+ *  Returns: None
+ *  Effects: Sets *table to NULL
+ *  Expects: table and *table must exist
+ ************************************************************************/
+void freeSegmentTable(segmentTable *table)
+{
+        assert(table != NULL && *table != NULL);
+        for (uint32_t i = 0; i < (*table)->count; i++) {
+                if ((*table)->segments[i] != NULL) {
+                        freeSegment(&(*table)->segments[i]);
+                }
+                if ((*table)->packed != NULL) {
+                        free((*table)->packed[i]);
+                }
+                if ((*table)->dirty != NULL) {
+                        free((*table)->dirty_pages[i]);
+                }
+        }
+        free((*table)->segments);
+        free((*table)->dirty);
+        free((*table)->dirty_pages);
+        free((*table)->dirty_identifiers);
+        free((*table)->packed);
+        free((*table)->touched);
+        free((*table)->lengths);
+        free((*table)->free_identifiers);
+        free(*table);
+        *table = NULL;
+}
+
+/****************************** growTable() ******************************
+ *  Purpose: Adds an unmapped identifier at the end of a table
+ *  Parameters: segmentTable table: the segment table
+ *  Returns: the new identifier
+ *  Effects: Grows every array of the table geometrically when it is full
+ ************************************************************************/
+static uint32_t growTable(segmentTable table)
+{
+        uint32_t capacity = table->capacity;
+        table->segments = growArray(table->segments, &capacity, 
+                                    table->count, sizeof(Segment));
+        capacity = table->capacity;
+        table->lengths = growArray(table->lengths, &capacity, table->count,
+                                   sizeof(uint32_t));
+        if (table->touched != NULL) {
+                capacity = table->capacity;
+                table->packed = growArray(table->packed, &capacity, 
+                                          table->count, 
+                                          sizeof(packedSegment));
+                capacity = table->capacity;
+                table->touched = growArray(table->touched, &capacity,
+                                           table->count, sizeof(uint32_t));
+                table->packed[table->count] = NULL;
+        }
+        if (table->dirty != NULL) {
+                capacity = table->capacity;
+                table->dirty = growArray(table->dirty, &capacity,
+                                         table->count, sizeof(uint64_t));
+                capacity = table->capacity;
+                table->dirty_pages = growArray(table->dirty_pages, &capacity,
+                                               table->count, 
+                                               sizeof(uint64_t *));
+                table->dirty[table->count] = 0;
+                table->dirty_pages[table->count] = NULL;
+        }
+        table->capacity = capacity;
+        table->segments[table->count] = NULL;
+        table->lengths[table->count] = 0;
+        return table->count++;
+}
+
+/**************************** newIdentifier() ****************************
+ *  Purpose: Finds an identifier for a segment about to be mapped
+ *  Parameters: segmentTable table: the segment table
+ *  Returns: the identifier unmapped most recently, whose entries are the
+ *           likeliest to still be in the cache, or else a new one past 
+ *           the end of the table
+ *  Effects: Grows the table geometrically when it is full
+ *  Expects: table must exist; the caller maps a segment at the identifier
+ *           with setSegment
+ ************************************************************************/
+uint32_t newIdentifier(segmentTable table)
+{
+        assert(table != NULL);
+        if (table->free_count != 0) {
+                return table->free_identifiers[--table->free_count];
+        }
+        return growTable(table);
+}
+
+/***************************** freePacked() *****************************
+ *  Purpose: Forgets the packed form of a segment, if it has one
+ *  Parameters: segmentTable table: a table with packing enabled
+ *              uint32_t identifier: the segment
+ *  Returns: None
+ *  Effects: Frees the packed form and takes it out of the usage
+ ************************************************************************/
+static void freePacked(segmentTable table, uint32_t identifier)
+{
+        packedSegment packed = table->packed[identifier];
+        if (packed == NULL) {
+                return;
+        }
+        table->usage.packed_segments--;
+        table->usage.packed_words -= table->lengths[identifier];
+        table->usage.packed_bytes -= packed->size;
+        table->packed[identifier] = NULL;
+        free(packed);
+}
+
+/**************************** listDirty() ****************************
+ *  Purpose: Adds a segment to the list of those that are not clean
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *              uint32_t identifier: a segment that was clean
+ *  Returns: None
+ ************************************************************************/
+static void listDirty(segmentTable table, uint32_t identifier)
+{
+        uint32_t capacity = table->dirty_capacity;
+        table->dirty_identifiers = growArray(table->dirty_identifiers,
+                                             &capacity, table->dirty_count,
+                                             sizeof(uint32_t));
+        table->dirty_capacity = capacity;
+        table->dirty_identifiers[table->dirty_count++] = identifier;
+}
+
+/*************************** markWrittenPage() ***************************
+ *  Purpose: The slow path of markWritten: a write to a clean segment, or
+ *           to a page past those the dirty word holds
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *              uint32_t identifier: the segment written
+ *              uint32_t page: the page written
+ *  Returns: None
+ *  Effects: Lists a clean segment as not clean, and starts the bitmap of
+ *           the late pages of a segment when it needs one
+ ************************************************************************/
+void markWrittenPage(segmentTable table, uint32_t identifier, uint32_t page)
+{
+        assert(table != NULL && table->dirty != NULL);
+        uint64_t *dirty = &table->dirty[identifier];
+        if (*dirty == 0) {
+                listDirty(table, identifier);
+        }
+        if (*dirty == DIRTY_WHOLE) {
+                return;
+        } else if (page < DIRTY_LATE_PAGE) {
+                *dirty |= (uint64_t) 1 << page;
+                return;
+        }
+
+        uint64_t *pages = table->dirty_pages[identifier];
+        if (pages == NULL) {
+                size_t words = (table->lengths[identifier] >> 
+                                (DIRTY_PAGE_SHIFT + 6)) + 1;
+                pages = calloc(words, sizeof(uint64_t));
+                assert(pages != NULL);
+                table->dirty_pages[identifier] = pages;
+        }
+        pages[page >> 6] |= (uint64_t) 1 << (page & 63);
+        *dirty |= (uint64_t) 1 << DIRTY_LATE_PAGE;
+}
+
+/***************************** pageWritten() *****************************
+ *  Purpose: Tells whether a page of a segment was written since the last
+ *           clearDirty
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *              uint32_t identifier: the segment
+ *              uint32_t page: the page
+ *  Returns: true if it was, or if the segment changed as a whole
+ ************************************************************************/
+bool pageWritten(segmentTable table, uint32_t identifier, uint32_t page)
+{
+        assert(table != NULL && table->dirty != NULL);
+        uint64_t dirty = table->dirty[identifier];
+        if (dirty == DIRTY_WHOLE) {
+                return true;
+        } else if (page < DIRTY_LATE_PAGE) {
+                return (dirty >> page & 1) != 0;
+        }
+        const uint64_t *pages = table->dirty_pages[identifier];
+        return pages != NULL && (pages[page >> 6] >> (page & 63) & 1) != 0;
+}
+
+/************************** markWrittenRange() **************************
+ *  Purpose: markWritten for a range of words
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *              uint32_t identifier: the segment written
+ *              uint32_t first, count: the words written
+ *  Returns: None
+ *  Expects: the segment must be mapped and the words inside it
+ ************************************************************************/
+void markWrittenRange(segmentTable table, uint32_t identifier, 
+                      uint32_t first, uint32_t count)
+{
+        assert(table != NULL && table->dirty != NULL);
+        if (count == 0) {
+                return;
+        }
+        uint32_t last = (first + count - 1) >> DIRTY_PAGE_SHIFT;
+        for (uint32_t page = first >> DIRTY_PAGE_SHIFT; page <= last; 
+             page++) {
+                markWrittenPage(table, identifier, page);
+        }
+}
+
+/**************************** setSegment() ****************************
+ *  Purpose: Maps a segment at an identifier of the table, or unmaps one
+ *  Parameters: segmentTable table: the segment table
+ *              uint32_t identifier: from newIdentifier, or mapped already
+ *              Segment segment: the segment, or NULL to leave the 
+ *                               identifier unmapped
+ *  Returns: None
+ *  Effects: Keeps the length entry and the table's usage in step; the 
+ *           segment that was mapped there, if any, is the caller's to free
+ *           unless it was packed, in which case it is freed here
+ *  Expects: table must exist and identifier be within it
+ ***********************************************************************/
+void setSegment(segmentTable table, uint32_t identifier, Segment segment)
+{
+        assert(table != NULL && identifier < table->count);
+        if (segmentMapped(table, identifier)) {
+                uncountSegment(&table->usage, table->lengths[identifier]);
+        }
+        if (table->touched != NULL) {
+                freePacked(table, identifier);
+                table->touched[identifier] = table->epoch;
+        }
+        table->segments[identifier] = segment;
+        table->lengths[identifier] = segment == NULL ? 0 : segment->length;
+        if (segment != NULL) {
+                countSegment(&table->usage, segment->length);
+        }
+
+        /* a new, resized or unmapped segment changed as a whole */
+        if (table->dirty != NULL) {
+                if (table->dirty[identifier] == 0) {
+                        listDirty(table, identifier);
+                }
+                table->dirty[identifier] = DIRTY_WHOLE;
+                free(table->dirty_pages[identifier]);
+                table->dirty_pages[identifier] = NULL;
+        }
+}
+
+/**************************** enablePacking() ****************************
+ *  Purpose: Lets packColdSegments compress the segments of a table
+ *  Parameters: segmentTable table: the segment table
+ *  Returns: None
+ *  Effects: From now on getSegment also marks each segment it returns as
+ *           used, and unpacks it if need be; every segment starts out 
+ *           marked
+ *  Expects: table must exist
+ ************************************************************************/
+void enablePacking(segmentTable table)
+{
+        assert(table != NULL);
+        if (table->touched != NULL) {
+                return;
+        }
+        table->packed = calloc(table->capacity, sizeof(packedSegment));
+        table->touched = calloc(table->capacity, sizeof(uint32_t));
+        assert(table->packed != NULL && table->touched != NULL);
+        table->epoch = 0;
+}
+
+/************************** packColdSegments() **************************
+ *  Purpose: Compresses the segments a program has stopped using
+ *  Parameters: segmentTable table: a table with packing enabled
+ *  Returns: the number of segments packed
+ *  Effects: Every segment other than 0, of at least PACK_MIN_WORDS words,
+ *           that getSegment has not returned since the last call is
+ *           packed and freed, unless packing would not save a quarter of
+ *           its size. Starts a new period for the marks. Pointers to the
+ *           segments packed become stale, so executors must drop every
+ *           segment pointer they keep.
+ *  Expects: table must exist and packing be enabled
+ ************************************************************************/
+uint32_t packColdSegments(segmentTable table)
+{
+        assert(table != NULL && table->touched != NULL);
+        uint32_t packed_count = 0;
+        uint8_t *scratch = NULL;
+        size_t scratch_size = 0;
+        for (uint32_t id = 1; id < table->count; id++) {
+                Segment segment = table->segments[id];
+                if (segment == NULL || segment->length < PACK_MIN_WORDS ||
+                    table->touched[id] == table->epoch ||
+                    table->touched[id] == PACK_REFUSED) {
+                        continue;
+                }
+
+                /* worth keeping only if it saves a quarter of the words */
+                size_t capacity = (size_t) segment->length * 3;
+                if (capacity > scratch_size) {
+                        free(scratch);
+                        scratch = malloc(capacity);
+                        assert(scratch != NULL);
+                        scratch_size = capacity;
+                }
+                size_t size = compressWords(segment->words, segment->length,
+                                            scratch, capacity);
+                if (size == 0) {
+                        table->touched[id] = PACK_REFUSED;
+                        continue;
+                }
+
+                packedSegment packed = malloc(sizeof(struct packedSegment) +
+                                              size);
+                assert(packed != NULL);
+                packed->size = size;
+                memcpy(packed->bytes, scratch, size);
+                table->packed[id] = packed;
+                table->segments[id] = NULL;
+                table->usage.packed_segments++;
+                table->usage.packed_words += segment->length;
+                table->usage.packed_bytes += size;
+                freeSegment(&segment);
+                packed_count++;
+        }
+        free(scratch);
+        table->epoch = table->epoch + 1 == PACK_REFUSED ? 0 : 
+                                                          table->epoch + 1;
+        return packed_count;
+}
+
+/***************************** touchSegment() *****************************
+ *  Purpose: getSegment once packing is enabled
+ *  Parameters: segmentTable table: a table with packing enabled
+ *              uint32_t identifier: the segment
+ *  Returns: the segment, or NULL if identifier is unmapped
+ *  Effects: Marks the segment as used in this period, and unpacks it if
+ *           it is packed
+ *  Expects: table must exist and identifier be within it
+ ************************************************************************/
+Segment touchSegment(segmentTable table, uint32_t identifier)
+{
+        assert(table != NULL && identifier < table->count);
+        table->touched[identifier] = table->epoch;
+        packedSegment packed = table->packed[identifier];
+        if (packed != NULL) {
+                Segment segment = newSegment(table->lengths[identifier]);
+                decompressWords(packed->bytes, packed->size, segment->words,
+                                segment->length);
+                freePacked(table, identifier);
+                table->segments[identifier] = segment;
+                table->usage.unpacks++;
+        }
+        return table->segments[identifier];
+}
+
+/************************ enableDirtyTracking() ************************
+ *  Purpose: Starts recording which pages of which segments are written
+ *  Parameters: segmentTable table: the segment table
+ *  Returns: None
+ *  Effects: Every segment starts out clean. From now on setSegment and
+ *           the bulk operations of this module mark what they change;
+ *           executors mark their own stores with markWritten.
+ *  Expects: table must exist
+ ************************************************************************/
+void enableDirtyTracking(segmentTable table)
+{
+        assert(table != NULL);
+        if (table->dirty == NULL) {
+                table->dirty = calloc(table->capacity, sizeof(uint64_t));
+                table->dirty_pages = calloc(table->capacity, 
+                                            sizeof(uint64_t *));
+                assert(table->dirty != NULL && table->dirty_pages != NULL);
+        }
+}
+
+/***************************** clearDirty() *****************************
+ *  Purpose: Marks every segment clean again, after a checkpoint
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *  Returns: None
+ *  Effects: Frees the bitmaps and empties the list
+ ************************************************************************/
+void clearDirty(segmentTable table)
+{
+        assert(table != NULL && table->dirty != NULL);
+        for (uint32_t i = 0; i < table->dirty_count; i++) {
+                uint32_t identifier = table->dirty_identifiers[i];
+                table->dirty[identifier] = 0;
+                free(table->dirty_pages[identifier]);
+                table->dirty_pages[identifier] = NULL;
+        }
+        table->dirty_count = 0;
+}
+
+/**************************** placeSegment() ****************************
+ *  Purpose: Maps a segment at a chosen identifier, to rebuild a table
+ *           from a checkpoint
+ *  Parameters: segmentTable table: the segment table
+ *              uint32_t identifier: any identifier; the table grows to 
+ *                                   hold it
+ *              Segment segment: the segment
+ *  Returns: None
+ *  Effects: Frees the segment mapped there before, if any. The stack of
+ *           free identifiers is left alone, see restoreIdentifiers.
+ *  Expects: table and segment must exist
+ ************************************************************************/
+void placeSegment(segmentTable table, uint32_t identifier, Segment segment)
+{
+        assert(table != NULL && segment != NULL);
+        while (identifier >= table->count) {
+                growTable(table);
+        }
+        Segment old = table->segments[identifier];
+        setSegment(table, identifier, segment);
+        if (old != NULL) {
+                freeSegment(&old);
+        }
+}
+
+/************************* restoreIdentifiers() *************************
+ *  Purpose: Gives a rebuilt table the identifiers of the original
+ *  Parameters: segmentTable table: the segment table
+ *              uint32_t count: the number of identifiers it had
+ *              const uint32_t *free_identifiers: its stack of unmapped
+ *                                                identifiers, bottom 
+ *                                                first
+ *              uint32_t free_count: the height of the stack
+ *  Returns: None
+ *  Effects: Grows the table to count identifiers and replaces its stack,
+ *           so that MAP hands out the same identifiers as it would have
+ *  Expects: table must exist, every mapped identifier be below count and
+ *           every identifier on the stack be unmapped
+ ************************************************************************/
+void restoreIdentifiers(segmentTable table, uint32_t count, 
+                        const uint32_t *free_identifiers, 
+                        uint32_t free_count)
+{
+        assert(table != NULL && table->count <= count);
+        while (table->count < count) {
+                growTable(table);
+        }
+        table->free_count = 0;
+        for (uint32_t i = 0; i < free_count; i++) {
+                assert(!segmentMapped(table, free_identifiers[i]));
+                uint32_t capacity = table->free_capacity;
+                table->free_identifiers = growArray(table->free_identifiers,
+                                                    &capacity, 
+                                                    table->free_count,
+                                                    sizeof(uint32_t));
+                table->free_capacity = capacity;
+                table->free_identifiers[table->free_count++] = 
+                        free_identifiers[i];
+        }
+}
+
 /**************************** mapSegment() ****************************
  *  Purpose:  Creates a new segment and maps it to an index in memory
  *  Parameters: Seq_T registers: the 8 GPRs employed by the UM 
- *              Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
- *              Seq_T unmapped_identifiers: sequence holding all segment ID's
- *                                          that were previously used but are
- *                                          now unmapped and are available for
- *                                          reuse
+ *              segmentTable table: the segments mapped during program
+ *                                  execution
  *              int rc: represents the idx in registers that stores the number  
  *                      of words that will constitute the newly mapped segment
  *              int rb: represents the idx in registers that will store the 
  *                      newly mapped register
- *  Returns: A newly mapped segment represented as a Seq_T
- *  Effects: Allocates memory for a new segment 
+ *  Returns: A newly mapped segment
+ *  Effects: Allocates memory for a new segment and counts it in the
+ *           table's usage
  *  Expects: A bit pattern that is not all zeroes and that does not identify 
  *           any currently mapped segment is placed in $r[B]
- *           Sequences must exist and register indices must be within 0-7
+ *           table must exist and register indices must be within 0-7.
+ *           The limit of the usage is the caller's to check, with 
+ *           memoryAllows
  ************************************************************************/
-Seq_T mapSegment(Seq_T registers, Seq_T mapped_segments,
-                 Seq_T unmapped_identifiers, int rb, int rc)
+Segment mapSegment(Seq_T registers, segmentTable table, int rb, int rc)
 {       
-        /* create a segment */
-        Seq_T segment = Seq_new(rc);
-        assert(segment != NULL);
+        uint32_t identifier = mapSegmentOf(table, getRegister(registers, rc));
+        setRegister(registers, rb, identifier);
+        return getSegment(table, identifier);
+}
 
-        uint32_t rC = getRegister(registers, rc);
-        /* initialize elements in segment to 0 */
-        uint32_t zero = 0;
-        for (uint32_t i = 0; i < rC; i++) {
-                Seq_addhi(segment, (void *) (uintptr_t) zero);
-        }
-
-        /* add to mapped_segments, reusing an ID from unmapped_seg if
-        possible */
-
-        /* if there are available ID's to reuse */
-        if (segmentLength(unmapped_identifiers) != 0) {  
-                uint32_t free_ID = 
-                        (uint32_t) (uintptr_t) Seq_remlo(unmapped_identifiers);
-                /* free the previously mapped segment (didn't free in unmap) */
-                Seq_T unmap = getSegment(mapped_segments, free_ID);
-                Seq_free(&unmap);
-                /* store newly_mapped segment */
-                setSegment(mapped_segments, free_ID, segment);
-                setRegister(registers, rb, free_ID);
-        } else { /* if no need to reuse, use any ID */
-                addSegToMemory(mapped_segments, segment);
-                uint32_t new_ID = segmentLength(mapped_segments) - 1;
-                setRegister(registers, rb, new_ID);
-        }
-        return segment;
+/*************************** mapSegmentOf() ***************************
+ *  Purpose: mapSegment for executors that keep register values themselves
+ *  Parameters: segmentTable table: as for mapSegment
+ *              uint32_t length: number of words in the new segment
+ *  Returns: the identifier of the newly mapped segment
+ *  Effects: Allocates memory for a new segment and counts it
+ *  Expects: table must exist
+ ************************************************************************/
+uint32_t mapSegmentOf(segmentTable table, uint32_t length)
+{
+        /* create a segment with its elements initialized to 0, reusing 
+        the ID unmapped last if there is one */
+        uint32_t identifier = newIdentifier(table);
+        setSegment(table, identifier, newSegment(length));
+        table->usage.maps++;
+        UM_PROBE2(map, identifier, length);
+        return identifier;
 }
 
 /**************************** unmapSegment() ****************************
  *  Purpose:  Removes a segment from memory and handles its ID for reuse
  *  Parameters: Seq_T registers: the 8 GPRs employed by the UM 
- *              Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
- *              Seq_T unmapped_identifiers: sequence holding all segment ID's
- *                                          that were previously used but are
- *                                          now unmapped and are available for
- *                                          reuse
+ *              segmentTable table: the segments mapped during program
+ *                                  execution
  *              int rc: the segment ID of the segment to be unmapped
  *  Returns: None
  *  Effects: Frees any memory associated with previously mapped segment, and 
  *           makes it's segment ID available for reuse  
- *  Expects: A segment that exists and a valid segment ID, sequences must exist
+ *  Expects: A segment that exists and a valid segment ID, table must exist
  *           and register indices must be within 0-7
  ***********************************************************************/
-void unmapSegment(Seq_T registers, Seq_T mapped_segments,
-                  Seq_T unmapped_identifiers, int rc)
+void unmapSegment(Seq_T registers, segmentTable table, int rc)
 {
         assert(registers != NULL);
-        assert(mapped_segments != NULL);
         /* get the segment to unmap from register r[C] */
-        uint32_t unmapped_id = getRegister(registers, rc);
-        /* add to list of unmapped ID's */
-        addSegmentIdentifier(unmapped_identifiers, unmapped_id);    
+        unmapSegmentOf(table, getRegister(registers, rc));
+}
+
+/*************************** unmapSegmentOf() ***************************
+ *  Purpose: unmapSegment for executors that keep register values 
+ *           themselves
+ *  Parameters: segmentTable table: as for unmapSegment
+ *              uint32_t identifier: the segment to unmap
+ *  Returns: None
+ *  Effects: Frees the segment at once, so that the memory of a program is
+ *           only what it has mapped, and pushes its identifier on the 
+ *           stack that newIdentifier takes from
+ *  Expects: identifier must be a mapped segment other than 0
+ ***********************************************************************/
+void unmapSegmentOf(segmentTable table, uint32_t identifier)
+{
+        assert(identifier != 0 && segmentMapped(table, identifier));
+        UM_PROBE1(unmap, identifier);
+        table->usage.unmaps++;
+
+        /* a packed segment is freed by setSegment */
+        Segment segment = table->segments[identifier];
+        setSegment(table, identifier, NULL);
+        if (segment != NULL) {
+                freeSegment(&segment);
+        }
+
+        /* add to the stack of unmapped ID's */
+        uint32_t capacity = table->free_capacity;
+        table->free_identifiers = growArray(table->free_identifiers, 
+                                            &capacity, table->free_count,
+                                            sizeof(uint32_t));
+        table->free_capacity = capacity;
+        table->free_identifiers[table->free_count++] = identifier;
 }
 
 
@@ -109,8 +847,8 @@ void unmapSegment(Seq_T registers, Seq_T mapped_segments,
  *  Purpose: Grabs a value from a particular register and loads it into a 
  *           specified word in a specified segment 
  *  Parameters: Seq_T registers: the 8 GPRs employed by the UM 
- *              Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
+ *              segmentTable table: the segments mapped during program
+ *                                  execution
  *              int ra: the idx of the register that will take the loaded value
  *              int rb: the idx of the register that contains the segment
  *                      number
@@ -120,15 +858,15 @@ void unmapSegment(Seq_T registers, Seq_T mapped_segments,
  *  Effects: Uses getRegister, getSegment, and getWord to obtain values of
  *           interest, uses register module's set function to modify a
  *           register. 
- *  Expects: Sequences must exist and register indices must be within 0-7
+ *  Expects: table must exist and register indices must be within 0-7
  ***********************************************************************/
-void segLoad(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
+void segLoad(Seq_T registers, segmentTable table, int ra, int rb, int rc)
 {
         assert(registers != NULL);
 
         /* fetch desired segment from memory */
         uint32_t seg_identifier = getRegister(registers, rb);
-        Seq_T desired_segment = getSegment(mapped_segments, seg_identifier);
+        Segment desired_segment = getSegment(table, seg_identifier);
 
         /* fetch desired block from that segment */
         uint32_t offset = getRegister(registers, rc);
@@ -138,12 +876,33 @@ void segLoad(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
         setRegister(registers, ra, desired_block);
 }
 
+/************************** segLoadUnchecked() **************************
+ *  Purpose: segLoad without a software bounds check on the offset, as
+ *           long as it is within the reach of the segment's guard pages
+ *  Parameters: same as segLoad
+ *  Returns: None
+ *  Effects: An offset past the end of the segment touches its guard pages,
+ *           which the guard module reports as a UM failure; one beyond
+ *           their reach is checked as segLoad and segStore check it
+ *  Expects: Memory is in the fast mode (useGuardPages)
+ ***********************************************************************/
+void segLoadUnchecked(Seq_T registers, segmentTable table,
+                      int ra, int rb, int rc)
+{
+        Segment desired_segment = getSegment(table, 
+                                             getRegister(registers, rb));
+        uint32_t offset = getRegister(registers, rc);
+        setRegister(registers, ra, offset < desired_segment->reach ?
+                                   desired_segment->words[offset] :
+                                   getWord(desired_segment, offset));
+}
+
 /**************************** segStore() ****************************
  *  Purpose: Stores the value witin a specified register into a particular
  *           word of a particular segment specified by instruction
  *  Parameters: Seq_T registers: the 8 GPRs employed by the UM 
- *              Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
+ *              segmentTable table: the segments mapped during program
+ *                                  execution
  *              int ra: the idx of the register that contains the segment
  *                      number
  *              int rb: the idx of the register that contains address of the
@@ -154,9 +913,9 @@ void segLoad(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
  *  Effects: Uses getRegister from register module to get the value of a
  *           register, uses getSegment and setWord to obtain values of interest
  *           and set values within a segment
- *  Expects: Sequences must exist and register indices must be within 0-7
+ *  Expects: table must exist and register indices must be within 0-7
  ***********************************************************************/
-void segStore(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
+void segStore(Seq_T registers, segmentTable table, int ra, int rb, int rc)
 {
         assert(registers != NULL);
 
@@ -167,8 +926,7 @@ void segStore(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
         uint32_t desired_identifier = getRegister(registers, ra);
 
         /* use ID to get desired segment to store value in from r[C] */
-        Seq_T desired_segment = getSegment(mapped_segments, 
-                                           desired_identifier);
+        Segment desired_segment = getSegment(table, desired_identifier);
         
         /* load value into desired word (offset) at that segment */
         uint32_t rB = getRegister(registers, rb);
@@ -177,14 +935,33 @@ void segStore(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
 
 }
 
+/************************** segStoreUnchecked() **************************
+ *  Purpose: segStore without a software bounds check on the offset, as
+ *           long as it is within the reach of the segment's guard pages
+ *  Parameters: same as segStore
+ *  Returns: None
+ *  Effects: An offset past the end of the segment touches its guard pages,
+ *           which the guard module reports as a UM failure; one beyond
+ *           their reach is checked as segLoad and segStore check it
+ *  Expects: Memory is in the fast mode (useGuardPages)
+ ***********************************************************************/
+void segStoreUnchecked(Seq_T registers, segmentTable table,
+                       int ra, int rb, int rc)
+{
+        Segment desired_segment = getSegment(table,
+                                             getRegister(registers, ra));
+        uint32_t offset = getRegister(registers, rb);
+        if (offset < desired_segment->reach) {
+                desired_segment->words[offset] = getRegister(registers, rc);
+        } else {
+                setWord(desired_segment, offset, getRegister(registers, rc));
+        }
+}
+
 /**************************** loadProgram() ****************************
  *  Purpose: Replaces segment-0 with an different specified segment
- *  Parameters: Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
- *              Seq_T unmapped_identifiers: sequence holding all segment ID's
- *                                          that were previously used but are
- *                                          now unmapped and are available for
- *                                          reuse
+ *  Parameters: segmentTable table: the segments mapped during program
+ *                                  execution
  *              Seq_T registers: the 8 GPRs employed by the UM 
  *              int rb: index of the register that contains the segment ID of
  *                      the segment to duplicated and replace segment-0
@@ -192,223 +969,254 @@ void segStore(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc)
  *                      a word the pointer counter will be set to
  *              int *program_counter: pointer to current word
  *  Returns: None
- *  Effects: Uses getRegister to obtain value of a register and uses
- *           getSegment, segmentLength, unmapSegment and setSegment to obtain
- *           and replace segments
- *  Expects: Sequences must exist and register indices must be within 0-7
+ *  Effects: Uses getRegister to obtain value of a register and 
+ *           loadProgramOf to replace segment 0
+ *  Expects: table must exist and register indices must be within 0-7
  ***********************************************************************/
-void loadProgram(Seq_T mapped_segments, Seq_T unmapped_identifiers,
-                 Seq_T registers, int rb, int rc, uint32_t *program_counter)
+void loadProgram(segmentTable table, Seq_T registers, int rb, int rc,
+                 uint32_t *program_counter)
 {
-        (void) unmapped_identifiers;
-        
         assert(registers != NULL);
-        assert(mapped_segments != NULL);
+        assert(table != NULL);
 
-        uint32_t rB = getRegister(registers, rb);
-        uint32_t rC = getRegister(registers, rc);
-        
-        Seq_T original_segment0 = getSegment(mapped_segments, 0);
+        *program_counter = loadProgramOf(table, getRegister(registers, rb),
+                                         getRegister(registers, rc));
+}
 
-        if (rB != 0){
-                /* free previous 0-segment */
-                Seq_free(&original_segment0);
-                
+/*************************** loadProgramOf() ***************************
+ *  Purpose: loadProgram for executors that keep register values themselves
+ *  Parameters: segmentTable table: as for loadProgram
+ *              uint32_t identifier: the segment that replaces segment 0,
+ *                                   or 0 to jump within segment 0
+ *              uint32_t target: the word to continue from
+ *  Returns: the new program counter, which is target
+ *  Effects: Frees segment 0 and replaces it with a duplicate of segment
+ *           identifier, unless identifier is 0
+ *  Expects: table must exist and target must be within the new segment 0
+ ***********************************************************************/
+uint32_t loadProgramOf(segmentTable table, uint32_t identifier,
+                       uint32_t target)
+{
+        UM_PROBE2(load__program, identifier, target);
+        Segment original_segment0 = getSegment(table, 0);
+
+        if (identifier != 0){
                 /* get duplicate segment */
-                Seq_T duplicate_segment = 
-                        duplicateSegment(getSegment(mapped_segments, rB));
+                Segment source = getSegment(table, identifier);
+                assert(source != NULL);
+                Segment duplicate_segment = newCodeSegment(source->length);
+                memcpy(duplicate_segment->words, source->words,
+                       (size_t) source->length * 4);
                 
-                /* set 0-index to duplicate segment */
-                setSegment(mapped_segments, 0, duplicate_segment);
+                /* set 0-index to duplicate segment, then free the 
+                previous 0-segment */
+                setSegment(table, 0, duplicate_segment);
+                freeSegment(&original_segment0);
         } else {
-                assert(rC < (uint32_t) segmentLength(original_segment0));
+                assert(target < segmentLength(original_segment0));
         }
 
-        *program_counter = rC;
+        return target;
 }
 /**************************** segmentLength() ****************************
  *  Purpose: Returns the length of a specified segment
- *  Parameters: Seq_T segment: segment whose length is returned 
+ *  Parameters: Segment segment: segment whose length is returned 
  *  Returns: An integer representing the length of the specified segment 
- *  Effects: Uses Hanson sequence length function to find length of segment
+ *  Effects: None
  *  Expects: segment must exist 
  * *********************************************************************/
-int segmentLength(Seq_T segment)
-{
-        assert(segment != NULL);
-        return Seq_length(segment);
-}
-
-/**************************** addSegToMemory() ****************************
- *  Purpose: Adds a segment to the collection of every segment mapped in the
- *           program
- *  Parameters: Seq_T mapped_segments: sequence holding all segments mapped
- *                                        during program execution
- *              Seq_T segment: segment to be added to collection of  
- *                             segments during program execution
- *  Returns: None
- *  Effects: Uses Hanson sequence functions to add segment
- *  Expects: segmentIdentifiers and segment must exist 
- * ***********************************************************************/
-void addSegToMemory(Seq_T mapped_segments, Seq_T segment)
+uint32_t segmentLength(Segment segment)
 {
         assert(segment != NULL);
-        assert(mapped_segments != NULL);
-        Seq_addhi(mapped_segments, segment);
-}
-
-/**************************** getSegment() ****************************
- *  Purpose: Grabs a specific segment from a collection of all mapped segments
- *           in memory 
- *  Parameters: Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
- *              int index: index in the sequence representing the segment to be 
- *                         returned
- *  Returns: A Seq_T to the requested segment from memory
- *  Effects: Uses Hanson sequence functions to get a segment
- *  Expects: mapped_segments must exist and index must be a valid index
- ***********************************************************************/
-Seq_T getSegment(Seq_T mapped_segments, uint32_t index)
-{
-        assert(mapped_segments != NULL);
-        return (Seq_T) Seq_get(mapped_segments, index);
-}
-
-/************************* addSegmentIdentifier() ****************************
- *  Purpose: Adds a segment identifier to a collection of all reusable segment
- *           ID's
- *  Parameters: Seq_T segment_identifiers: sequence holding all segement ID's
- *                                         that were previously mapped but are
- *                                         now unmapped and able to be reused
- *              uint32_t identifier: a segment ID
- *  Returns: None
- *  Effects: Uses Hanson sequence functions to add to a sequence
- *  Expects: segment_identifiers must exist and the segment with identifier as
- *           its segment ID must be unmapped
- ***********************************************************************/
-void addSegmentIdentifier(Seq_T segment_identifiers, uint32_t identifier)
-{
-        Seq_addhi(segment_identifiers, (void *)(uintptr_t) identifier);
-}
-
-/**************************** setSegment() ****************************
- *  Purpose: Adds a segment to a collection of all mapped semgents in memory
- *  Parameters: Seq_T mapped_segments: sequence holding all segments mapped
- *                                     during program execution
- *              int index: the segment ID/index of where the segment is to be
- *                         put in the collection
-  *             Seq_T segment: segment to be added to collection of  
- *                             segments during program execution
- *  Returns: None
- *  Effects: Uses Hanson sequence functions to add to a sequence
- *  Expects: mapped_segments & segment must exist and index must be a valid ID
- ***********************************************************************/
-void setSegment(Seq_T mapped_segments, uint32_t index, Seq_T segment)
-{
-        assert(mapped_segments != NULL);
-        Seq_put(mapped_segments, index, segment);
+        return segment->length;
 }
 
 /**************************** duplicateSegment() ****************************
  *  Purpose: Duplicate a given segment
- *  Parameters: Seq_T segment: segment to be duplicated
+ *  Parameters: Segment segment: segment to be duplicated
  *  Returns: None
- *  Effects: Allocates space for a new segment (sequence)
+ *  Effects: Allocates space for a new segment
  *  Expects: segment should exist
  ***********************************************************************/
 
-Seq_T duplicateSegment(Seq_T segment)
+Segment duplicateSegment(Segment segment)
 {
-        int length = Seq_length(segment);
-        Seq_T duplicate = Seq_new(length);
-
-        for (int i = 0; i < length; i++) {
-                uint32_t currWord = getWord(segment, i);
-                Seq_addhi(duplicate, (void *) (uintptr_t) currWord);
-        }
+        assert(segment != NULL);
+        Segment duplicate = newSegment(segment->length);
+        memcpy(duplicate->words, segment->words,
+               (size_t) segment->length * 4);
         return duplicate;
 }
 
 /**************************** getWord() ****************************
  *  Purpose: Grabs a word from a given segment
- *  Parameters: Seq_T segment: segment from which a particular word to be
+ *  Parameters: Segment segment: segment from which a particular word to be
  *                             retrieved 
  *              int index: index in the segment representing the address 
  *                         of the word to be returned
  *  Returns: The word at the requested index in the specified segment
- *  Effects: Uses Hanson Seq_T functions to obtain a word 
+ *  Effects: Checks the index against the length of the segment
  *  Expects: segment must exist and index must be a valid index
  ***********************************************************************/
-uint32_t getWord(Seq_T segment, uint32_t index)
+uint32_t getWord(Segment segment, uint32_t index)
 {
        assert(segment != NULL);
-       return (uint32_t)(uintptr_t) Seq_get(segment, index);
+       assert(index < segment->length);
+       return segment->words[index];
 }
 
 /**************************** setWord() ****************************
  *  Purpose: Puts a word in a given segment
- *  Parameters: Seq_T segment: segment from which a particular word to be
+ *  Parameters: Segment segment: segment from which a particular word to be
  *                             retrieved 
  *              int index: index of where in the segment the word is to be
  *                         placed
  *              uint32_t word: the word to be placed in the segment
  *  Returns: None
- *  Effects: Uses Hanson Seq_T functions to add a word 
+ *  Effects: Checks the index against the length of the segment
  *  Expects: segment and word must exist and index must be valid
  ***********************************************************************/
-void setWord(Seq_T segment, uint32_t index, uint32_t word)
+void setWord(Segment segment, uint32_t index, uint32_t word)
 {
         assert(segment != NULL);
-        Seq_put(segment, index, (void *) (uintptr_t) word);
+        assert(index < segment->length);
+        segment->words[index] = word;
+}
+
+/****************************** copyWords() ******************************
+ *  Purpose: Copies words from one segment to another, or within one
+ *  Parameters: segmentTable table: the segments of the program
+ *              uint32_t target, target_offset: where the words go
+ *              uint32_t source, source_offset: where they come from
+ *              uint32_t count: number of words
+ *  Returns: None
+ *  Effects: Overlapping ranges are copied as if through a temporary
+ *  Expects: both segments must exist and both ranges be inside them
+ ***********************************************************************/
+void copyWords(segmentTable table, uint32_t target, uint32_t target_offset,
+               uint32_t source, uint32_t source_offset, uint32_t count)
+{
+        Segment to = getSegment(table, target);
+        Segment from = getSegment(table, source);
+        assert(to != NULL && from != NULL);
+        assert((uint64_t) target_offset + count <= to->length);
+        assert((uint64_t) source_offset + count <= from->length);
+        memmove(to->words + target_offset, from->words + source_offset,
+                (size_t) count * 4);
+        if (table->dirty != NULL) {
+                markWrittenRange(table, target, target_offset, count);
+        }
+}
+
+/****************************** fillWords() ******************************
+ *  Purpose: Stores one value into a range of words of a segment
+ *  Parameters: segmentTable table: the segments of the program
+ *              uint32_t target, offset: the first word
+ *              uint32_t value: the value to store
+ *              uint32_t count: number of words
+ *  Returns: None
+ *  Expects: the segment must exist and the range be inside it
+ ***********************************************************************/
+void fillWords(segmentTable table, uint32_t target, uint32_t offset,
+               uint32_t value, uint32_t count)
+{
+        Segment segment = getSegment(table, target);
+        assert(segment != NULL);
+        assert((uint64_t) offset + count <= segment->length);
+        uint32_t *words = segment->words + offset;
+        for (uint32_t i = 0; i < count; i++) {
+                words[i] = value;
+        }
+        if (table->dirty != NULL) {
+                markWrittenRange(table, target, offset, count);
+        }
+}
+
+/**************************** resizeSegment() ****************************
+ *  Purpose: Changes the length of a mapped segment
+ *  Parameters: segmentTable table: the segments of the program
+ *              uint32_t identifier: the segment
+ *              uint32_t length: its new number of words
+ *  Returns: None
+ *  Effects: Keeps the words that still fit and sets any new ones to 0,
+ *           and counts the change in the table's usage.
+ *           The segment may move, so pointers to it become stale; a
+ *           segment without pages of its own is grown in place by
+ *           realloc when there is room.
+ *  Expects: the segment must exist and not be segment 0
+ ***********************************************************************/
+void resizeSegment(segmentTable table, uint32_t identifier, uint32_t length)
+{
+        assert(identifier != 0);
+        Segment segment = getSegment(table, identifier);
+        assert(segment != NULL);
+        setSegment(table, identifier, NULL);
+        uint32_t old_length = segment->length;
+        Segment resized;
+        if (segment->paged) {
+                resized = newSegment(length);
+                memcpy(resized->words, segment->words, (size_t) 
+                       (old_length < length ? old_length : length) * 4);
+                freeSegment(&segment);
+        } else {
+                resized = realloc(segment, sizeof(struct Segment) + 
+                                           (size_t) length * 4);
+                assert(resized != NULL);
+                if (length > old_length) {
+                        memset(resized->words + old_length, 0,
+                               (size_t) (length - old_length) * 4);
+                }
+                resized->length = length;
+        }
+        setSegment(table, identifier, resized);
 }
 
 /**************************** printSegment() ****************************
  *  Purpose: Prints the contents of a specified segment to stdout
- *  Parameters: Seq_T segmentIdentifiers: sequence holding all segments mapped
- *                                        during program execution
- *              int index: index in segmentIdentiifers holding segment to be
- *                         printed
+ *  Parameters: segmentTable table: the segments mapped during program
+ *                                  execution
+ *              int index: identifier of the segment to be printed
  *  Returns: None
- *  Effects: Prints the contents of a segment to stdout, uses Hanson Seq_T
- *           function to get a segment and uses getWord to extract words
+ *  Effects: Prints the contents of a segment to stdout, uses getSegment
+ *           to get a segment and uses getWord to extract words
  *           from a segment
  *  Expects: segment must exist
  ***********************************************************************/
-void printSegment(Seq_T mapped_segments, uint32_t index)
+void printSegment(segmentTable table, uint32_t index)
 {
-        Seq_T desired_segment = Seq_get(mapped_segments, index);
-        for (int i = 0; i < segmentLength(desired_segment); i++) {
+        Segment desired_segment = getSegment(table, index);
+        for (uint32_t i = 0; i < segmentLength(desired_segment); i++) {
                 uint32_t contents = getWord(desired_segment, i);
-                printf("Contents of m[%d][%d]: %du\n", index, i, contents);
+                printf("Contents of m[%u][%u]: %du\n", index, i, contents);
         }
 }
 
 /**************************** printMemory() ****************************
  *  Purpose: Prints all the segments mapped in memory 
- *  Parameters: Seq_T segmentIdentifiers: sequence holding all segments 
- *                                        mapped during program execution
+ *  Parameters: segmentTable table: the segments mapped during program
+ *                                  execution
  *  Returns: None
- *  Effects: Uses Hanson Seq_T functions to obtain a segment, prints data to 
- *           stdout, uses segmentLength and getWord to get values of interest
- *  Expects: segmentIdentifiers must exist and index must be a valid index
+ *  Effects: Uses getSegment to obtain a segment, prints data to stdout,
+ *           uses segmentLength and getWord to get values of interest
+ *  Expects: table must exist
  ***********************************************************************/
-void printMemory(Seq_T mapped_segments)
+void printMemory(segmentTable table)
 {
-       assert(mapped_segments != NULL);
+       assert(table != NULL);
 
-       for (int outer = 0; outer < segmentLength(mapped_segments); outer++){
+       for (int outer = 0; outer < (int) table->count; outer++){
                 if(outer == 0)
                 {
                         printf("Segment 0 has the value 3 in it\n");
                         outer++;
                 }
-                Seq_T desired_segment = Seq_get(mapped_segments, outer);
+                Segment desired_segment = getSegment(table, outer);
                 printf("-------- Segment %d: ---------\n", outer);
-                for (int inner = 0; inner < segmentLength(desired_segment); 
-                                                                inner++) {
+                for (uint32_t inner = 0; 
+                     inner < segmentLength(desired_segment); inner++) {
 
                         uint32_t contents = getWord(desired_segment, inner);
-                        printf("Contents of m[%d][%d]: %u\n", outer, inner, 
+                        printf("Contents of m[%d][%u]: %u\n", outer, inner, 
                                                                 contents);
                 }
        }
@@ -21,54 +21,265 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdbool.h>
 #include "seq.h"
 
-Seq_T 
-mapSegment(Seq_T registers, Seq_T mapped_segments, Seq_T unmapped_identifiers,
-                                                   int rb, int rc);
+typedef struct Segment *Segment;
+
+/* A segment is its length followed by that many words; a paged segment
+   owns whole pages of its own. Every offset below reach is either in 
+   bounds or faults in the segment's guard pages, so it needs no software
+   bounds check; reach is 0 for a segment without guard pages. */
+struct Segment {
+        uint32_t length;
+        uint32_t reach;
+        bool paged;
+        uint32_t words[];
+};
+
+/* What the segments of one machine take: their words and number now,
+the most of each (and of memoryBytes) so far, and 0 or the most bytes 
+the executor lets them take. Packed segments count as their words; the
+packed_ fields say how many of them are packed now and what they take
+packed, and unpacks how often one was needed again. maps and unmaps
+count the MAP and UNMAP instructions. */
+typedef struct memoryUsage {
+        uint64_t words;
+        uint64_t segments;
+        uint64_t peak_words;
+        uint64_t peak_segments;
+        uint64_t peak_bytes;
+        uint64_t limit;
+        uint64_t packed_segments;
+        uint64_t packed_words;
+        uint64_t packed_bytes;
+        uint64_t unpacks;
+        uint64_t maps;
+        uint64_t unmaps;
+} *memoryUsage;
+
+/* A segment kept compressed, see packColdSegments */
+typedef struct packedSegment *packedSegment;
+
+/* Dirty tracking records writes in pages of 1 << DIRTY_PAGE_SHIFT words.
+Bit p of the dirty word of a segment stands for page p, up to page 62; bit
+63 says that the bitmap in dirty_pages holds later pages; and all ones
+stand for the whole segment. */
+#define DIRTY_PAGE_SHIFT 10
+#define DIRTY_LATE_PAGE 63
+#define DIRTY_WHOLE (~(uint64_t) 0)
+
+/* The segments of one machine by identifier: segments[i] is NULL and 
+lengths[i] 0 while identifier i is unmapped, and free_identifiers is a 
+stack of those identifiers. Once packColdSegments is enabled, packed[i]
+holds segment i instead of segments[i] while it is packed, and 
+touched[i] is the epoch in which it was last looked up. Once dirty 
+tracking is enabled, dirty[i] is 0 while segment i is clean and 
+otherwise says which pages were written (see DIRTY_PAGE_SHIFT), and 
+dirty_identifiers lists the identifiers that are not clean. Only memory.c
+writes the table. */
+typedef struct segmentTable {
+        Segment *segments;
+        uint32_t *lengths;
+        uint32_t count;
+        uint32_t capacity;
+        uint32_t *free_identifiers;
+        uint32_t free_count;
+        uint32_t free_capacity;
+        packedSegment *packed;
+        uint32_t *touched;
+        uint32_t epoch;
+        uint64_t *dirty;
+        uint64_t **dirty_pages;
+        uint32_t *dirty_identifiers;
+        uint32_t dirty_count;
+        uint32_t dirty_capacity;
+        struct memoryUsage usage;
+} *segmentTable;
+
+void
+useGuardPages(void);
+
+bool
+guardPagesEnabled(void);
+
+void
+useWriteBarrier(void);
+
+bool
+writeBarrierEnabled(void);
+
+Segment
+newSegment(uint32_t length);
+
+Segment
+newCodeSegment(uint32_t length);
+
+void
+freeSegment(Segment *segment);
+
+uint64_t
+memoryBytes(uint64_t words, uint64_t segments);
+
+bool
+memoryAllows(memoryUsage usage, uint64_t words, uint64_t segments);
+
+segmentTable
+newSegmentTable(Segment segment_0);
+
+void
+freeSegmentTable(segmentTable *table);
+
+uint32_t
+newIdentifier(segmentTable table);
+
+void
+setSegment(segmentTable table, uint32_t identifier, Segment segment);
+
+void
+enablePacking(segmentTable table);
+
+uint32_t
+packColdSegments(segmentTable table);
+
+Segment
+touchSegment(segmentTable table, uint32_t identifier);
+
+void
+enableDirtyTracking(segmentTable table);
+
+void
+markWrittenPage(segmentTable table, uint32_t identifier, uint32_t page);
+
+bool
+pageWritten(segmentTable table, uint32_t identifier, uint32_t page);
+
+void
+markWrittenRange(segmentTable table, uint32_t identifier, uint32_t first,
+                 uint32_t count);
+
+void
+clearDirty(segmentTable table);
+
+void
+placeSegment(segmentTable table, uint32_t identifier, Segment segment);
+
+void
+restoreIdentifiers(segmentTable table, uint32_t count, 
+                   const uint32_t *free_identifiers, uint32_t free_count);
+
+/************************** markWritten() **************************
+ *  Purpose: Records a store for dirty tracking
+ *  Parameters: segmentTable table: a table with dirty tracking enabled
+ *              uint32_t identifier: the segment written
+ *              uint32_t offset: the word written
+ *  Returns: None
+ *  Effects: Sets the bit of the page of the word in the segment's dirty
+ *           word, leaving a clean segment or a late page to 
+ *           markWrittenPage
+ *  Expects: the segment must be mapped and offset inside it
+ ******************************************************************/
+static inline void markWritten(segmentTable table, uint32_t identifier,
+                               uint32_t offset)
+{
+        uint32_t page = offset >> DIRTY_PAGE_SHIFT;
+        if (table->dirty[identifier] == 0 || page >= DIRTY_LATE_PAGE) {
+                markWrittenPage(table, identifier, page);
+        } else {
+                table->dirty[identifier] |= (uint64_t) 1 << page;
+        }
+}
+
+/************************** getSegment() **************************
+ *  Purpose: Looks up a segment by identifier, with one indexed load
+ *  Parameters: segmentTable table: the segment table
+ *              uint32_t identifier: the segment
+ *  Returns: the segment, or NULL if identifier is unmapped
+ *  Effects: Once packing is enabled, marks the segment as used and 
+ *           unpacks it if need be (touchSegment)
+ *  Expects: table must exist and identifier be within it
+ ******************************************************************/
+static inline Segment getSegment(segmentTable table, uint32_t identifier)
+{
+        assert(identifier < table->count);
+        if (table->touched != NULL) {
+                return touchSegment(table, identifier);
+        }
+        return table->segments[identifier];
+}
+
+/************************* segmentMapped() *************************
+ *  Purpose: Tells whether an identifier names a mapped segment
+ *  Parameters: segmentTable table: the segment table
+ *              uint32_t identifier: any value
+ *  Returns: true if getSegment(table, identifier) would return a segment
+ ******************************************************************/
+static inline bool segmentMapped(segmentTable table, uint32_t identifier)
+{
+        return identifier < table->count && 
+               (table->segments[identifier] != NULL ||
+                (table->packed != NULL && 
+                 table->packed[identifier] != NULL));
+}
+
+Segment 
+mapSegment(Seq_T registers, segmentTable table, int rb, int rc);
+
+uint32_t
+mapSegmentOf(segmentTable table, uint32_t length);
 
 void 
-unmapSegment(Seq_T registers, Seq_T mapped_segments,
-             Seq_T unmapped_identifiers, int rc);
+unmapSegment(Seq_T registers, segmentTable table, int rc);
 
 void
-addSegToMemory(Seq_T mapped_segments, Seq_T segment);
+unmapSegmentOf(segmentTable table, uint32_t identifier);
 
 void 
-segLoad(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc);
+segLoad(Seq_T registers, segmentTable table, int ra, int rb, int rc);
 
 void
-segStore(Seq_T registers, Seq_T mapped_segments, int ra, int rb, int rc);
+segStore(Seq_T registers, segmentTable table, int ra, int rb, int rc);
 
 void 
-loadProgram(Seq_T mapped_segments, Seq_T unmapped_identifiers, Seq_T registers,
-            int rb, int rc, uint32_t *program_counter);
+segLoadUnchecked(Seq_T registers, segmentTable table, int ra, int rb, int rc);
 
-int 
-segmentLength(Seq_T segment);
+void
+segStoreUnchecked(Seq_T registers, segmentTable table, int ra, int rb, int rc);
 
-Seq_T 
-getSegment(Seq_T mapped_segments, uint32_t index);
+void 
+loadProgram(segmentTable table, Seq_T registers, int rb, int rc,
+            uint32_t *program_counter);
 
-Seq_T 
-duplicateSegment(Seq_T segment);
+uint32_t
+loadProgramOf(segmentTable table, uint32_t identifier, uint32_t target);
+
+uint32_t 
+segmentLength(Segment segment);
+
+Segment 
+duplicateSegment(Segment segment);
 
 void
-addSegmentIdentifier(Seq_T segment_identifiers, uint32_t identifier);
+setWord(Segment segment, uint32_t index, uint32_t word);
+
+uint32_t 
+getWord(Segment segment, uint32_t index);
 
 void
-setSegment(Seq_T mapped_segments, uint32_t index, Seq_T segment);
+copyWords(segmentTable table, uint32_t target, uint32_t target_offset,
+          uint32_t source, uint32_t source_offset, uint32_t count);
 
 void
-setWord(Seq_T segment, uint32_t index, uint32_t word);
+fillWords(segmentTable table, uint32_t target, uint32_t offset,
+          uint32_t value, uint32_t count);
 
-uint32_t 
-getWord(Seq_T segment, uint32_t index);
+void
+resizeSegment(segmentTable table, uint32_t identifier, uint32_t length);
 
 void 
-printSegment(Seq_T mapped_segments, uint32_t index);
+printSegment(segmentTable table, uint32_t index);
 
 void 
-printMemory(Seq_T mapped_segments);
+printMemory(segmentTable table);
 
 #endif
\ No newline at end of file
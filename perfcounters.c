@@ -0,0 +1,315 @@
+/******************************************************************************
+ *
+ *                              perfcounters.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for perfcounters, the host
+ *    performance counters of --perf-counters.
+ *
+ *    Each event is opened on its own with perf_event_open, counting this
+ *    thread in user space only, so that it works at the default
+ *    perf_event_paranoid level and an event the CPU lacks does not take
+ *    the others with it. Events are enabled at the start of a phase and
+ *    read at its end, which costs two system calls per event and nothing
+ *    while the program runs. When the kernel time-shares more events than
+ *    the PMU has counters, a count is scaled by the share of the phase it
+ *    was counted in, as perf stat does.
+ *
+ *    A host with no PMU (most virtual machines) opens none of the
+ *    hardware events; the software events of the kernel (task clock,
+ *    page faults, context switches) are counted instead, and where
+ *    perf_event_open is not allowed at all, the same figures come from
+ *    getrusage.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "assert.h"
+#include "perfcounters.h"
+
+/* An event to count, as perf_event_open takes it */
+struct perfEvent
+{
+        const char *name;
+        uint32_t type;
+        uint64_t config;
+};
+
+/* The L1d, LLC and dTLB read misses, in the encoding of cache events */
+#define CACHE_READ_MISS(cache)                                          \
+        ((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 |                   \
+         PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+static const struct perfEvent HARDWARE_EVENTS[] = {
+        { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { "branch-misses", PERF_TYPE_HARDWARE,
+          PERF_COUNT_HW_BRANCH_MISSES },
+        { "L1d-misses", PERF_TYPE_HW_CACHE,
+          CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+        { "LLC-misses", PERF_TYPE_HW_CACHE,
+          CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+        { "dTLB-misses", PERF_TYPE_HW_CACHE,
+          CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) }
+};
+
+static const struct perfEvent SOFTWARE_EVENTS[] = {
+        { "task-clock-ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+        { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+        { "context-switches", PERF_TYPE_SOFTWARE,
+          PERF_COUNT_SW_CONTEXT_SWITCHES }
+};
+
+#define MAX_EVENTS (sizeof(HARDWARE_EVENTS) / sizeof(struct perfEvent))
+
+/* Where the counts come from */
+typedef enum perfSource {
+        SOURCE_HARDWARE, SOURCE_SOFTWARE, SOURCE_RUSAGE
+} perfSource;
+
+/* Struct that holds the open events (-1 for one the host does not have)
+and, for the getrusage fallback, the usage at the start of the phase */
+struct perfCounters
+{
+        perfSource source;
+        const struct perfEvent *events;
+        size_t count;
+        int fds[MAX_EVENTS];
+        struct rusage start;
+};
+
+/* What read() gives for an event opened with the read format below */
+struct perfReading
+{
+        uint64_t value;
+        uint64_t enabled;
+        uint64_t running;
+};
+
+/****************************** openEvent() ******************************
+ *  Purpose: Opens a counter of this thread, disabled
+ *  Parameters: const struct perfEvent *event: what to count
+ *  Returns: its file descriptor, or -1 if the host cannot count it
+ ***********************************************************************/
+static int openEvent(const struct perfEvent *event)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event->type;
+        attr.config = event->config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**************************** openEvents() ****************************
+ *  Purpose: Opens each of a list of events
+ *  Parameters: perfCounters counters: where to keep them
+ *              const struct perfEvent *events: the list
+ *              size_t count: its length
+ *  Returns: how many could be opened
+ ***********************************************************************/
+static size_t openEvents(perfCounters counters,
+                         const struct perfEvent *events, size_t count)
+{
+        size_t opened = 0;
+        counters->events = events;
+        counters->count = count;
+        for (size_t i = 0; i < count; i++) {
+                counters->fds[i] = openEvent(&events[i]);
+                opened += counters->fds[i] != -1;
+        }
+        return opened;
+}
+
+/**************************** closeEvents() ****************************
+ *  Purpose: Closes the events that were opened
+ *  Parameters: perfCounters counters: the events
+ *  Returns: None
+ ***********************************************************************/
+static void closeEvents(perfCounters counters)
+{
+        for (size_t i = 0; i < counters->count; i++) {
+                if (counters->fds[i] != -1) {
+                        close(counters->fds[i]);
+                }
+        }
+        counters->count = 0;
+}
+
+/*************************** openPerfCounters() ***************************
+ *  Purpose: Opens the best counters the host allows
+ *  Parameters: None
+ *  Returns: the counters, ready for startPerfPhase
+ *  Effects: Says on stderr when it falls back to software counters,
+ *           and why
+ ***********************************************************************/
+perfCounters openPerfCounters(void)
+{
+        perfCounters counters = malloc(sizeof(struct perfCounters));
+        assert(counters != NULL);
+        counters->source = SOURCE_HARDWARE;
+        if (openEvents(counters, HARDWARE_EVENTS,
+                       sizeof(HARDWARE_EVENTS) / sizeof(struct perfEvent))
+            != 0) {
+                return counters;
+        }
+        int error = errno;
+        closeEvents(counters);
+        counters->source = SOURCE_SOFTWARE;
+        if (openEvents(counters, SOFTWARE_EVENTS,
+                       sizeof(SOFTWARE_EVENTS) / sizeof(struct perfEvent))
+            != 0) {
+                fprintf(stderr, "um: perf counters: no hardware counters "
+                                "(%s), counting software events\n",
+                        strerror(error));
+                return counters;
+        }
+        error = errno;
+        closeEvents(counters);
+        counters->source = SOURCE_RUSAGE;
+        fprintf(stderr, "um: perf counters: perf_event_open unavailable "
+                        "(%s), using getrusage\n", strerror(error));
+        return counters;
+}
+
+/*************************** startPerfPhase() ***************************
+ *  Purpose: Starts counting a phase of the run
+ *  Parameters: perfCounters counters: the counters
+ *  Returns: None
+ *  Effects: Zeroes and enables every counter
+ *  Expects: counters must exist
+ ***********************************************************************/
+void startPerfPhase(perfCounters counters)
+{
+        assert(counters != NULL);
+        if (counters->source == SOURCE_RUSAGE) {
+                getrusage(RUSAGE_SELF, &counters->start);
+                return;
+        }
+        for (size_t i = 0; i < counters->count; i++) {
+                if (counters->fds[i] != -1) {
+                        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+                        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+}
+
+/***************************** putCount() *****************************
+ *  Purpose: Writes one count of a phase on stderr
+ *  Parameters: const char *name: what was counted
+ *              double count: the count
+ *              double share: the share of the phase it was counted in
+ *              uint64_t um_instructions: UM instructions of the phase
+ *  Returns: None
+ ***********************************************************************/
+static void putCount(const char *name, double count, double share,
+                     uint64_t um_instructions)
+{
+        fprintf(stderr, "um:   %-18s %16.0f", name, count);
+        if (um_instructions != 0) {
+                fprintf(stderr, "  %10.3f per UM instruction",
+                        count / um_instructions);
+        }
+        if (share < 1) {
+                fprintf(stderr, "  (scaled, counted %.0f%%)", 100 * share);
+        }
+        fprintf(stderr, "\n");
+}
+
+/******************************* cpuTime() *******************************
+ *  Purpose: Adds up the user and system time of a getrusage reading
+ *  Parameters: const struct rusage *usage: the reading
+ *  Returns: the time in nanoseconds
+ ***********************************************************************/
+static double cpuTime(const struct rusage *usage)
+{
+        return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1e9 +
+               (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) * 1e3;
+}
+
+/**************************** endPerfPhase() ****************************
+ *  Purpose: Stops counting a phase and reports it on stderr
+ *  Parameters: perfCounters counters: the counters
+ *              const char *phase: the name of the phase
+ *              uint64_t um_instructions: UM instructions the phase
+ *                                        executed, or 0 for a phase that
+ *                                        runs none
+ *  Returns: None
+ *  Effects: Disables the counters. Counts are followed by what they come
+ *           to per UM instruction.
+ *  Expects: counters must exist and be counting
+ ***********************************************************************/
+void endPerfPhase(perfCounters counters, const char *phase,
+                  uint64_t um_instructions)
+{
+        assert(counters != NULL && phase != NULL);
+        fflush(stdout);
+        fprintf(stderr, "um: perf counters, %s phase (%" PRIu64
+                        " UM instructions):\n", phase, um_instructions);
+        if (counters->source == SOURCE_RUSAGE) {
+                struct rusage end;
+                getrusage(RUSAGE_SELF, &end);
+                struct rusage *start = &counters->start;
+                putCount("cpu-time-ns", cpuTime(&end) - cpuTime(start), 1,
+                         um_instructions);
+                putCount("page-faults", (end.ru_minflt - start->ru_minflt) +
+                                        (end.ru_majflt - start->ru_majflt),
+                         1, um_instructions);
+                putCount("context-switches",
+                         (end.ru_nvcsw - start->ru_nvcsw) +
+                         (end.ru_nivcsw - start->ru_nivcsw),
+                         1, um_instructions);
+                return;
+        }
+
+        for (size_t i = 0; i < counters->count; i++) {
+                int fd = counters->fds[i];
+                struct perfReading reading;
+                if (fd == -1) {
+                        fprintf(stderr, "um:   %-18s %16s\n",
+                                counters->events[i].name, "not supported");
+                        continue;
+                }
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &reading, sizeof(reading)) !=
+                    (ssize_t) sizeof(reading) || reading.running == 0) {
+                        fprintf(stderr, "um:   %-18s %16s\n",
+                                counters->events[i].name, "not counted");
+                        continue;
+                }
+                double share = (double) reading.running / reading.enabled;
+                putCount(counters->events[i].name, reading.value / share,
+                         share, um_instructions);
+        }
+}
+
+/************************** closePerfCounters() **************************
+ *  Purpose: Closes the counters
+ *  Parameters: perfCounters *counters: reference to the counters
+ *  Returns: None
+ *  Effects: Sets *counters to NULL
+ *  Expects: counters and *counters must exist
+ ***********************************************************************/
+void closePerfCounters(perfCounters *counters)
+{
+        assert(counters != NULL && *counters != NULL);
+        closeEvents(*counters);
+        free(*counters);
+        *counters = NULL;
+}
@@ -0,0 +1,36 @@
+/*************************************************************
+ *
+ *                     perfcounters.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for perfcounters, a module that
+ *    reads the hardware performance counters of the host around the
+ *    phases of a run (--perf-counters): cycles, instructions, branch
+ *    misses, L1d, LLC and dTLB misses, and what each costs per UM
+ *    instruction. Without a PMU it falls back to software counters.
+ *
+ **************************************************************/
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdint.h>
+
+typedef struct perfCounters *perfCounters;
+
+perfCounters
+openPerfCounters(void);
+
+void
+startPerfPhase(perfCounters counters);
+
+void
+endPerfPhase(perfCounters counters, const char *phase,
+             uint64_t um_instructions);
+
+void
+closePerfCounters(perfCounters *counters);
+
+#endif
@@ -0,0 +1,87 @@
+/*************************************************************
+ *
+ *                     probes.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the static tracepoints of the um, for tools
+ *    that read USDT probes (bpftrace, perf, systemtap) to attach to a
+ *    running um:
+ *
+ *        um:map(identifier, length)       a segment is mapped
+ *        um:unmap(identifier)             a segment is unmapped
+ *        um:load__program(segment, pc)    a LOAD_PROGRAM jumps
+ *        um:bulk__loop(pc, iterations)    a loop starting at pc is run
+ *                                         in bulk (see idiom.c), in place
+ *                                         of the load__program probes of
+ *                                         its iterations
+ *        um:input(byte, bytes read)       INPUT reads a byte (or ~0)
+ *        um:output(byte)                  OUTPUT writes a byte
+ *        um:run__start(pc, instructions)  run() starts a program
+ *        um:run__done(status, instructions)   and stops it
+ *
+ *    A probe is a nop, plus a note in the .note.stapsdt section that
+ *    tells a tracer where the nop is and where its arguments are, laid
+ *    out as <sys/sdt.h> lays it out. The note is written here so that no
+ *    header or library has to be installed: while no tracer is attached
+ *    a probe costs the nop and at most moving its arguments where the
+ *    note says they are. Every argument is passed as an unsigned 64 bit
+ *    number. The probes exist on x86-64 with GCC or Clang; elsewhere,
+ *    or when built with -DUM_NO_PROBES, they compile to nothing.
+ *
+ **************************************************************/
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(UM_NO_PROBES)
+
+/* The note of one probe of provider um, whose arguments are described by
+args; _.stapsdt.base lets tracers correct the address of the nop when the
+binary is prelinked, as with <sys/sdt.h> */
+#define UM_PROBE_NOTE(name, args)                                       \
+        "990: nop\n"                                                    \
+        ".pushsection .note.stapsdt,\"\",\"note\"\n"                    \
+        ".balign 4\n"                                                   \
+        ".4byte 992f-991f, 994f-993f, 3\n"                              \
+        "991: .asciz \"stapsdt\"\n"                                     \
+        "992: .balign 4\n"                                              \
+        "993: .8byte 990b\n"                                            \
+        ".8byte _.stapsdt.base\n"                                       \
+        ".8byte 0\n"                                                    \
+        ".asciz \"um\"\n"                                               \
+        ".asciz \"" #name "\"\n"                                        \
+        ".asciz \"" args "\"\n"                                         \
+        "994: .balign 4\n"                                              \
+        ".popsection\n"                                                 \
+        ".ifndef _.stapsdt.base\n"                                      \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\","               \
+        ".stapsdt.base,comdat\n"                                        \
+        ".weak _.stapsdt.base\n"                                        \
+        ".hidden _.stapsdt.base\n"                                      \
+        "_.stapsdt.base: .space 1\n"                                    \
+        ".size _.stapsdt.base, 1\n"                                     \
+        ".popsection\n"                                                 \
+        ".endif\n"
+
+/* An argument may be a register, a memory operand or a constant */
+#define UM_PROBE_ARG(value) "nor" ((uint64_t) (value))
+
+#define UM_PROBE1(name, a1)                                             \
+        __asm__ __volatile__(UM_PROBE_NOTE(name, "8@%0")                \
+                             : : UM_PROBE_ARG(a1))
+#define UM_PROBE2(name, a1, a2)                                         \
+        __asm__ __volatile__(UM_PROBE_NOTE(name, "8@%0 8@%1")           \
+                             : : UM_PROBE_ARG(a1), UM_PROBE_ARG(a2))
+
+#else
+
+#define UM_PROBE1(name, a1) ((void) (a1))
+#define UM_PROBE2(name, a1, a2) ((void) (a1), (void) (a2))
+
+#endif
+
+#endif
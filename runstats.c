@@ -0,0 +1,414 @@
+/******************************************************************************
+ *
+ *                              runstats.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for runstats, the report on a
+ *    run that --stats-file writes.
+ *
+ *    The report is written when the run ends and whenever the um gets
+ *    SIGUSR1. The handler only asks the executor for a report, which is
+ *    then written at the next block boundary, where the counts agree with
+ *    each other (a program waiting for input reports once it has read).
+ *    Each report is written to PATH.tmp and renamed over PATH, so readers
+ *    never see half of one.
+ *
+ *    Timings are seconds since the um started: loading ends when the
+ *    report is opened, just before the program runs, and the first output
+ *    is the first byte OUTPUT wrote. Opcode counts leave out the copy,
+ *    fill and compare loops the executor runs in bulk, which are reported
+ *    on their own, so that they and the counts add up to the instructions
+ *    executed by this um.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "isa.h"
+#include "runstats.h"
+#include "timing.h"
+
+/* Struct that holds where and how to write the report, and what it says
+that the context does not know */
+struct runStats
+{
+        char *path;
+        char *temporary;
+        statsFormat format;
+        const char *program;
+        executionEngine engine;
+        double started;
+        double loaded;
+};
+
+/* The report SIGUSR1 asks for, and of which context */
+static runStats watched_stats = NULL;
+static executionContext watched_context = NULL;
+
+/* Everything a report says, gathered once for either format */
+struct reportData
+{
+        const char *status;
+        uint64_t instructions;
+        uint64_t opcodes[16];
+        uint64_t looped;
+        double load_seconds;
+        double first_output_seconds;
+        bool output;
+        double total_seconds;
+        struct memoryUsage memory;
+        uint64_t input_bytes;
+        uint64_t output_bytes;
+        uint64_t jumps;
+};
+
+/***************************** openRunStats() *****************************
+ *  Purpose: Prepares the report on a run
+ *  Parameters: const char *path: the file to write the report to
+ *              statsFormat format: JSON or Prometheus text
+ *              const char *program: the program, as given to the um
+ *              executionEngine engine: the engine that runs it
+ *              double started: when the um started, on the monotonic
+ *                              clock
+ *  Returns: the report
+ *  Effects: Takes now as the end of loading
+ *  Expects: path and program must exist and outlive the report
+ ***********************************************************************/
+runStats openRunStats(const char *path, statsFormat format,
+                      const char *program, executionEngine engine,
+                      double started)
+{
+        assert(path != NULL && program != NULL);
+        runStats stats = malloc(sizeof(struct runStats));
+        assert(stats != NULL);
+        size_t length = strlen(path);
+        stats->path = malloc(length + 1);
+        stats->temporary = malloc(length + sizeof(".tmp"));
+        assert(stats->path != NULL && stats->temporary != NULL);
+        memcpy(stats->path, path, length + 1);
+        memcpy(stats->temporary, path, length);
+        memcpy(stats->temporary + length, ".tmp", sizeof(".tmp"));
+        stats->format = format;
+        stats->program = program;
+        stats->engine = engine;
+        stats->started = started;
+        stats->loaded = clockNow(CLOCK_MONOTONIC);
+        return stats;
+}
+
+/****************************** putQuoted() ******************************
+ *  Purpose: Writes a string as a quoted JSON string or label value
+ *  Parameters: FILE *file: where to write
+ *              const char *text: the string
+ *              bool json: whether other control characters need escaping,
+ *                         as they do in JSON and not in label values
+ *  Returns: None
+ ***********************************************************************/
+static void putQuoted(FILE *file, const char *text, bool json)
+{
+        putc('"', file);
+        for (; *text != '\0'; text++) {
+                unsigned char c = *text;
+                if (c == '"' || c == '\\') {
+                        fprintf(file, "\\%c", c);
+                } else if (c == '\n') {
+                        fputs("\\n", file);
+                } else if (c < 0x20 && json) {
+                        fprintf(file, "\\u%04x", c);
+                } else {
+                        putc(c, file);
+                }
+        }
+        putc('"', file);
+}
+
+/******************************* putJson() *******************************
+ *  Purpose: Writes a report as a JSON object
+ *  Parameters: FILE *file: where to write
+ *              runStats stats: the report
+ *              const struct reportData *data: what it says
+ *  Returns: None
+ ***********************************************************************/
+static void putJson(FILE *file, runStats stats,
+                    const struct reportData *data)
+{
+        fprintf(file, "{\n  \"program\": ");
+        putQuoted(file, stats->program, true);
+        fprintf(file, ",\n  \"engine\": \"%s\",\n  \"status\": \"%s\",\n",
+                engineName(stats->engine), data->status);
+        fprintf(file, "  \"instructions\": %" PRIu64 ",\n",
+                data->instructions);
+        fprintf(file, "  \"opcodes\": {");
+        for (unsigned opcode = 0; opcode < 16; opcode++) {
+                fprintf(file, "%s\n    \"%s\": %" PRIu64,
+                        opcode == 0 ? "" : ",", Um_mnemonic(opcode),
+                        data->opcodes[opcode]);
+        }
+        fprintf(file, "\n  },\n  \"loop_instructions\": %" PRIu64 ",\n",
+                data->looped);
+
+        fprintf(file, "  \"timings\": {\n    \"load_seconds\": %.6f,\n",
+                data->load_seconds);
+        if (data->output) {
+                fprintf(file, "    \"first_output_seconds\": %.6f,\n",
+                        data->first_output_seconds);
+        } else {
+                fprintf(file, "    \"first_output_seconds\": null,\n");
+        }
+        fprintf(file, "    \"total_seconds\": %.6f\n  },\n",
+                data->total_seconds);
+
+        fprintf(file, "  \"memory\": {\n    \"segments\": %" PRIu64 ",\n"
+                      "    \"words\": %" PRIu64 ",\n"
+                      "    \"peak_segments\": %" PRIu64 ",\n"
+                      "    \"peak_words\": %" PRIu64 ",\n"
+                      "    \"peak_bytes\": %" PRIu64 ",\n"
+                      "    \"maps\": %" PRIu64 ",\n"
+                      "    \"unmaps\": %" PRIu64 "\n  },\n",
+                data->memory.segments, data->memory.words,
+                data->memory.peak_segments, data->memory.peak_words,
+                data->memory.peak_bytes, data->memory.maps,
+                data->memory.unmaps);
+        fprintf(file, "  \"io\": {\n    \"input_bytes\": %" PRIu64 ",\n"
+                      "    \"output_bytes\": %" PRIu64 "\n  },\n",
+                data->input_bytes, data->output_bytes);
+        fprintf(file, "  \"jumps\": %" PRIu64 "\n}\n", data->jumps);
+}
+
+/***************************** putMetric() *****************************
+ *  Purpose: Starts a metric of the Prometheus text format
+ *  Parameters: FILE *file: where to write
+ *              const char *name, *type, *help: the metric
+ *  Returns: None
+ ***********************************************************************/
+static void putMetric(FILE *file, const char *name, const char *type,
+                      const char *help)
+{
+        fprintf(file, "# HELP %s %s\n# TYPE %s %s\n", name, help, name,
+                type);
+}
+
+/***************************** putSample() *****************************
+ *  Purpose: Writes a sample of a metric, labelled with the program and
+ *           engine
+ *  Parameters: FILE *file: where to write
+ *              runStats stats: the report
+ *              const char *name: the metric
+ *              const char *label, *value: one more label, or NULL
+ *              double sample: the value
+ *  Returns: None
+ ***********************************************************************/
+static void putSample(FILE *file, runStats stats, const char *name,
+                      const char *label, const char *value, double sample)
+{
+        fprintf(file, "%s{program=", name);
+        putQuoted(file, stats->program, false);
+        fprintf(file, ",engine=\"%s\"", engineName(stats->engine));
+        if (label != NULL) {
+                fprintf(file, ",%s=", label);
+                putQuoted(file, value, false);
+        }
+        fprintf(file, "} %.17g\n", sample);
+}
+
+/**************************** putPrometheus() ****************************
+ *  Purpose: Writes a report in the Prometheus text format
+ *  Parameters: FILE *file: where to write
+ *              runStats stats: the report
+ *              const struct reportData *data: what it says
+ *  Returns: None
+ ***********************************************************************/
+static void putPrometheus(FILE *file, runStats stats,
+                          const struct reportData *data)
+{
+        putMetric(file, "um_run_info", "gauge",
+                  "Why the run last stopped, or running.");
+        putSample(file, stats, "um_run_info", "status", data->status, 1);
+        putMetric(file, "um_instructions_total", "counter",
+                  "Instructions executed.");
+        putSample(file, stats, "um_instructions_total", NULL, NULL,
+                  data->instructions);
+        putMetric(file, "um_opcode_instructions_total", "counter",
+                  "Instructions executed by opcode.");
+        for (unsigned opcode = 0; opcode < 16; opcode++) {
+                putSample(file, stats, "um_opcode_instructions_total",
+                          "opcode", Um_mnemonic(opcode),
+                          data->opcodes[opcode]);
+        }
+        putMetric(file, "um_loop_instructions_total", "counter",
+                  "Instructions of copy, fill and compare loops run in "
+                  "bulk, counted by opcode as well.");
+        putSample(file, stats, "um_loop_instructions_total", NULL, NULL,
+                  data->looped);
+
+        putMetric(file, "um_phase_seconds", "gauge",
+                  "Seconds from the start of the um to the end of a "
+                  "phase.");
+        putSample(file, stats, "um_phase_seconds", "phase", "load",
+                  data->load_seconds);
+        if (data->output) {
+                putSample(file, stats, "um_phase_seconds", "phase",
+                          "first_output", data->first_output_seconds);
+        }
+        putSample(file, stats, "um_phase_seconds", "phase", "total",
+                  data->total_seconds);
+
+        putMetric(file, "um_segments", "gauge", "Segments mapped.");
+        putSample(file, stats, "um_segments", NULL, NULL,
+                  data->memory.segments);
+        putMetric(file, "um_segments_peak", "gauge",
+                  "Most segments mapped at once.");
+        putSample(file, stats, "um_segments_peak", NULL, NULL,
+                  data->memory.peak_segments);
+        putMetric(file, "um_words", "gauge", "Words of mapped segments.");
+        putSample(file, stats, "um_words", NULL, NULL, data->memory.words);
+        putMetric(file, "um_words_peak", "gauge",
+                  "Most words of mapped segments at once.");
+        putSample(file, stats, "um_words_peak", NULL, NULL,
+                  data->memory.peak_words);
+        putMetric(file, "um_segment_bytes_peak", "gauge",
+                  "Most bytes segments took at once.");
+        putSample(file, stats, "um_segment_bytes_peak", NULL, NULL,
+                  data->memory.peak_bytes);
+        putMetric(file, "um_maps_total", "counter", "Segments mapped.");
+        putSample(file, stats, "um_maps_total", NULL, NULL,
+                  data->memory.maps);
+        putMetric(file, "um_unmaps_total", "counter", "Segments unmapped.");
+        putSample(file, stats, "um_unmaps_total", NULL, NULL,
+                  data->memory.unmaps);
+
+        putMetric(file, "um_input_bytes_total", "counter",
+                  "Bytes INPUT read.");
+        putSample(file, stats, "um_input_bytes_total", NULL, NULL,
+                  data->input_bytes);
+        putMetric(file, "um_output_bytes_total", "counter",
+                  "Bytes OUTPUT wrote.");
+        putSample(file, stats, "um_output_bytes_total", NULL, NULL,
+                  data->output_bytes);
+        putMetric(file, "um_jumps_total", "counter",
+                  "LOAD_PROGRAMs executed.");
+        putSample(file, stats, "um_jumps_total", NULL, NULL, data->jumps);
+}
+
+/***************************** writeRunStats() *****************************
+ *  Purpose: Writes the report on a run as it stands
+ *  Parameters: runStats stats: the report
+ *              executionContext context: the run, stopped or at a block
+ *                                        boundary
+ *  Returns: None
+ *  Effects: Replaces the file at once; says on stderr why it could not,
+ *           and lets the run carry on
+ *  Expects: stats and context must exist
+ ***********************************************************************/
+void writeRunStats(runStats stats, executionContext context)
+{
+        assert(stats != NULL && context != NULL);
+        struct reportData data;
+        data.status = statusName(contextStatus(context));
+        data.instructions = contextInstructions(context);
+        contextOpcodeCounts(context, data.opcodes, &data.looped);
+        data.load_seconds = stats->loaded - stats->started;
+        double first_output = contextFirstOutput(context);
+        data.output = first_output != 0;
+        data.first_output_seconds = first_output - stats->started;
+        data.total_seconds = clockNow(CLOCK_MONOTONIC) - stats->started;
+        contextMemoryStats(context, &data.memory);
+        data.input_bytes = contextInputBytes(context);
+        data.output_bytes = contextOutputBytes(context);
+        data.jumps = contextJumps(context);
+
+        FILE *file = fopen(stats->temporary, "w");
+        if (file != NULL) {
+                if (stats->format == STATS_PROMETHEUS) {
+                        putPrometheus(file, stats, &data);
+                } else {
+                        putJson(file, stats, &data);
+                }
+                if (fclose(file) == 0 &&
+                    rename(stats->temporary, stats->path) == 0) {
+                        return;
+                }
+        }
+        fprintf(stderr, "um: stats file %s: %s\n", stats->path,
+                strerror(errno));
+}
+
+/**************************** writeRequested() ****************************
+ *  Purpose: Writes the report the executor was asked for
+ *  Parameters: void *closure: the report
+ *              executionContext context: the running context
+ *  Returns: None
+ ***********************************************************************/
+static void writeRequested(void *closure, executionContext context)
+{
+        writeRunStats(closure, context);
+}
+
+/**************************** requestHandler() ****************************
+ *  Purpose: Asks the watched context for a report on SIGUSR1
+ *  Parameters: int signal: SIGUSR1
+ *  Returns: None
+ ***********************************************************************/
+static void requestHandler(int signal)
+{
+        (void) signal;
+        if (watched_context != NULL) {
+                requestReport(watched_context);
+        }
+}
+
+/***************************** watchRunStats() *****************************
+ *  Purpose: Gets the report the counts it needs from a context, and has
+ *           SIGUSR1 write it
+ *  Parameters: runStats stats: the report
+ *              executionContext context: the context, before it runs
+ *  Returns: None
+ *  Effects: Makes the context count opcodes and installs the handler of
+ *           SIGUSR1
+ *  Expects: stats and context must exist; one context at a time
+ ***********************************************************************/
+void watchRunStats(runStats stats, executionContext context)
+{
+        assert(stats != NULL && context != NULL);
+        countOpcodes(context);
+        setReportCallback(context, writeRequested, stats);
+        watched_stats = stats;
+        watched_context = context;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        sigemptyset(&action.sa_mask);
+        action.sa_handler = requestHandler;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, NULL);
+}
+
+/***************************** closeRunStats() *****************************
+ *  Purpose: Frees a report
+ *  Parameters: runStats *stats: reference to the report
+ *  Returns: None
+ *  Effects: Ignores SIGUSR1 from now on if the report was watching a
+ *           context; sets *stats to NULL
+ *  Expects: stats and *stats must exist, and be closed before the
+ *           context it watches is freed
+ ***********************************************************************/
+void closeRunStats(runStats *stats)
+{
+        assert(stats != NULL && *stats != NULL);
+        if (watched_stats == *stats) {
+                signal(SIGUSR1, SIG_IGN);
+                watched_stats = NULL;
+                watched_context = NULL;
+        }
+        free((*stats)->path);
+        free((*stats)->temporary);
+        free(*stats);
+        *stats = NULL;
+}
@@ -0,0 +1,41 @@
+/*************************************************************
+ *
+ *                     runstats.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for runstats, a module that
+ *    writes a machine-readable report on a run (--stats-file): what it
+ *    executed by opcode, how long loading and reaching the first output
+ *    took, how much memory and I/O it used and which engine ran it, as
+ *    JSON or in the Prometheus text format, at exit and on SIGUSR1.
+ *
+ **************************************************************/
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#include "executor.h"
+
+/* How the report is written */
+typedef enum statsFormat {
+        STATS_JSON = 0, STATS_PROMETHEUS
+} statsFormat;
+
+typedef struct runStats *runStats;
+
+runStats
+openRunStats(const char *path, statsFormat format, const char *program,
+             executionEngine engine, double started);
+
+void
+watchRunStats(runStats stats, executionContext context);
+
+void
+writeRunStats(runStats stats, executionContext context);
+
+void
+closeRunStats(runStats *stats);
+
+#endif
@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ *                              signaltext.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for signaltext, which formats
+ *    lines for signal handlers.
+ *
+ *    A handler may only call async-signal-safe functions, which leaves out
+ *    stdio and malloc, so each number is formatted here into a buffer on
+ *    the handler's stack and the line is written with write() alone. A
+ *    line that would overflow its buffer is cut short rather than failing.
+ *
+ *****************************************************************************/
+#include <stdint.h>
+#include <unistd.h>
+#include "signaltext.h"
+
+/****************************** lineText() ******************************
+ *  Purpose: Adds text to a line
+ *  Parameters: struct signalLine *line: the line
+ *              const char *text: the text
+ *  Returns: None
+ *  Effects: Drops what does not fit
+ ***********************************************************************/
+void lineText(struct signalLine *line, const char *text)
+{
+        while (*text != '\0' && line->length < sizeof(line->text)) {
+                line->text[line->length++] = *text++;
+        }
+}
+
+/***************************** lineDecimal() *****************************
+ *  Purpose: Adds a number in decimal to a line
+ *  Parameters: struct signalLine *line: the line
+ *              uint64_t value: the number
+ *  Returns: None
+ ***********************************************************************/
+void lineDecimal(struct signalLine *line, uint64_t value)
+{
+        char digits[21];
+        int next = sizeof(digits) - 1;
+        digits[next] = '\0';
+        do {
+                digits[--next] = '0' + value % 10;
+                value /= 10;
+        } while (value != 0);
+        lineText(line, digits + next);
+}
+
+/******************************* lineHex() *******************************
+ *  Purpose: Adds a word as 8 hex digits to a line
+ *  Parameters: struct signalLine *line: the line
+ *              uint32_t value: the word
+ *  Returns: None
+ ***********************************************************************/
+void lineHex(struct signalLine *line, uint32_t value)
+{
+        char digits[9];
+        for (int i = 7; i >= 0; i--) {
+                digits[i] = "0123456789abcdef"[value & 15];
+                value >>= 4;
+        }
+        digits[8] = '\0';
+        lineText(line, digits);
+}
+
+/****************************** writeLine() ******************************
+ *  Purpose: Ends a line and writes it to stderr
+ *  Parameters: struct signalLine *line: the line
+ *  Returns: None
+ *  Effects: Empties the line, so that the next one can be built in it
+ ***********************************************************************/
+void writeLine(struct signalLine *line)
+{
+        if (line->length == sizeof(line->text)) {
+                line->length--;
+        }
+        line->text[line->length++] = '\n';
+        ssize_t written = write(STDERR_FILENO, line->text, line->length);
+        (void) written;
+        line->length = 0;
+}
@@ -0,0 +1,40 @@
+/*************************************************************
+ *
+ *                     signaltext.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for signaltext, a module that
+ *    builds lines of text and writes them to stderr without stdio or
+ *    malloc, so that signal handlers (the guard page fault report, the
+ *    flight recorder dump) can describe what went wrong.
+ *
+ **************************************************************/
+#ifndef SIGNALTEXT_H
+#define SIGNALTEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A line being built; start it with a length of 0 */
+struct signalLine
+{
+        char text[192];
+        size_t length;
+};
+
+void
+lineText(struct signalLine *line, const char *text);
+
+void
+lineDecimal(struct signalLine *line, uint64_t value);
+
+void
+lineHex(struct signalLine *line, uint32_t value);
+
+void
+writeLine(struct signalLine *line);
+
+#endif
@@ -0,0 +1,29 @@
+/******************************************************************************
+ *
+ *                              timing.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the implementation for timing. Times are seconds
+ *    as a double, which keeps well under a microsecond of precision for
+ *    centuries; intervals (timeouts, phase timings, benchmark runs) are
+ *    read on CLOCK_MONOTONIC, and only times shown to people are read on
+ *    CLOCK_REALTIME.
+ *
+ *****************************************************************************/
+#include <time.h>
+#include "timing.h"
+
+/******************************** clockNow() ********************************
+ *  Purpose: Reads a clock
+ *  Parameters: clockid_t clock: CLOCK_MONOTONIC or CLOCK_REALTIME
+ *  Returns: its time in seconds
+ ***********************************************************************/
+double clockNow(clockid_t clock)
+{
+        struct timespec time;
+        clock_gettime(clock, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+}
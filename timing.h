@@ -0,0 +1,22 @@
+/*************************************************************
+ *
+ *                     timing.h
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains the interface for timing, the one place the um
+ *    and its tools read a clock, so that every timeout, report and
+ *    benchmark measures time the same way.
+ *
+ **************************************************************/
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+double
+clockNow(clockid_t clock);
+
+#endif
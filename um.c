@@ -1,40 +1,595 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "seq.h"
 #include "assert.h"
 #include "registers.h"
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "flight.h"
 #include "fetcher.h"
 #include "executor.h"
+#include "guard.h"
+#include "perfcounters.h"
+#include "runstats.h"
+#include "timing.h"
 
 const int WORD_SIZE = 4;
 
-int main(int argc, char *argv[])
+/* exit status of a program stopped by --max-instructions, --timeout or
+--max-memory */
+const int LIMIT_EXIT_STATUS = 2;
+
+/**************************** usage() ****************************
+ *  Purpose: Prints how to invoke the um and exits with failure
+ ***********************************************************************/
+static void usage(void)
+{
+        fprintf(stderr, "Usage: ./um [--max-instructions N] "
+                        "[--timeout SECONDS] [--guard-pages] "
+                        "[--guard-span KIB] [--smc-barrier] "
+                        "[--engine threaded|specialized] [--profile] "
+                        "[--code-cache DIR] [--ext] [--max-memory MIB] "
+                        "[--compress-cold N] "
+                        "[--checkpoint FILE --checkpoint-every N "
+                        "[--checkpoint-fork]] [--flight-recorder N] "
+                        "[--live-stats] [--stats-file PATH "
+                        "[--stats-format json|prometheus]] "
+                        "[--perf-counters] [--heatmap FILE] [--latency] "
+                        "[UM binary filename]\n"
+                        "       ./um [options] --batch OUTDIR "
+                        "[UM binary filename] INPUT...\n");
+        exit(EXIT_FAILURE);
+}
+
+/**************************** reportStop() ****************************
+ *  Purpose: Describes on stderr the final state of a program that was
+ *           stopped by one of its limits rather than by halting
+ *  Parameters: executionContext context: the stopped context
+ *              executionStatus status: why it stopped
+ *  Returns: None
+ ***********************************************************************/
+static void reportStop(executionContext context, executionStatus status)
+{
+        fflush(stdout);
+        fprintf(stderr, "um: %s after %" PRIu64 " instructions, pc = %u\n",
+                        statusName(status), contextInstructions(context),
+                        contextProgramCounter(context));
+        for (int i = 0; i < 8; i++) {
+                fprintf(stderr, "%s$r[%d] = %u", i == 0 ? "um: " : ", ", i,
+                                contextRegister(context, i));
+        }
+        fprintf(stderr, "\n");
+}
+
+/*************************** reportProfile() ***************************
+ *  Purpose: Describes on stderr how a program ran, for --profile
+ *  Parameters: executionContext context: the context after run()
+ *  Returns: None
+ ***********************************************************************/
+static void reportProfile(executionContext context)
+{
+        uint64_t hits, misses;
+        contextSiteStats(context, &hits, &misses);
+        uint64_t accesses = hits + misses;
+
+        fflush(stdout);
+        fprintf(stderr, "um: %" PRIu64 " instructions\n", 
+                        contextInstructions(context));
+        fprintf(stderr, "um: segment sites: %" PRIu64 " hits, %" PRIu64
+                        " misses (%.2f%% hit rate)\n", hits, misses,
+                        accesses == 0 ? 0.0 : 100.0 * hits / accesses);
+}
+
+/*************************** reportMemory() ***************************
+ *  Purpose: Describes on stderr the most memory a program's segments 
+ *           took, and what packing cold segments saved, for --max-memory,
+ *           --compress-cold and --profile
+ *  Parameters: executionContext context: the context after run()
+ *  Returns: None
+ ***********************************************************************/
+static void reportMemory(executionContext context)
+{
+        struct memoryUsage usage;
+        contextMemoryStats(context, &usage);
+
+        fflush(stdout);
+        fprintf(stderr, "um: memory high-water mark: %" PRIu64 " KiB, %" 
+                        PRIu64 " words, %" PRIu64 " segments", 
+                        (usage.peak_bytes + 1023) / 1024, usage.peak_words,
+                        usage.peak_segments);
+        if (usage.limit != 0) {
+                fprintf(stderr, " (limit %" PRIu64 " KiB)", 
+                                usage.limit / 1024);
+        }
+        fprintf(stderr, "\n");
+        if (usage.packed_segments != 0 || usage.unpacks != 0) {
+                fprintf(stderr, "um: cold segments: %" PRIu64 " packed, %"
+                                PRIu64 " words in %" PRIu64 " KiB; %" 
+                                PRIu64 " unpacked again\n",
+                                usage.packed_segments, usage.packed_words,
+                                (usage.packed_bytes + 1023) / 1024,
+                                usage.unpacks);
+        }
+}
+
+/************************** runCheckpointed() **************************
+ *  Purpose: Runs a program to the end, adding a checkpoint to its log
+ *           every so many instructions, for --checkpoint
+ *  Parameters: executionContext context: the program
+ *              checkpointLog log: its log
+ *              uint64_t interval: instructions between two checkpoints
+ *              uint64_t max_instructions, double timeout: the limits of 
+ *                                                         this run, or 0
+ *  Returns: why the program stopped
+ *  Effects: Runs the program with run(), one interval at a time, so the
+ *           checkpoints fall on block boundaries; the limits apply to the
+ *           whole run rather than to each interval
+ ***********************************************************************/
+static executionStatus runCheckpointed(executionContext context,
+                                       checkpointLog log, uint64_t interval,
+                                       uint64_t max_instructions,
+                                       double timeout)
+{
+        uint64_t start = contextInstructions(context);
+        uint64_t limit = max_instructions == 0 || 
+                         max_instructions > UINT64_MAX - start ? 
+                         UINT64_MAX : start + max_instructions;
+        double deadline = clockNow(CLOCK_MONOTONIC) + timeout;
+
+        for (;;) {
+                uint64_t done = contextInstructions(context);
+                setInstructionBudget(context, limit - done < interval ? 
+                                              limit - done : interval);
+                if (timeout > 0) {
+                        double left = deadline - clockNow(CLOCK_MONOTONIC);
+                        setTimeout(context, left > 0 ? left : 1e-9);
+                }
+                executionStatus status = run(context);
+                if (status != EXECUTION_INSTRUCTION_LIMIT ||
+                    contextInstructions(context) >= limit) {
+                        return status;
+                }
+                writeCheckpoint(log, context);
+        }
+}
+
+/* How each run of --batch is configured */
+typedef struct batchSettings {
+        uint64_t max_instructions;
+        double timeout;
+        uint64_t max_memory;
+        executionEngine engine;
+        const char *code_cache;
+        bool extensions;
+        uint64_t compress_cold;
+} batchSettings;
+
+/***************************** runOutside() *****************************
+ *  Purpose: Finishes a --batch run that left lockstep, in a child process
+ *           so that a failure does not end the other runs
+ *  Parameters: executionContext context: the run, ready for run()
+ *              FILE *input, *output: the streams of the run
+ *              const char *name: the input file, for reports
+ *  Returns: the exit status the run would have had on its own
+ *  Effects: The child writes through stdout, which is flushed even when
+ *           a failure aborts it
+ ***********************************************************************/
+static int runOutside(executionContext context, FILE *input, FILE *output,
+                      const char *name)
 {
-        /* check for proper number of command line arguments */
-        if (argc != 2) {
-                fprintf(stderr, "Usage: ./um [UM binary filename]\n");
+        fflush(NULL);
+        pid_t child = fork();
+        if (child == -1) {
+                perror("um: fork");
                 exit(EXIT_FAILURE);
         }
+        if (child == 0) {
+                if (dup2(fileno(output), STDOUT_FILENO) == -1) {
+                        perror("um: dup2");
+                        _exit(EXIT_FAILURE);
+                }
+                setStreams(context, input, stdout);
+                executionStatus status = run(context);
+                if (status != EXECUTION_HALTED) {
+                        fprintf(stderr, "um: %s\n", name);
+                        reportStop(context, status);
+                }
+                fflush(NULL);
+                _exit(status == EXECUTION_HALTED ? EXIT_SUCCESS 
+                                                 : LIMIT_EXIT_STATUS);
+        }
+
+        int status;
+        if (waitpid(child, &status, 0) == -1 || !WIFEXITED(status)) {
+                fprintf(stderr, "um: %s: failed\n", name);
+                return EXIT_FAILURE;
+        }
+        return WEXITSTATUS(status);
+}
+
+/****************************** runBatch() ******************************
+ *  Purpose: Runs one program once for each input file, for --batch
+ *  Parameters: Segment image: the program; every run gets a copy
+ *              char **inputs: the input files
+ *              int count: the number of inputs
+ *              const char *directory: where the output of input DIR/X 
+ *                                     goes, as directory/X.out
+ *              batchSettings settings: limits and engine of each run
+ *  Returns: the worst exit status of the runs: EXIT_SUCCESS if they all
+ *           halted, then LIMIT_EXIT_STATUS, then EXIT_FAILURE
+ *  Effects: Runs the inputs LOCKSTEP_LANES at a time with runLockstep();
+ *           runs that leave lockstep finish one by one with runOutside()
+ ***********************************************************************/
+static int runBatch(Segment image, char **inputs, int count,
+                    const char *directory, batchSettings settings)
+{
+        int worst = EXIT_SUCCESS;
+        for (int first = 0; first < count; first += LOCKSTEP_LANES) {
+                int lanes = count - first < LOCKSTEP_LANES ? 
+                            count - first : LOCKSTEP_LANES;
+                executionContext contexts[LOCKSTEP_LANES];
+                FILE *input[LOCKSTEP_LANES], *output[LOCKSTEP_LANES];
+
+                for (int l = 0; l < lanes; l++) {
+                        const char *name = inputs[first + l];
+                        const char *base = strrchr(name, '/');
+                        base = base == NULL ? name : base + 1;
+                        size_t size = strlen(directory) + strlen(base) + 6;
+                        char *path = malloc(size);
+                        assert(path != NULL);
+                        snprintf(path, size, "%s/%s.out", directory, base);
+                        input[l] = fopen(name, "rb");
+                        output[l] = fopen(path, "wb");
+                        if (input[l] == NULL || output[l] == NULL) {
+                                perror(input[l] == NULL ? name : path);
+                                exit(EXIT_FAILURE);
+                        }
+                        free(path);
+
+                        Segment segment_0 = newCodeSegment(image->length);
+                        memcpy(segment_0->words, image->words, 
+                               (size_t) image->length * WORD_SIZE);
+                        contexts[l] = newContext(segment_0);
+                        setInstructionBudget(contexts[l], 
+                                             settings.max_instructions);
+                        setTimeout(contexts[l], settings.timeout);
+                        setMemoryLimit(contexts[l], settings.max_memory);
+                        setEngine(contexts[l], settings.engine);
+                        setStreams(contexts[l], input[l], output[l]);
+                        setExtensions(contexts[l], settings.extensions);
+                        if (settings.compress_cold != 0) {
+                                setColdCompression(contexts[l], 
+                                                   settings.compress_cold);
+                        }
+                        if (settings.code_cache != NULL) {
+                                setCodeCache(contexts[l], settings.code_cache);
+                        }
+                }
+
+                runLockstep(contexts, lanes);
+
+                for (int l = 0; l < lanes; l++) {
+                        const char *name = inputs[first + l];
+                        executionStatus status = contextStatus(contexts[l]);
+                        int result = EXIT_SUCCESS;
+                        if (status == EXECUTION_RUNNING) {
+                                result = runOutside(contexts[l], input[l],
+                                                    output[l], name);
+                        } else if (status != EXECUTION_HALTED) {
+                                fprintf(stderr, "um: %s\n", name);
+                                reportStop(contexts[l], status);
+                                result = LIMIT_EXIT_STATUS;
+                        }
+                        if (result == EXIT_FAILURE || 
+                            (result != EXIT_SUCCESS && 
+                             worst == EXIT_SUCCESS)) {
+                                worst = result;
+                        }
+                        fclose(input[l]);
+                        fclose(output[l]);
+                        freeContext(&contexts[l]);
+                }
+        }
+        return worst;
+}
+
+int main(int argc, char *argv[])
+{
+        char *filename = NULL;
+        uint64_t max_instructions = 0;
+        double timeout = 0;
+        uint64_t max_memory = 0;
+        executionEngine engine = ENGINE_THREADED;
+        bool profile = false;
+        bool flight_recorder = false;
+        char *batch_directory = NULL;
+        char *code_cache = NULL;
+        bool extensions = false;
+        uint64_t compress_cold = 0;
+        char *checkpoint_path = NULL;
+        uint64_t checkpoint_every = 0;
+        bool checkpoint_fork = false;
+        bool live_stats = false;
+        char *stats_path = NULL;
+        statsFormat stats_format = STATS_JSON;
+        bool stats_format_given = false;
+        bool perf_counters = false;
+        char *heatmap_path = NULL;
+        bool latency = false;
+        char **inputs = malloc(argc * sizeof(char *));
+        int input_count = 0;
+        assert(inputs != NULL);
+
+        /* phase timings of --stats-file count from here */
+        double started = clockNow(CLOCK_MONOTONIC);
+
+        /* the flight recorder's handlers go first, so that those of the
+        guard pages fall back to them */
+        startFlightRecorder(FLIGHT_DEFAULT_ENTRIES);
+
+        /* check for proper command line arguments */
+        for (int i = 1; i < argc; i++) {
+                char *end;
+                if (strcmp(argv[i], "--max-instructions") == 0 &&
+                    i + 1 < argc) {
+                        max_instructions = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || argv[i][0] == '-') {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+                        timeout = strtod(argv[++i], &end);
+                        if (*end != '\0' || timeout < 0) {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--max-memory") == 0 &&
+                           i + 1 < argc) {
+                        unsigned long long mib = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || mib == 0 || argv[i][0] == '-' ||
+                            mib > UINT64_MAX >> 20) {
+                                usage();
+                        }
+                        max_memory = mib << 20;
+                } else if (strcmp(argv[i], "--guard-pages") == 0) {
+                        useGuardPages();
+                } else if (strcmp(argv[i], "--smc-barrier") == 0) {
+                        useWriteBarrier();
+                } else if (strcmp(argv[i], "--guard-span") == 0 &&
+                           i + 1 < argc) {
+                        unsigned long kib = strtoul(argv[++i], &end, 10);
+                        if (*end != '\0' || kib == 0) {
+                                usage();
+                        }
+                        guardSetSpan((size_t) kib * 1024);
+                } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "threaded") == 0) {
+                                engine = ENGINE_THREADED;
+                        } else if (strcmp(argv[i], "specialized") == 0) {
+                                engine = ENGINE_SPECIALIZED;
+                        } else {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--profile") == 0) {
+                        profile = true;
+                } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                        batch_directory = argv[++i];
+                } else if (strcmp(argv[i], "--code-cache") == 0 &&
+                           i + 1 < argc) {
+                        code_cache = argv[++i];
+                } else if (strcmp(argv[i], "--ext") == 0) {
+                        extensions = true;
+                } else if (strcmp(argv[i], "--compress-cold") == 0 &&
+                           i + 1 < argc) {
+                        compress_cold = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || compress_cold == 0 || 
+                            argv[i][0] == '-') {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--checkpoint") == 0 &&
+                           i + 1 < argc) {
+                        checkpoint_path = argv[++i];
+                } else if (strcmp(argv[i], "--checkpoint-every") == 0 &&
+                           i + 1 < argc) {
+                        checkpoint_every = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || checkpoint_every == 0 || 
+                            argv[i][0] == '-') {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--flight-recorder") == 0 &&
+                           i + 1 < argc) {
+                        unsigned long entries = strtoul(argv[++i], &end, 10);
+                        if (*end != '\0' || argv[i][0] == '-' ||
+                            entries > 1ul << 24) {
+                                usage();
+                        }
+                        startFlightRecorder(entries);
+                        flight_recorder = true;
+                } else if (strcmp(argv[i], "--live-stats") == 0) {
+                        live_stats = true;
+                } else if (strcmp(argv[i], "--stats-file") == 0 &&
+                           i + 1 < argc) {
+                        stats_path = argv[++i];
+                } else if (strcmp(argv[i], "--stats-format") == 0 &&
+                           i + 1 < argc) {
+                        i++;
+                        stats_format_given = true;
+                        if (strcmp(argv[i], "json") == 0) {
+                                stats_format = STATS_JSON;
+                        } else if (strcmp(argv[i], "prometheus") == 0) {
+                                stats_format = STATS_PROMETHEUS;
+                        } else {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--heatmap") == 0 &&
+                           i + 1 < argc) {
+                        heatmap_path = argv[++i];
+                } else if (strcmp(argv[i], "--latency") == 0) {
+                        latency = true;
+                } else if (strcmp(argv[i], "--perf-counters") == 0) {
+                        perf_counters = true;
+                } else if (strcmp(argv[i], "--checkpoint-fork") == 0) {
+                        checkpoint_fork = true;
+                } else if (argv[i][0] == '-') {
+                        usage();
+                } else if (filename == NULL) {
+                        filename = argv[i];
+                } else {
+                        inputs[input_count++] = argv[i];
+                }
+        }
+        if (filename == NULL || 
+            (batch_directory == NULL) != (input_count == 0) ||
+            (checkpoint_path == NULL) != (checkpoint_every == 0) ||
+            (checkpoint_path != NULL && batch_directory != NULL) ||
+            (checkpoint_fork && checkpoint_path == NULL) ||
+            (live_stats && batch_directory != NULL) ||
+            (stats_path != NULL && batch_directory != NULL) ||
+            (stats_format_given && stats_path == NULL) ||
+            (perf_counters && batch_directory != NULL) ||
+            (heatmap_path != NULL && batch_directory != NULL) ||
+            (latency && batch_directory != NULL) ||
+            (profile && batch_directory != NULL) ||
+            (flight_recorder && batch_directory != NULL)) {
+                usage();
+        }
 
         /* check that the file exists  */
         struct stat file;
-        if (stat(argv[1], &file) == -1) {
+        if (stat(filename, &file) == -1) {
                 fprintf(stderr, "No such file or directory\n");
                 exit(EXIT_FAILURE);
         }
 
+        /* with --perf-counters, loading is measured on its own */
+        perfCounters perf = NULL;
+        if (perf_counters) {
+                perf = openPerfCounters();
+                startPerfPhase(perf);
+        }
+
         /* using file size, compute number of instructions */
         int program_size = file.st_size / WORD_SIZE;
 
         /* create a segment big enough to hold all instructions */
-        Seq_T segment_0 = Seq_new(program_size);
-        
+        Segment segment_0 = newCodeSegment(program_size);
+
         /* load program instructions into segment-0 */
-        loadProgramInstructions(argv[1], segment_0, program_size);
+        loadProgramInstructions(filename, segment_0, program_size);
+        if (perf != NULL) {
+                endPerfPhase(perf, "load", 0);
+        }
+
+        /* or run a copy of it on each input */
+        if (batch_directory != NULL) {
+                batchSettings settings = { max_instructions, timeout, 
+                                           max_memory, engine, code_cache, 
+                                           extensions, compress_cold };
+                int result = runBatch(segment_0, inputs, input_count, 
+                                      batch_directory, settings);
+                freeSegment(&segment_0);
+                free(inputs);
+                return result;
+        }
+        free(inputs);
 
-        /* execute each instruction */
-        execute(segment_0);
+        /* execute each instruction, from the last checkpoint if there is
+        one */
+        checkpointLog log = NULL;
+        executionContext context;
+        if (checkpoint_path != NULL) {
+                log = openCheckpointLog(checkpoint_path, segment_0);
+                if (checkpoint_fork) {
+                        forkCheckpoints(log);
+                }
+                context = resumeFromCheckpoint(log, segment_0, stdin);
+        } else {
+                context = newContext(segment_0);
+        }
+        setInstructionBudget(context, max_instructions);
+        setTimeout(context, timeout);
+        setMemoryLimit(context, max_memory);
+        setEngine(context, engine);
+        setExtensions(context, extensions);
+        if (compress_cold != 0) {
+                setColdCompression(context, compress_cold);
+        }
+        if (code_cache != NULL) {
+                setCodeCache(context, code_cache);
+        }
+        liveStats live = NULL;
+        if (live_stats) {
+                live = openLiveStats(filename);
+                setLiveStats(context, live);
+        }
+        runStats stats = NULL;
+        if (stats_path != NULL) {
+                stats = openRunStats(stats_path, stats_format, filename,
+                                     engine, started);
+                watchRunStats(stats, context);
+        }
+        heatMap heat = NULL;
+        if (heatmap_path != NULL) {
+                heat = newHeatMap();
+                setHeatMap(context, heat);
+        }
+        latencyTracker tracker = NULL;
+        if (latency) {
+                tracker = newLatencyTracker();
+                setLatencyTracker(context, tracker);
+        }
+        uint64_t resumed_at = contextInstructions(context);
+        if (perf != NULL) {
+                startPerfPhase(perf);
+        }
+        executionStatus status;
+        if (log != NULL) {
+                status = runCheckpointed(context, log, checkpoint_every,
+                                         max_instructions, timeout);
+                if (profile) {
+                        reportCheckpoints(log);
+                }
+                closeCheckpointLog(&log);
+        } else {
+                status = run(context);
+        }
+        if (perf != NULL) {
+                endPerfPhase(perf, "execute", 
+                             contextInstructions(context) - resumed_at);
+                closePerfCounters(&perf);
+        }
+        if (status != EXECUTION_HALTED) {
+                reportStop(context, status);
+        }
+        if (profile) {
+                reportProfile(context);
+        }
+        if (profile || max_memory != 0 || compress_cold != 0) {
+                reportMemory(context);
+        }
+        if (tracker != NULL) {
+                reportLatency(tracker);
+        }
+        if (stats != NULL) {
+                writeRunStats(stats, context);
+                closeRunStats(&stats);
+        }
+        if (heat != NULL) {
+                writeHeatMap(heat, heatmap_path);
+        }
+        freeContext(&context);
+        if (heat != NULL) {
+                freeHeatMap(&heat);
+        }
+        if (tracker != NULL) {
+                freeLatencyTracker(&tracker);
+        }
+        if (live != NULL) {
+                closeLiveStats(&live);
+        }
 
-        return EXIT_SUCCESS;
-}
\ No newline at end of file
+        return status == EXECUTION_HALTED ? EXIT_SUCCESS : LIMIT_EXIT_STATUS;
+}
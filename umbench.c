@@ -0,0 +1,284 @@
+/******************************************************************************
+ *
+ *                              umbench.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains umbench, which times the UM one operation at a
+ *    time: for each kernel of umlab.c (a loop of one operation: CMOV
+ *    taken and not taken, ADD, MULT, DIV, NAND, SEG_LOAD, SEG_STORE, MAP
+ *    and UNMAP of three sizes, near and far LOAD_PROGRAMs, OUTPUT) and
+ *    each engine, it reports the nanoseconds one operation takes.
+ *
+ *    A kernel runs in this process, on the executor um uses, so that only
+ *    execution is timed. Its iterations are doubled until one run takes
+ *    the time asked for; the kernel and its baseline, the same loop
+ *    without the operation, then run that many iterations, the best of
+ *    several runs of each is kept, and the difference between the two,
+ *    divided by the operations run, is the time of one operation with
+ *    the loop's overhead taken out. OUTPUT writes to /dev/null.
+ *
+ *    Usage: umbench [--engine threaded|specialized] [--unroll N]
+ *                   [--repeat N] [--time SECONDS] [KERNEL...]
+ *           umbench --list
+ *
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "executor.h"
+#include "memory.h"
+#include "timing.h"
+
+typedef uint32_t (*kernelGenerator)(FILE *image, uint32_t iterations,
+                                    uint32_t unroll, bool baseline);
+
+extern uint32_t kernel_cmov_taken(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_cmov_not_taken(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_add(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_mult(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_div(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_nand(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_sload(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_sstore(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_map_1(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_map_64(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_map_4096(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_jump_near(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_jump_far(FILE *, uint32_t, uint32_t, bool);
+extern uint32_t kernel_output(FILE *, uint32_t, uint32_t, bool);
+
+static struct kernel {
+        const char *name;
+        const char *operation;
+        kernelGenerator generate;
+} kernels[] = {
+        { "cmov-taken", "CMOV that moves", kernel_cmov_taken },
+        { "cmov-not-taken", "CMOV that does not", kernel_cmov_not_taken },
+        { "add", "ADD", kernel_add },
+        { "mult", "MULT", kernel_mult },
+        { "div", "DIV", kernel_div },
+        { "nand", "NAND", kernel_nand },
+        { "sload", "SEG_LOAD", kernel_sload },
+        { "sstore", "SEG_STORE", kernel_sstore },
+        { "map-1", "MAP + UNMAP, 1 word", kernel_map_1 },
+        { "map-64", "MAP + UNMAP, 64 words", kernel_map_64 },
+        { "map-4096", "MAP + UNMAP, 4096 words", kernel_map_4096 },
+        { "jump-near", "LOAD_PROGRAM 1 word on", kernel_jump_near },
+        { "jump-far", "LOAD_PROGRAM 4 KiB on", kernel_jump_far },
+        { "output", "OUTPUT", kernel_output }
+};
+
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/* How each kernel is measured */
+typedef struct benchSettings {
+        uint32_t unroll;
+        int repeat;
+        double time;
+        FILE *sink;
+} benchSettings;
+
+/**************************** usage() ****************************
+ *  Purpose: Prints how to invoke umbench and exits with failure
+ ***********************************************************************/
+static void usage(void)
+{
+        fprintf(stderr, "Usage: ./umbench [--engine threaded|specialized] "
+                        "[--unroll N] [--repeat N] [--time SECONDS] "
+                        "[KERNEL...]\n"
+                        "       ./umbench --list\n");
+        exit(EXIT_FAILURE);
+}
+
+/***************************** kernelImage() *****************************
+ *  Purpose: Generates a kernel as segment 0 of a program
+ *  Parameters: const struct kernel *kernel: the kernel
+ *              uint32_t iterations, uint32_t unroll: its size
+ *              bool baseline: whether to leave its operation out
+ *  Returns: the segment, for newContext
+ ***********************************************************************/
+static Segment kernelImage(const struct kernel *kernel, uint32_t iterations,
+                           uint32_t unroll, bool baseline)
+{
+        char *bytes;
+        size_t size;
+        FILE *image = open_memstream(&bytes, &size);
+        assert(image != NULL);
+        uint32_t length = kernel->generate(image, iterations, unroll,
+                                           baseline);
+        fclose(image);
+        assert(size == (size_t) length * 4);
+
+        Segment segment_0 = newCodeSegment(length);
+        const unsigned char *word = (const unsigned char *) bytes;
+        for (uint32_t i = 0; i < length; i++, word += 4) {
+                setWord(segment_0, i, (uint32_t) word[0] << 24 |
+                                      (uint32_t) word[1] << 16 |
+                                      (uint32_t) word[2] << 8 | word[3]);
+        }
+        free(bytes);
+        return segment_0;
+}
+
+/****************************** timeKernel() ******************************
+ *  Purpose: Runs a kernel once
+ *  Parameters: const struct kernel *kernel: the kernel
+ *              executionEngine engine: the engine to run it on
+ *              uint32_t iterations: its iterations
+ *              bool baseline: whether to leave its operation out
+ *              benchSettings settings: its unroll and output
+ *  Returns: the seconds run() took
+ ***********************************************************************/
+static double timeKernel(const struct kernel *kernel, executionEngine engine,
+                         uint32_t iterations, bool baseline,
+                         benchSettings settings)
+{
+        executionContext context = newContext(kernelImage(kernel,
+                                                          iterations,
+                                                          settings.unroll,
+                                                          baseline));
+        setEngine(context, engine);
+        setStreams(context, stdin, settings.sink);
+        double start = clockNow(CLOCK_MONOTONIC);
+        executionStatus status = run(context);
+        double seconds = clockNow(CLOCK_MONOTONIC) - start;
+        assert(status == EXECUTION_HALTED);
+        freeContext(&context);
+        return seconds;
+}
+
+/**************************** measureKernel() ****************************
+ *  Purpose: Finds the time of one operation of a kernel on an engine
+ *  Parameters: const struct kernel *kernel: the kernel
+ *              executionEngine engine: the engine
+ *              benchSettings settings: how to measure
+ *  Returns: the nanoseconds of one operation, loop overhead taken out
+ ***********************************************************************/
+static double measureKernel(const struct kernel *kernel,
+                            executionEngine engine, benchSettings settings)
+{
+        uint32_t iterations = 16;
+        while (iterations < UINT32_MAX / 2 &&
+               timeKernel(kernel, engine, iterations, false, settings) <
+               settings.time) {
+                iterations *= 2;
+        }
+
+        double best = 0, best_baseline = 0;
+        for (int i = 0; i < settings.repeat; i++) {
+                double seconds = timeKernel(kernel, engine, iterations, false,
+                                            settings);
+                double baseline = timeKernel(kernel, engine, iterations, true,
+                                             settings);
+                if (i == 0 || seconds < best) {
+                        best = seconds;
+                }
+                if (i == 0 || baseline < best_baseline) {
+                        best_baseline = baseline;
+                }
+        }
+        return (best - best_baseline) * 1e9 /
+               ((double) iterations * settings.unroll);
+}
+
+/****************************** parseCount() ******************************
+ *  Purpose: Reads a count given on the command line
+ *  Parameters: const char *text: the argument
+ *  Returns: the count, at least 1; exits through usage() if it is not one
+ ***********************************************************************/
+static uint32_t parseCount(const char *text)
+{
+        char *end;
+        unsigned long long count = strtoull(text, &end, 10);
+        if (*text == '\0' || *end != '\0' || count < 1 || count > 4096) {
+                usage();
+        }
+        return (uint32_t) count;
+}
+
+int main(int argc, char *argv[])
+{
+        benchSettings settings = { 64, 5, 0.05, NULL };
+        bool engines[2] = { true, true };
+        bool chosen[NKERNELS] = { false };
+        bool any_chosen = false;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--list") == 0) {
+                        for (unsigned k = 0; k < NKERNELS; k++) {
+                                printf("%-16s %s\n", kernels[k].name,
+                                       kernels[k].operation);
+                        }
+                        return EXIT_SUCCESS;
+                } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+                        i++;
+                        engines[ENGINE_THREADED] =
+                                strcmp(argv[i], "threaded") == 0;
+                        engines[ENGINE_SPECIALIZED] =
+                                strcmp(argv[i], "specialized") == 0;
+                        if (!engines[0] && !engines[1]) {
+                                usage();
+                        }
+                } else if (strcmp(argv[i], "--unroll") == 0 && i + 1 < argc) {
+                        settings.unroll = parseCount(argv[++i]);
+                } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+                        settings.repeat = parseCount(argv[++i]);
+                } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+                        char *end;
+                        settings.time = strtod(argv[++i], &end);
+                        if (*end != '\0' || !(settings.time > 0)) {
+                                usage();
+                        }
+                } else {
+                        unsigned k = 0;
+                        while (k < NKERNELS &&
+                               strcmp(argv[i], kernels[k].name) != 0) {
+                                k++;
+                        }
+                        if (k == NKERNELS) {
+                                fprintf(stderr, "umbench: no kernel named "
+                                                "%s (see --list)\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                        chosen[k] = true;
+                        any_chosen = true;
+                }
+        }
+
+        settings.sink = fopen("/dev/null", "w");
+        assert(settings.sink != NULL);
+        printf("ns per operation, loop overhead taken out (unroll %u, best "
+               "of %d, runs of %g s or more)\n", settings.unroll,
+               settings.repeat, settings.time);
+        printf("%-16s %-24s", "kernel", "operation");
+        for (int e = ENGINE_THREADED; e <= ENGINE_SPECIALIZED; e++) {
+                if (engines[e]) {
+                        printf(" %11s", engineName(e));
+                }
+        }
+        printf("\n");
+        for (unsigned k = 0; k < NKERNELS; k++) {
+                if (any_chosen && !chosen[k]) {
+                        continue;
+                }
+                printf("%-16s %-24s", kernels[k].name, kernels[k].operation);
+                fflush(stdout);
+                for (int e = ENGINE_THREADED; e <= ENGINE_SPECIALIZED; e++) {
+                        if (engines[e]) {
+                                printf(" %11.2f", measureKernel(&kernels[k],
+                                                                e, settings));
+                                fflush(stdout);
+                        }
+                }
+                printf("\n");
+        }
+        fclose(settings.sink);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,546 @@
+/******************************************************************************
+ *
+ *                              umdis.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains umdis, a static disassembler for Universal Machine
+ *    images (.um and .umz). It decodes segment 0, reconstructs its basic
+ *    blocks and control flow graph, and tells code apart from data.
+ *
+ *    Jumps in the UM are all LOAD_PROGRAM instructions, so their targets
+ *    are found by propagating register values from the entry point: each
+ *    register holds either a small set of known constants (up to
+ *    MAX_VALUES, enough for the CMOV that selects between two targets of
+ *    a conditional branch) or is unknown. LOAD_PROGRAM with $r[B] known
+ *    to be 0 then jumps to each value $r[C] may hold. Words never reached
+ *    this way are reported as data. The analysis reads the image as it is
+ *    on disk, so code written into segment 0 at run time (as .umz
+ *    decompressors do) shows up as data. Every range of words printed,
+ *    in each format, is half open: it starts at its first word and ends
+ *    just before its end, written [start, end) in the listing and graph.
+ *
+ *    Usage: umdis [--json | --dot] [UM binary filename]
+ *
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "fetcher.h"
+#include "isa.h"
+#include "memory.h"
+
+#define MAX_VALUES 4
+#define UNKNOWN -1
+
+/* The values a register may hold: count is UNKNOWN, or 0 when nothing
+   reaches it yet, or the number of known values */
+typedef struct valueSet {
+        int count;
+        uint32_t values[MAX_VALUES];
+} valueSet;
+
+typedef struct abstractState {
+        valueSet r[8];
+} abstractState;
+
+/* What ends a block, and where it may go next */
+typedef struct blockExit {
+        const char *terminator;
+        uint32_t targets[MAX_VALUES];
+        int target_count;
+        bool indirect;
+        bool loads_program;
+        bool falls_through;
+} blockExit;
+
+/* Everything known about the image being analysed */
+typedef struct analysis {
+        Segment image;
+        uint32_t length;
+        bool *leader;
+        bool *reached;
+        abstractState **entry;
+        uint32_t *worklist;
+        bool *queued;
+        uint32_t pending;
+} analysis;
+
+/**************************** addValue() ****************************
+ *  Purpose: Adds a value to a set, which becomes UNKNOWN when it
+ *           would grow past MAX_VALUES
+ *  Parameters: valueSet *set: the set to grow
+ *              uint32_t value: the value to add
+ *  Returns: None
+ ***********************************************************************/
+static void addValue(valueSet *set, uint32_t value)
+{
+        if (set->count == UNKNOWN) {
+                return;
+        }
+        for (int i = 0; i < set->count; i++) {
+                if (set->values[i] == value) {
+                        return;
+                }
+        }
+        if (set->count == MAX_VALUES) {
+                set->count = UNKNOWN;
+        } else {
+                set->values[set->count++] = value;
+        }
+}
+
+/**************************** joinValues() ****************************
+ *  Purpose: Merges the values of one set into another
+ *  Parameters: valueSet *into: the set that grows
+ *              const valueSet *from: the set merged into it
+ *  Returns: true if into changed
+ ***********************************************************************/
+static bool joinValues(valueSet *into, const valueSet *from)
+{
+        valueSet before = *into;
+        if (from->count == UNKNOWN) {
+                into->count = UNKNOWN;
+        }
+        for (int i = 0; i < from->count; i++) {
+                addValue(into, from->values[i]);
+        }
+        return into->count != before.count;
+}
+
+/**************************** known() ****************************
+ *  Purpose: Makes a set holding exactly one value
+ ***********************************************************************/
+static valueSet known(uint32_t value)
+{
+        valueSet set = { .count = 1 };
+        set.values[0] = value;
+        return set;
+}
+
+static valueSet unknown(void)
+{
+        valueSet set = { .count = UNKNOWN };
+        return set;
+}
+
+/************************** combineValues() **************************
+ *  Purpose: Applies an arithmetic instruction to every pair of values two
+ *           registers may hold
+ *  Parameters: Um_opcode opcode: ADD, MULT, DIV or NAND
+ *              valueSet b, c: the operands
+ *  Returns: the set of results, UNKNOWN if an operand is unknown or the
+ *           results are too many
+ ***********************************************************************/
+static valueSet combineValues(Um_opcode opcode, valueSet b, valueSet c)
+{
+        if (b.count <= 0 || c.count <= 0) {
+                return unknown();
+        }
+        valueSet result = { .count = 0 };
+        for (int i = 0; i < b.count; i++) {
+                for (int j = 0; j < c.count; j++) {
+                        uint32_t x = b.values[i], y = c.values[j];
+                        switch (opcode) {
+                                case ADD: addValue(&result, x + y); break;
+                                case MULT: addValue(&result, x * y); break;
+                                case NAND: addValue(&result, ~(x & y)); break;
+                                default:
+                                /* a division by 0 never completes */
+                                if (y != 0) {
+                                        addValue(&result, x / y);
+                                }
+                        }
+                }
+        }
+        return result.count == 0 ? unknown() : result;
+}
+
+/***************************** execute() *****************************
+ *  Purpose: Applies one instruction to an abstract state
+ *  Parameters: uint32_t word: the instruction
+ *              abstractState *state: the state before, updated in place
+ *              blockExit *exit: filled in if the instruction ends a block
+ *  Returns: true if the instruction ends its block
+ ***********************************************************************/
+static bool execute(uint32_t word, abstractState *state, blockExit *exit)
+{
+        unsigned opcode = Um_opcodeOf(word);
+        unsigned a = Um_ra(word), b = Um_rb(word), c = Um_rc(word);
+        valueSet *r = state->r;
+        memset(exit, 0, sizeof(*exit));
+
+        switch (opcode) {
+                case COND_MOV:
+                if (r[c].count == UNKNOWN) {
+                        joinValues(&r[a], &r[b]);
+                } else {
+                        bool zero = false, nonzero = false;
+                        for (int i = 0; i < r[c].count; i++) {
+                                zero |= r[c].values[i] == 0;
+                                nonzero |= r[c].values[i] != 0;
+                        }
+                        if (nonzero && !zero) {
+                                r[a] = r[b];
+                        } else if (nonzero) {
+                                joinValues(&r[a], &r[b]);
+                        }
+                }
+                return false;
+
+                case SEG_LOAD:
+                r[a] = unknown();
+                return false;
+
+                case ADD: case MULT: case DIV: case NAND:
+                r[a] = combineValues(opcode, r[b], r[c]);
+                return false;
+
+                case MAP:
+                r[b] = unknown();
+                return false;
+
+                case INPUT:
+                r[c] = unknown();
+                return false;
+
+                case LOAD_VAL:
+                r[Um_lvRegister(word)] = known(Um_lvValue(word));
+                return false;
+
+                case SEG_STORE: case UNMAP: case OUTPUT: case HCALL:
+                case RESIZE:
+                return false;
+
+                case HALT:
+                exit->terminator = "halt";
+                return true;
+
+                case LOAD_PROGRAM:
+                exit->terminator = "loadp";
+                if (r[b].count == UNKNOWN) {
+                        exit->loads_program = true;
+                        exit->indirect = true;
+                        return true;
+                }
+                bool local = false;
+                for (int i = 0; i < r[b].count; i++) {
+                        local |= r[b].values[i] == 0;
+                        exit->loads_program |= r[b].values[i] != 0;
+                }
+                if (local && r[c].count == UNKNOWN) {
+                        exit->indirect = true;
+                } else if (local) {
+                        exit->target_count = r[c].count;
+                        memcpy(exit->targets, r[c].values,
+                               sizeof(uint32_t) * r[c].count);
+                }
+                return true;
+
+                default:
+                exit->terminator = "invalid";
+                return true;
+        }
+}
+
+/**************************** enqueue() ****************************
+ *  Purpose: Schedules a leader to be (re)analysed
+ ***********************************************************************/
+static void enqueue(analysis *program, uint32_t pc)
+{
+        if (!program->queued[pc]) {
+                program->queued[pc] = true;
+                program->worklist[program->pending++] = pc;
+        }
+}
+
+/**************************** flowInto() ****************************
+ *  Purpose: Merges the state at the end of a block into the entry state
+ *           of a block it may continue into
+ *  Parameters: analysis *program: the analysis
+ *              uint32_t target: first word of the next block
+ *              const abstractState *state: the state flowing in
+ *  Returns: None
+ *  Effects: Makes target a leader if it was not one. A new leader inside
+ *           a block that was already analysed splits it, so every leader
+ *           is analysed again to let its state flow into the new one.
+ ***********************************************************************/
+static void flowInto(analysis *program, uint32_t target,
+                     const abstractState *state)
+{
+        if (target >= program->length) {
+                return;
+        }
+        if (!program->leader[target]) {
+                program->leader[target] = true;
+                program->entry[target] = calloc(1, sizeof(abstractState));
+                assert(program->entry[target] != NULL);
+                if (program->reached[target]) {
+                        for (uint32_t pc = 0; pc < program->length; pc++) {
+                                if (program->leader[pc] && pc != target) {
+                                        enqueue(program, pc);
+                                }
+                        }
+                }
+        }
+        bool changed = program->entry[target]->r[0].count == 0;
+        for (int i = 0; i < 8; i++) {
+                changed |= joinValues(&program->entry[target]->r[i],
+                                      &state->r[i]);
+        }
+        if (changed) {
+                enqueue(program, target);
+        }
+}
+
+/*************************** analyseBlock() ***************************
+ *  Purpose: Runs a block from its entry state, passing the resulting
+ *           state to its successors
+ *  Parameters: analysis *program: the analysis
+ *              uint32_t start: the leader of the block
+ *              blockExit *exit: filled in with how the block ends
+ *  Returns: one past the last word of the block
+ ***********************************************************************/
+static uint32_t analyseBlock(analysis *program, uint32_t start,
+                             blockExit *exit)
+{
+        abstractState state = *program->entry[start];
+        uint32_t pc = start;
+        while (pc < program->length) {
+                if (pc != start && program->leader[pc]) {
+                        memset(exit, 0, sizeof(*exit));
+                        exit->terminator = "fallthrough";
+                        exit->falls_through = true;
+                        flowInto(program, pc, &state);
+                        return pc;
+                }
+                program->reached[pc] = true;
+                if (execute(program->image->words[pc], &state, exit)) {
+                        for (int i = 0; i < exit->target_count; i++) {
+                                flowInto(program, exit->targets[i], &state);
+                        }
+                        return pc + 1;
+                }
+                pc++;
+        }
+        memset(exit, 0, sizeof(*exit));
+        exit->terminator = "end";
+        return pc;
+}
+
+/**************************** analyse() ****************************
+ *  Purpose: Propagates register values from the entry point until no
+ *           entry state changes
+ ***********************************************************************/
+static void analyse(analysis *program)
+{
+        abstractState start;
+        for (int i = 0; i < 8; i++) {
+                start.r[i] = known(0);
+        }
+        flowInto(program, 0, &start);
+
+        blockExit exit;
+        while (program->pending > 0) {
+                uint32_t pc = program->worklist[--program->pending];
+                program->queued[pc] = false;
+                analyseBlock(program, pc, &exit);
+        }
+}
+
+/*************************** printListing() ***************************
+ *  Purpose: Prints every block with its instructions and successors,
+ *           followed by the code and data regions
+ ***********************************************************************/
+static void printListing(analysis *program)
+{
+        char text[64];
+        blockExit exit;
+        for (uint32_t pc = 0; pc < program->length; pc++) {
+                if (!program->leader[pc]) {
+                        continue;
+                }
+                uint32_t end = analyseBlock(program, pc, &exit);
+                printf("block [%u, %u) (%s):", pc, end, exit.terminator);
+                if (exit.falls_through) {
+                        printf(" %u", end);
+                }
+                for (int i = 0; i < exit.target_count; i++) {
+                        printf(" %u", exit.targets[i]);
+                }
+                printf("%s%s\n", exit.indirect ? " indirect" : "",
+                       exit.loads_program ? " loads-program" : "");
+                for (uint32_t i = pc; i < end; i++) {
+                        Um_disassemble(program->image->words[i], text,
+                                       sizeof(text));
+                        printf("  %8u: %08x  %s\n", i,
+                               program->image->words[i], text);
+                }
+        }
+        for (uint32_t pc = 0; pc < program->length; ) {
+                uint32_t end = pc;
+                while (end < program->length &&
+                       program->reached[end] == program->reached[pc]) {
+                        end++;
+                }
+                printf("%s [%u, %u)\n",
+                       program->reached[pc] ? "code" : "data", pc, end);
+                pc = end;
+        }
+}
+
+/**************************** printJson() ****************************
+ *  Purpose: Prints the blocks, edges and regions as a JSON document
+ ***********************************************************************/
+static void printJson(analysis *program, const char *filename)
+{
+        char text[64];
+        blockExit exit;
+        bool first = true;
+        printf("{\"file\": \"%s\", \"words\": %u, \"entry\": 0,\n"
+               " \"blocks\": [", filename, program->length);
+        for (uint32_t pc = 0; pc < program->length; pc++) {
+                if (!program->leader[pc]) {
+                        continue;
+                }
+                uint32_t end = analyseBlock(program, pc, &exit);
+                printf("%s\n  {\"start\": %u, \"end\": %u, "
+                       "\"terminator\": \"%s\", \"successors\": [",
+                       first ? "" : ",", pc, end, exit.terminator);
+                first = false;
+                if (exit.falls_through) {
+                        printf("%u", end);
+                }
+                for (int i = 0; i < exit.target_count; i++) {
+                        printf("%s%u", i > 0 ? ", " : "", exit.targets[i]);
+                }
+                printf("], \"indirect\": %s, \"loads_program\": %s,\n"
+                       "   \"instructions\": [",
+                       exit.indirect ? "true" : "false",
+                       exit.loads_program ? "true" : "false");
+                for (uint32_t i = pc; i < end; i++) {
+                        Um_disassemble(program->image->words[i], text,
+                                       sizeof(text));
+                        printf("%s[%u, %u, \"%s\"]", i > pc ? ", " : "", i,
+                               program->image->words[i], text);
+                }
+                printf("]}");
+        }
+        printf("],\n \"regions\": [");
+        for (uint32_t pc = 0; pc < program->length; ) {
+                uint32_t end = pc;
+                while (end < program->length &&
+                       program->reached[end] == program->reached[pc]) {
+                        end++;
+                }
+                printf("%s\n  {\"start\": %u, \"end\": %u, \"kind\": \"%s\"}",
+                       pc > 0 ? "," : "", pc, end,
+                       program->reached[pc] ? "code" : "data");
+                pc = end;
+        }
+        printf("]}\n");
+}
+
+/**************************** printDot() ****************************
+ *  Purpose: Prints the control flow graph in Graphviz DOT format; jumps
+ *           whose targets are unknown go to one node, indirect, declared
+ *           with the first of them
+ ***********************************************************************/
+static void printDot(analysis *program)
+{
+        blockExit exit;
+        bool indirect_declared = false;
+        printf("digraph umdis {\n"
+               "        node [shape=box, fontname=monospace];\n");
+        for (uint32_t pc = 0; pc < program->length; pc++) {
+                if (!program->leader[pc]) {
+                        continue;
+                }
+                uint32_t end = analyseBlock(program, pc, &exit);
+                printf("        b%u [label=\"[%u, %u)\\n%u instructions\\n"
+                       "%s\"];\n", pc, pc, end, end - pc, exit.terminator);
+                if (exit.falls_through) {
+                        printf("        b%u -> b%u;\n", pc, end);
+                }
+                for (int i = 0; i < exit.target_count; i++) {
+                        if (exit.targets[i] < program->length) {
+                                printf("        b%u -> b%u;\n", pc,
+                                       exit.targets[i]);
+                        }
+                }
+                if (exit.indirect && !indirect_declared) {
+                        printf("        indirect [label=\"indirect\\n"
+                               "(unknown targets)\", shape=ellipse, "
+                               "style=dashed];\n");
+                        indirect_declared = true;
+                }
+                if (exit.indirect) {
+                        printf("        b%u -> indirect [style=dashed];\n",
+                               pc);
+                }
+        }
+        printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+        enum { LISTING, JSON, DOT } format = LISTING;
+        char *filename = NULL;
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--json") == 0) {
+                        format = JSON;
+                } else if (strcmp(argv[i], "--dot") == 0) {
+                        format = DOT;
+                } else if (argv[i][0] != '-' && filename == NULL) {
+                        filename = argv[i];
+                } else {
+                        filename = NULL;
+                        break;
+                }
+        }
+        struct stat file;
+        if (filename == NULL || stat(filename, &file) == -1) {
+                fprintf(stderr, "Usage: ./umdis [--json | --dot] "
+                                "[UM binary filename]\n");
+                exit(EXIT_FAILURE);
+        }
+
+        analysis program;
+        program.length = file.st_size / 4;
+        program.image = newSegment(program.length);
+        loadProgramInstructions(filename, program.image, program.length);
+        program.leader = calloc(program.length + 1, sizeof(bool));
+        program.reached = calloc(program.length + 1, sizeof(bool));
+        program.queued = calloc(program.length + 1, sizeof(bool));
+        program.entry = calloc(program.length + 1, sizeof(abstractState *));
+        program.worklist = calloc(program.length + 1, sizeof(uint32_t));
+        program.pending = 0;
+        assert(program.leader && program.reached && program.queued &&
+               program.entry && program.worklist);
+
+        analyse(&program);
+        if (format == JSON) {
+                printJson(&program, filename);
+        } else if (format == DOT) {
+                printDot(&program);
+        } else {
+                printListing(&program);
+        }
+
+        for (uint32_t pc = 0; pc < program.length; pc++) {
+                free(program.entry[pc]);
+        }
+        free(program.entry);
+        free(program.leader);
+        free(program.reached);
+        free(program.queued);
+        free(program.worklist);
+        freeSegment(&program.image);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/******************************************************************************
+ *
+ *                              umgen.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains umgen, which writes synthetic benchmark programs
+ *    for the UM. Each workload stresses one part of the machine (dispatch,
+ *    MAP and UNMAP, jumps, LOAD_PROGRAM of another segment, stores into
+ *    the code, output or input) so that it can be tuned on its own. The
+ *    generators are in umlab.c; they write the image as they go, so
+ *    programs of millions of words take no more memory than small ones.
+ *
+ *    Usage: umgen WORKLOAD [-n ITERATIONS] [-s SIZE] [--seed N] [-o FILE]
+ *           umgen --list
+ *
+ *****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint32_t (*generator)(FILE *output, uint32_t iterations,
+                              uint32_t size, uint32_t seed);
+
+extern uint32_t generate_arith(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_maps_fixed(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_maps_uniform(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_maps_exponential(FILE *, uint32_t, uint32_t,
+                                          uint32_t);
+extern uint32_t generate_jumps(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_reload(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_selfmod(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_stream(FILE *, uint32_t, uint32_t, uint32_t);
+extern uint32_t generate_echo(FILE *, uint32_t, uint32_t, uint32_t);
+
+/* A workload, with what SIZE means for it, its defaults, and the largest
+SIZE whose image LOAD_VAL can still address */
+static struct workload {
+        const char *name;
+        const char *size_means;
+        uint32_t iterations;
+        uint32_t size;
+        uint32_t max_size;
+        generator generate;
+} workloads[] = {
+        { "arith", "instructions in the loop", 10000, 1000, 1 << 24,
+          generate_arith },
+        { "maps-fixed", "words in each segment", 1000, 64, 1 << 24,
+          generate_maps_fixed },
+        { "maps-uniform", "most words in a segment", 1000, 128, 1 << 24,
+          generate_maps_uniform },
+        { "maps-exponential", "mean words in a segment", 1000, 64, 1 << 24,
+          generate_maps_exponential },
+        { "jumps", "blocks jumped through", 1000, 10000, 1 << 23,
+          generate_jumps },
+        { "reload", "words of data copied with the code", 100, 4096,
+          1 << 24, generate_reload },
+        { "selfmod", "LOAD_VALs rewritten in turn", 100000, 100, 1 << 23,
+          generate_selfmod },
+        { "stream", "bytes written per iteration", 1000, 4096, 1 << 24,
+          generate_stream },
+        { "echo", "(unused: copies input to output)", 1, 1, 1,
+          generate_echo }
+};
+
+#define NWORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+/**************************** usage() ****************************
+ *  Purpose: Prints how to invoke umgen and exits with failure
+ ***********************************************************************/
+static void usage(void)
+{
+        fprintf(stderr, "Usage: ./umgen WORKLOAD [-n ITERATIONS] [-s SIZE] "
+                        "[--seed N] [-o FILE]\n"
+                        "       ./umgen --list\n");
+        exit(EXIT_FAILURE);
+}
+
+/**************************** listWorkloads() ****************************
+ *  Purpose: Prints each workload, what SIZE means for it and its defaults
+ *  Parameters: None
+ *  Returns: None
+ ***********************************************************************/
+static void listWorkloads(void)
+{
+        for (unsigned i = 0; i < NWORKLOADS; i++) {
+                printf("%-17s -n %-7u -s %-6u SIZE: %s\n",
+                       workloads[i].name, workloads[i].iterations,
+                       workloads[i].size, workloads[i].size_means);
+        }
+}
+
+/****************************** parseCount() ******************************
+ *  Purpose: Reads a count given on the command line
+ *  Parameters: const char *text: the argument
+ *              uint32_t low, high: the range it must be in
+ *  Returns: the count; exits through usage() if it is not one
+ ***********************************************************************/
+static uint32_t parseCount(const char *text, uint32_t low, uint32_t high)
+{
+        char *end;
+        unsigned long long count = strtoull(text, &end, 10);
+        if (*text == '\0' || *end != '\0' || count < low || count > high) {
+                usage();
+        }
+        return (uint32_t) count;
+}
+
+int main(int argc, char *argv[])
+{
+        struct workload *workload = NULL;
+        const char *path = NULL;
+        const char *iterations = NULL;
+        const char *size = NULL;
+        uint32_t seed = 1;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--list") == 0) {
+                        listWorkloads();
+                        return EXIT_SUCCESS;
+                } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                        iterations = argv[++i];
+                } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        size = argv[++i];
+                } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                        seed = parseCount(argv[++i], 0, UINT32_MAX);
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        path = argv[++i];
+                } else if (workload == NULL && argv[i][0] != '-') {
+                        for (unsigned j = 0; j < NWORKLOADS; j++) {
+                                if (strcmp(argv[i], workloads[j].name) == 0) {
+                                        workload = &workloads[j];
+                                }
+                        }
+                        if (workload == NULL) {
+                                fprintf(stderr, "umgen: no workload named "
+                                                "%s (see --list)\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                } else {
+                        usage();
+                }
+        }
+        if (workload == NULL) {
+                usage();
+        }
+
+        uint32_t n = iterations == NULL ? workload->iterations :
+                     parseCount(iterations, 1, UINT32_MAX);
+        uint32_t s = size == NULL ? workload->size :
+                     parseCount(size, 1, workload->max_size);
+
+        FILE *output = path == NULL ? stdout : fopen(path, "wb");
+        if (output == NULL) {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+        setvbuf(output, NULL, _IOFBF, 1 << 16);
+        workload->generate(output, n, s, seed);
+        if (fflush(output) != 0 || ferror(output) ||
+            (path != NULL && fclose(output) != 0)) {
+                fprintf(stderr, "umgen: cannot write %s\n",
+                        path == NULL ? "standard output" : path);
+                exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+}
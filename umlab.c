@@ -14,42 +14,31 @@
  */
 
 
+#include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "assert.h"
 #include "seq.h"
 #include "bitpack.h"
 #include "registers.h"
+#include "isa.h"
 
 
-typedef uint32_t Um_instruction;
-typedef enum Um_opcode {
-        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
-        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
-} Um_opcode;
 
 
 /* Functions that return the two instruction types */
 
-Um_instruction three_register(Um_opcode op, int ra, int rb, int rc)
+static inline Um_instruction three_register(Um_opcode op, int ra, int rb,
+                                            int rc)
 {
-        Um_instruction instruction = 0;
-        instruction = (uint32_t)Bitpack_newu(instruction, 4, 28, op);   
-        instruction = (uint32_t)Bitpack_newu(instruction, 3, 6, ra);
-        instruction = (uint32_t)Bitpack_newu(instruction, 3, 3, rb);
-        instruction = (uint32_t)Bitpack_newu(instruction, 3, 0, rc);
-        
-        return instruction;
+        return Um_pack(op, ra, rb, rc);
 }
 
-Um_instruction loadval(unsigned ra, unsigned val)
+static inline Um_instruction loadval(unsigned ra, unsigned val)
 {
-        Um_instruction instruction = 0;
-        instruction = (uint32_t)Bitpack_newu(instruction, 4, 28, 13);  
-        instruction = (uint32_t)Bitpack_newu(instruction, 3, 25, ra);
-        instruction = (uint32_t)Bitpack_newu(instruction, 25, 0, val);
-        
-        return instruction;
+        return Um_lv(ra, val);
 }
 
 
@@ -57,73 +46,88 @@ Um_instruction loadval(unsigned ra, unsigned val)
 
 static inline Um_instruction halt(void) 
 {
-        return three_register(HALT, 0, 0, 0);
+        return Um_halt();
 }
 
 typedef enum Um_register { r0 = 0, r1, r2, r3, r4, r5, r6, r7 } Um_register;
 
 
-Um_instruction cond_move(Um_register a, Um_register b, Um_register c)
+static inline Um_instruction cond_move(Um_register a, Um_register b, 
+                                       Um_register c)
 {
-        return three_register(CMOV, a, b, c);
+        return Um_cmov(a, b, c);
 }
 
-Um_instruction seg_load(Um_register a, Um_register b, Um_register c)
+static inline Um_instruction seg_load(Um_register a, Um_register b, 
+                                      Um_register c)
 {
-        return three_register(SLOAD, a, b, c);
+        return Um_sload(a, b, c);
 }
 
-Um_instruction seg_store(Um_register a, Um_register b, Um_register c)
+static inline Um_instruction seg_store(Um_register a, Um_register b, 
+                                       Um_register c)
 {
-        return three_register(SSTORE, a, b, c);
+        return Um_sstore(a, b, c);
 }
 
 static inline Um_instruction add(Um_register a, Um_register b, Um_register c) 
 {
-        return three_register(ADD, a, b, c);
+        return Um_add(a, b, c);
 }
 
 static inline Um_instruction mult(Um_register a, Um_register b, Um_register c) 
 {
-        return three_register(MUL, a, b, c);
+        return Um_mul(a, b, c);
 }
 
 static inline Um_instruction divide(Um_register a, Um_register b, 
                                                         Um_register c) 
 {
-        return three_register(DIV, a, b, c);
+        return Um_div(a, b, c);
 }
 
 static inline Um_instruction nand(Um_register a, Um_register b, Um_register c) 
 {
-        return three_register(NAND, a, b, c);
+        return Um_nand(a, b, c);
 }
 
-Um_instruction map(Um_register b, Um_register c)
+static inline Um_instruction map(Um_register b, Um_register c)
 {
-        return three_register(ACTIVATE, 0, b, c);
+        return Um_map(b, c);
 }
 
-Um_instruction unmap(Um_register c)
+static inline Um_instruction unmap(Um_register c)
 {
-        return three_register(INACTIVATE, 0, 0, c);
+        return Um_unmap(c);
 }
 
-Um_instruction output(Um_register c)
+static inline Um_instruction output(Um_register c)
 {
-        return three_register(OUT, 0, 0, c);
+        return Um_out(c);
 }
 
 
 static inline Um_instruction input(Um_register c) 
 {
-        return three_register(IN, 0, 0, c);
+        return Um_in(c);
 }
 
 
-Um_instruction load_program(Um_register b, Um_register c)
+static inline Um_instruction load_program(Um_register b, Um_register c)
 {
-        return three_register(LOADP, 0, b, c);
+        return Um_loadp(b, c);
+}
+
+/* Extension opcodes, valid only under um --ext (see isa.h) */
+
+static inline Um_instruction hcall(Um_register a, Um_register b, Um_register c)
+{
+        return Um_hcall(a, b, c);
+}
+
+static inline Um_instruction resize(Um_register b, Um_register c)
+{
+        return Um_resize(b, c);
 }
 
 
@@ -137,16 +141,20 @@ static inline void append(Seq_T stream, Um_instruction inst)
 
 const uint32_t Um_word_width = 32;
 
+void Um_write_word(FILE *output, Um_instruction inst)
+{
+        /* writes to file in big-endian order */
+        for (int lsb = Um_word_width - 8; lsb >= 0; lsb -= 8) {
+                putc(Bitpack_getu(inst, 8, lsb), output);
+        }
+}
+
 void Um_write_sequence(FILE *output, Seq_T stream)
 {
         assert(output != NULL && stream != NULL);
         int stream_length = Seq_length(stream);
         for (int i = 0; i < stream_length; i++) {
-                Um_instruction inst = (uintptr_t)Seq_remlo(stream);
-                /* writes to file in big-endian order */
-                for (int lsb = Um_word_width - 8; lsb >= 0; lsb -= 8) {
-                        fputc(Bitpack_getu(inst, 8, lsb), output);
-                }
+                Um_write_word(output, (uintptr_t)Seq_remlo(stream));
         }
       
 }
@@ -680,3 +688,1195 @@ void load_addition(Seq_T stream)
         append(stream, halt());
 }
 
+/* -------------------------------------------------------------------------- */
+/*                 EXTENSION TESTS (run with um --ext)                        */
+/* -------------------------------------------------------------------------- */
+
+/* $m[$r[segment]][offset] = value, using r6 and r7 */
+static void store_value(Seq_T stream, Um_register segment, unsigned offset,
+                        unsigned value)
+{
+        append(stream, loadval(r6, offset));
+        append(stream, loadval(r7, value));
+        append(stream, seg_store(segment, r6, r7));
+}
+
+/* outputs $m[$r[segment]][offset], using r6 and r7 */
+static void output_word(Seq_T stream, Um_register segment, unsigned offset)
+{
+        append(stream, loadval(r6, offset));
+        append(stream, seg_load(r7, segment, r6));
+        append(stream, output(r7));
+}
+
+void ext_copy(Seq_T stream)
+{
+        /* r1 = 16 word segment holding "Hi" at 0 and the operands at 8 */
+        append(stream, loadval(r0, 16));
+        append(stream, map(r1, r0));
+        store_value(stream, r1, 0, 'H');
+        store_value(stream, r1, 1, 'i');
+
+        /* copy s[r1][0..1] to s[r1][4..5] */
+        append(stream, loadval(r6, 8));
+        append(stream, seg_store(r1, r6, r1));
+        store_value(stream, r1, 9, 4);
+        append(stream, loadval(r6, 10));
+        append(stream, seg_store(r1, r6, r1));
+        store_value(stream, r1, 11, 0);
+        store_value(stream, r1, 12, 2);
+        append(stream, loadval(r0, UM_HCALL_COPY));
+        append(stream, loadval(r2, 8));
+        append(stream, hcall(r0, r1, r2));
+
+        output_word(stream, r1, 4);
+        output_word(stream, r1, 5);
+        append(stream, halt());
+}
+
+void ext_fill(Seq_T stream)
+{
+        /* r1 = 8 word segment with the operands at 4 */
+        append(stream, loadval(r0, 8));
+        append(stream, map(r1, r0));
+        append(stream, loadval(r6, 4));
+        append(stream, seg_store(r1, r6, r1));
+        store_value(stream, r1, 5, 0);
+        store_value(stream, r1, 6, 'Z');
+        store_value(stream, r1, 7, 3);
+        append(stream, loadval(r0, UM_HCALL_FILL));
+        append(stream, loadval(r2, 4));
+        append(stream, hcall(r0, r1, r2));
+
+        output_word(stream, r1, 0);
+        output_word(stream, r1, 1);
+        output_word(stream, r1, 2);
+        append(stream, halt());
+}
+
+void ext_copy_code(Seq_T stream)
+{
+        /* r5 = out r3, built as 10 * 2^28 + 3 */
+        append(stream, loadval(r5, 10));
+        append(stream, loadval(r6, 16384));
+        append(stream, mult(r6, r6, r6));
+        append(stream, mult(r5, r5, r6));
+        append(stream, loadval(r6, 3));
+        append(stream, add(r5, r5, r6));
+
+        /* r1 holds it at 0 and the operands of copying it over the 
+        halt below at 1 */
+        append(stream, loadval(r0, 6));
+        append(stream, map(r1, r0));
+        append(stream, loadval(r6, 0));
+        append(stream, seg_store(r1, r6, r5));
+        store_value(stream, r1, 1, 0);
+        store_value(stream, r1, 2, 28);
+        append(stream, loadval(r6, 3));
+        append(stream, seg_store(r1, r6, r1));
+        store_value(stream, r1, 4, 0);
+        store_value(stream, r1, 5, 1);
+        append(stream, loadval(r0, UM_HCALL_COPY));
+        append(stream, loadval(r2, 1));
+        append(stream, loadval(r3, 'Y'));
+        append(stream, hcall(r0, r1, r2));
+
+        /* word 28: replaced by out r3 */
+        append(stream, halt());
+        append(stream, halt());
+}
+
+void ext_resize(Seq_T stream)
+{
+        /* r1 = 1 word segment holding 'R', grown to 4 words */
+        append(stream, loadval(r0, 1));
+        append(stream, map(r1, r0));
+        store_value(stream, r1, 0, 'R');
+        append(stream, loadval(r0, 4));
+        append(stream, resize(r1, r0));
+        store_value(stream, r1, 3, 'S');
+        output_word(stream, r1, 0);
+        output_word(stream, r1, 3);
+
+        /* new words are 0 */
+        append(stream, loadval(r6, 2));
+        append(stream, seg_load(r7, r1, r6));
+        append(stream, loadval(r6, '0'));
+        append(stream, add(r7, r7, r6));
+        append(stream, output(r7));
+
+        /* shrunk back to 1 word, which is kept */
+        append(stream, loadval(r0, 1));
+        append(stream, resize(r1, r0));
+        output_word(stream, r1, 0);
+        append(stream, halt());
+}
+
+
+/* -------------------------------------------------------------------------- */
+/*            GUARD PAGE TESTS (run with um --guard-pages)                    */
+/* -------------------------------------------------------------------------- */
+
+void guard_load_past_end(Seq_T stream)
+{
+        /* segment 1 has 2 words; word 100 is in its guard */
+        append(stream, loadval(r1, 2));
+        append(stream, map(r2, r1));
+        append(stream, loadval(r3, 100));
+        append(stream, seg_load(r4, r2, r3));
+        append(stream, halt());
+}
+
+void guard_span_past_guard(Seq_T stream)
+{
+        /* word 5000 is beyond a 4 KiB guard, so it is checked in software */
+        append(stream, loadval(r1, 2));
+        append(stream, map(r2, r1));
+        append(stream, loadval(r3, 5000));
+        append(stream, seg_load(r4, r2, r3));
+        append(stream, halt());
+}
+
+/* -------------------------------------------------------------------------- */
+/*          IDIOM TESTS (loops that idiom.c runs in bulk)                     */
+/* -------------------------------------------------------------------------- */
+
+/* Each test jumps into its loop, so that the loop starts at a LOAD_PROGRAM
+target as idiom.c expects, and then prints the registers the loop wrote,
+which must be as the interpreter leaves them. A loop fits in 8 registers 
+only if the segments are named by the registers that hold 0 (Z) and 1 
+(K), so a copy can overlap itself only in place, and the copy with two 
+indices, which needs 9, is never seen. */
+
+/* writes $r[reg] as 11 octal digits and a newline, using t1 and t2 */
+static void print_octal(Seq_T stream, Um_register reg, Um_register t1,
+                        Um_register t2)
+{
+        for (int shift = 30; shift >= 0; shift -= 3) {
+                if (shift >= 24) {
+                        append(stream, loadval(t1, 1 << (shift - 12)));
+                        append(stream, loadval(t2, 1 << 12));
+                        append(stream, mult(t1, t1, t2));
+                } else {
+                        append(stream, loadval(t1, 1 << shift));
+                }
+                append(stream, divide(t1, reg, t1));
+                append(stream, loadval(t2, 7));
+                append(stream, nand(t1, t1, t2));
+                append(stream, nand(t1, t1, t1));
+                append(stream, loadval(t2, '0'));
+                append(stream, add(t1, t1, t2));
+                append(stream, output(t1));
+        }
+        append(stream, loadval(t1, '\n'));
+        append(stream, output(t1));
+}
+
+/* writes $m[$r[segment]][offset] in octal, using index, value, t1, t2 */
+static void print_word(Seq_T stream, Um_register segment, unsigned offset,
+                       Um_register index, Um_register value, Um_register t1,
+                       Um_register t2)
+{
+        append(stream, loadval(index, offset));
+        append(stream, seg_load(value, segment, index));
+        print_octal(stream, value, t1, t2);
+}
+
+/* jumps to the loop that follows, through $r[x]; returns its start */
+static unsigned enter_loop(Seq_T stream, Um_register x, Um_register z)
+{
+        unsigned loop = Seq_length(stream) + 2;
+        append(stream, loadval(x, loop));
+        append(stream, load_program(z, x));
+        return loop;
+}
+
+/* goes back to loop while $r[c] is not 0, and on to exit then */
+static void loop_back(Seq_T stream, unsigned loop, unsigned exit,
+                      Um_register c, Um_register x, Um_register y,
+                      Um_register z)
+{
+        append(stream, loadval(x, loop));
+        append(stream, loadval(y, exit));
+        append(stream, cond_move(y, x, c));
+        append(stream, load_program(z, y));
+}
+
+/* $r[m] = ~0, with the registers all 0 as a program starts */
+static void load_all_ones(Seq_T stream, Um_register m)
+{
+        append(stream, nand(m, m, m));
+}
+
+/* the copy loop, $m[$r[d]][$r[i]] = $m[$r[s]][$r[i]] for $r[c] words */
+static void copy_loop(Seq_T stream, Um_register t, Um_register s,
+                      Um_register d, Um_register i, Um_register k, 
+                      Um_register c, Um_register m, Um_register x,
+                      Um_register y, Um_register z)
+{
+        unsigned loop = enter_loop(stream, x, z);
+        append(stream, seg_load(t, s, i));
+        append(stream, seg_store(d, i, t));
+        append(stream, add(i, i, k));
+        append(stream, add(c, c, m));
+        loop_back(stream, loop, loop + 8, c, x, y, z);
+}
+
+/* the fill loop, $m[$r[d]][$r[j]] = $r[v] for $r[c] words */
+static void fill_loop(Seq_T stream, Um_register d, Um_register j,
+                      Um_register v, Um_register k, Um_register c,
+                      Um_register m, Um_register x, Um_register y,
+                      Um_register z)
+{
+        unsigned loop = enter_loop(stream, x, z);
+        append(stream, seg_store(d, j, v));
+        append(stream, add(j, j, k));
+        append(stream, add(c, c, m));
+        loop_back(stream, loop, loop + 7, c, x, y, z);
+}
+
+/* the compare loop over $r[c] words of $r[s] and $r[d] from $r[i]; it 
+leaves for the word after it whether or not they differ */
+static void compare_loop(Seq_T stream, Um_register u, Um_register s,
+                         Um_register d, Um_register i, Um_register k,
+                         Um_register c, Um_register m, Um_register x,
+                         Um_register y, Um_register z)
+{
+        unsigned loop = enter_loop(stream, x, z);
+        append(stream, seg_load(x, s, i));
+        append(stream, seg_load(u, d, i));
+        append(stream, nand(u, u, u));
+        append(stream, add(u, u, x));
+        append(stream, add(u, u, k));
+        append(stream, loadval(x, loop + 9));
+        append(stream, loadval(y, loop + 15));
+        append(stream, cond_move(x, y, u));
+        append(stream, load_program(z, x));
+        append(stream, add(i, i, k));
+        append(stream, add(c, c, m));
+        loop_back(stream, loop, loop + 15, c, x, y, z);
+}
+
+void idiom_copy(Seq_T stream)
+{
+        /* words 2 to 7 of the code go to the same words of segment 1 */
+        append(stream, loadval(r4, 8));
+        append(stream, map(r1, r4));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r3, 2));
+        append(stream, loadval(r4, 6));
+        copy_loop(stream, r5, r0, r1, r3, r1, r4, r2, r6, r7, r0);
+
+        print_octal(stream, r3, r0, r2);
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_octal(stream, r6, r0, r2);
+        print_octal(stream, r7, r0, r2);
+        print_word(stream, r1, 1, r3, r4, r0, r2);
+        print_word(stream, r1, 2, r3, r4, r0, r2);
+        print_word(stream, r1, 7, r3, r4, r0, r2);
+        append(stream, halt());
+}
+
+void idiom_copy_in_place(Seq_T stream)
+{
+        /* segment 1 copied onto itself: the last word copied stays in T */
+        append(stream, loadval(r4, 4));
+        append(stream, map(r1, r4));
+        append(stream, loadval(r3, 3));
+        append(stream, loadval(r4, 1234567));
+        append(stream, seg_store(r1, r3, r4));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r3, 0));
+        append(stream, loadval(r4, 4));
+        copy_loop(stream, r5, r1, r1, r3, r1, r4, r2, r6, r7, r0);
+
+        print_octal(stream, r3, r0, r2);
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_word(stream, r1, 3, r3, r4, r0, r2);
+        append(stream, halt());
+}
+
+void idiom_copy_off_end(Seq_T stream)
+{
+        /* 6 words into a 4 word segment: the interpreter fails at the 
+        store of word 4, after copying words 2 and 3 */
+        append(stream, loadval(r3, 'A'));
+        append(stream, output(r3));
+        append(stream, loadval(r4, 4));
+        append(stream, map(r1, r4));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r3, 2));
+        append(stream, loadval(r4, 6));
+        copy_loop(stream, r5, r0, r1, r3, r1, r4, r2, r6, r7, r0);
+        append(stream, loadval(r3, 'B'));
+        append(stream, output(r3));
+        append(stream, halt());
+}
+
+void idiom_fill(Seq_T stream)
+{
+        /* words 1 to 5 of segment 1 are set to 0x1234567 */
+        append(stream, loadval(r4, 8));
+        append(stream, map(r1, r4));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r3, 0x1234567));
+        append(stream, loadval(r4, 1));
+        append(stream, loadval(r5, 5));
+        fill_loop(stream, r1, r4, r3, r1, r5, r2, r6, r7, r0);
+
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_octal(stream, r6, r0, r2);
+        print_octal(stream, r7, r0, r2);
+        print_word(stream, r1, 0, r3, r4, r0, r2);
+        print_word(stream, r1, 1, r3, r4, r0, r2);
+        print_word(stream, r1, 5, r3, r4, r0, r2);
+        print_word(stream, r1, 6, r3, r4, r0, r2);
+        append(stream, halt());
+}
+
+void idiom_fill_code(Seq_T stream)
+{
+        /* words 3 to 7 of the code, data jumped over, are set to 0777: 
+        stores into segment 0 are left to the interpreter */
+        append(stream, loadval(r6, 10));
+        append(stream, load_program(r0, r6));
+        for (int i = 2; i < 10; i++) {
+                append(stream, halt());
+        }
+        append(stream, loadval(r1, 1));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r3, 0777));
+        append(stream, loadval(r4, 3));
+        append(stream, loadval(r5, 5));
+        fill_loop(stream, r0, r4, r3, r1, r5, r2, r6, r7, r0);
+
+        print_octal(stream, r4, r1, r2);
+        print_octal(stream, r5, r1, r2);
+        print_word(stream, r0, 2, r3, r4, r1, r2);
+        print_word(stream, r0, 3, r3, r4, r1, r2);
+        print_word(stream, r0, 7, r3, r4, r1, r2);
+        print_word(stream, r0, 8, r3, r4, r1, r2);
+        append(stream, halt());
+}
+
+void idiom_fill_step(Seq_T stream)
+{
+        /* K is 2, so words 0, 2, 4 and 6 of segment 1 are set to 1 */
+        append(stream, loadval(r4, 8));
+        append(stream, map(r3, r4));
+        append(stream, loadval(r1, 2));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r4, 0));
+        append(stream, loadval(r5, 4));
+        fill_loop(stream, r3, r4, r3, r1, r5, r2, r6, r7, r0);
+
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_octal(stream, r6, r0, r2);
+        print_octal(stream, r7, r0, r2);
+        print_word(stream, r3, 0, r1, r4, r0, r2);
+        print_word(stream, r3, 1, r1, r4, r0, r2);
+        print_word(stream, r3, 6, r1, r4, r0, r2);
+        print_word(stream, r3, 7, r1, r4, r0, r2);
+        append(stream, halt());
+}
+
+void idiom_fill_count(Seq_T stream)
+{
+        /* M is ~1, so a count of 6 fills 3 words */
+        append(stream, loadval(r4, 8));
+        append(stream, map(r1, r4));
+        append(stream, loadval(r2, 1));
+        append(stream, nand(r2, r2, r2));
+        append(stream, loadval(r3, 0x1234567));
+        append(stream, loadval(r4, 0));
+        append(stream, loadval(r5, 6));
+        fill_loop(stream, r1, r4, r3, r1, r5, r2, r6, r7, r0);
+
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_octal(stream, r6, r0, r2);
+        print_octal(stream, r7, r0, r2);
+        print_word(stream, r1, 2, r3, r4, r0, r2);
+        print_word(stream, r1, 3, r3, r4, r0, r2);
+        append(stream, halt());
+}
+
+/* copies the first 16 words of the code to segment 1, changes word 
+mismatch of the copy unless it is 0, then compares words 4 to 13 */
+static void compare_test(Seq_T stream, unsigned mismatch)
+{
+        append(stream, loadval(r4, 16));
+        append(stream, map(r1, r4));
+        load_all_ones(stream, r2);
+        append(stream, loadval(r4, 0));
+        append(stream, loadval(r5, 16));
+        copy_loop(stream, r3, r0, r1, r4, r1, r5, r2, r6, r7, r0);
+        if (mismatch != 0) {
+                append(stream, loadval(r4, mismatch));
+                append(stream, loadval(r3, 12345));
+                append(stream, seg_store(r1, r4, r3));
+        }
+        append(stream, loadval(r4, 4));
+        append(stream, loadval(r5, 10));
+        compare_loop(stream, r3, r0, r1, r4, r1, r5, r2, r6, r7, r0);
+
+        print_octal(stream, r3, r0, r2);
+        print_octal(stream, r4, r0, r2);
+        print_octal(stream, r5, r0, r2);
+        print_octal(stream, r6, r0, r2);
+        print_octal(stream, r7, r0, r2);
+        append(stream, halt());
+}
+
+void idiom_compare_equal(Seq_T stream)
+{
+        compare_test(stream, 0);
+}
+
+void idiom_compare_mismatch(Seq_T stream)
+{
+        compare_test(stream, 9);
+}
+
+
+/* -------------------------------------------------------------------------- */
+/*       COMPRESS TESTS (run with um --compress-cold 1)                       */
+/* -------------------------------------------------------------------------- */
+
+/* The test fills segments of 100 words, leaves them alone long enough to
+be packed (every jump is a block boundary, where um packs the segments not
+used since the one before) and reads them back, twice, hashing the words
+of each segment in order. */
+
+#define COMPRESS_WORDS 100
+
+/* the kinds of segment, each packing through another path of compress.c */
+typedef enum compress_fill {
+        FILL_RUN,               /* one value: a single overlapping match */
+        FILL_BLOCKS,            /* a block of 3 repeated: matches at 3 */
+        FILL_NOISE,             /* no pair twice: too big, left unpacked */
+        FILL_MIXED              /* noise, a run and noise: both tokens */
+} compress_fill;
+
+/* the word at offset of a segment of a kind; noise comes from x */
+static uint32_t compress_word(compress_fill fill, unsigned offset,
+                              uint32_t *x)
+{
+        *x = *x * 69069 + 1;
+        uint32_t noise = *x >> 7;
+        switch (fill) {
+        case FILL_RUN:
+                return 5;
+        case FILL_BLOCKS:
+                return offset % 3 + 1;
+        case FILL_NOISE:
+                return noise;
+        default:
+                return offset < 20 || offset >= 80 ? noise : 9;
+        }
+}
+
+/* jumps to the next instruction, through $r[r6] */
+static void jump_ahead(Seq_T stream)
+{
+        append(stream, loadval(r6, Seq_length(stream) + 2));
+        append(stream, load_program(r0, r6));
+}
+
+/* writes the hash of the words of $r[segment], using r5 to r7 */
+static void print_hash(Seq_T stream, Um_register segment)
+{
+        append(stream, loadval(r5, 0));
+        for (unsigned i = 0; i < COMPRESS_WORDS; i++) {
+                append(stream, loadval(r6, i));
+                append(stream, seg_load(r6, segment, r6));
+                append(stream, loadval(r7, 31));
+                append(stream, mult(r5, r5, r7));
+                append(stream, add(r5, r5, r6));
+        }
+        print_octal(stream, r5, r6, r7);
+}
+
+void compress_round_trip(Seq_T stream)
+{
+        uint32_t x = 1;
+        for (compress_fill fill = FILL_RUN; fill <= FILL_MIXED; fill++) {
+                Um_register segment = r1 + fill;
+                append(stream, loadval(r6, COMPRESS_WORDS));
+                append(stream, map(segment, r6));
+                for (unsigned i = 0; i < COMPRESS_WORDS; i++) {
+                        append(stream, loadval(r6, i));
+                        append(stream, loadval(r7,
+                                               compress_word(fill, i, &x)));
+                        append(stream, seg_store(segment, r6, r7));
+                }
+        }
+        for (int pass = 0; pass < 2; pass++) {
+                for (int i = 0; i < 3; i++) {
+                        jump_ahead(stream);
+                }
+                for (Um_register segment = r1; segment <= r4; segment++) {
+                        print_hash(stream, segment);
+                }
+        }
+        append(stream, halt());
+}
+
+
+/* -------------------------------------------------------------------------- */
+/*                 WORKLOAD GENERATORS (written by umgen)                     */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * A workload is a benchmark program of a chosen shape, of any size up to
+ * the 2^25 words a LOAD_VAL can address. It is written straight to its
+ * file as it is generated, so that an image of millions of words is never
+ * held in a Seq_T. The emitter counts the words written so far: code
+ * names its own address by remembering where it is, and every jump is
+ * either backwards or a known distance ahead. An emitter with no file
+ * only counts, to measure code before writing it.
+ *
+ * By convention r0 holds 0 throughout, so that load_program(r0, rC) jumps
+ * to $r[rC]. Every workload loops until a counter, set from the number of
+ * iterations, reaches 0, and most end by printing a checksum, so that two
+ * UMs running one can be compared.
+ */
+
+typedef struct emitter {
+        FILE *image;
+        uint32_t at;
+        uint64_t random;
+} emitter;
+
+static emitter start_workload(FILE *image, uint32_t seed)
+{
+        emitter e = { image, 0, seed };
+        return e;
+}
+
+static void emit(emitter *e, Um_instruction inst)
+{
+        if (e->image != NULL) {
+                Um_write_word(e->image, inst);
+        }
+        e->at++;
+}
+
+/* the address ahead words from here, which a LOAD_VAL must hold */
+static uint32_t here(emitter *e, uint32_t ahead)
+{
+        assert(e->at + ahead <= UM_VALUE_MAX);
+        return e->at + ahead;
+}
+
+/* splitmix64, so that a seed gives the same program everywhere */
+static uint32_t next_random(emitter *e)
+{
+        uint64_t z = (e->random += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+static uint32_t random_below(emitter *e, uint32_t bound)
+{
+        return (uint32_t)(((uint64_t)next_random(e) * bound) >> 32);
+}
+
+/* puts 0 .. count - 1 in order in a random order */
+static void shuffle(emitter *e, uint32_t *order, uint32_t count)
+{
+        for (uint32_t i = 0; i < count; i++) {
+                order[i] = i;
+        }
+        for (uint32_t i = count; i > 1; i--) {
+                uint32_t j = random_below(e, i);
+                uint32_t kept = order[i - 1];
+                order[i - 1] = order[j];
+                order[j] = kept;
+        }
+}
+
+/* $r[reg] = value, of any size, using scratch */
+static void load_constant(emitter *e, Um_register reg, uint32_t value,
+                          Um_register scratch)
+{
+        if (value <= UM_VALUE_MAX) {
+                emit(e, loadval(reg, value));
+                return;
+        }
+        emit(e, loadval(reg, value >> 16));
+        emit(e, loadval(scratch, 1 << 16));
+        emit(e, mult(reg, reg, scratch));
+        emit(e, loadval(scratch, value & 0xffff));
+        emit(e, add(reg, reg, scratch));
+}
+
+/* decrements $r[counter] and jumps back to top unless it is now 0, using
+t1 and t2 */
+static void loop_end(emitter *e, Um_register counter, Um_register t1,
+                     Um_register t2, uint32_t top)
+{
+        emit(e, loadval(t1, 0));
+        emit(e, nand(t1, t1, t1));
+        emit(e, add(counter, counter, t1));
+        emit(e, loadval(t1, here(e, 4)));
+        emit(e, loadval(t2, top));
+        emit(e, cond_move(t1, t2, counter));
+        emit(e, load_program(r0, t1));
+}
+
+/* outputs $r[value] as 8 hex digits and a newline, using t1, t2, t3 */
+static void put_checksum(emitter *e, Um_register value, Um_register t1,
+                         Um_register t2, Um_register t3)
+{
+        for (int shift = 28; shift >= 0; shift -= 4) {
+                /* t1 = the digit, t2 = '0' + t1, t3 = 'a' - 10 + t1 */
+                load_constant(e, t1, 1u << shift, t2);
+                emit(e, divide(t1, value, t1));
+                emit(e, loadval(t2, 15));
+                emit(e, nand(t1, t1, t2));
+                emit(e, nand(t1, t1, t1));
+                emit(e, loadval(t2, '0'));
+                emit(e, add(t2, t2, t1));
+                emit(e, loadval(t3, 'a' - 10));
+                emit(e, add(t3, t3, t1));
+
+                /* the digit is a letter when t2 / ('0' + 10) is 1 */
+                emit(e, loadval(t1, '0' + 10));
+                emit(e, divide(t1, t2, t1));
+                emit(e, cond_move(t2, t3, t1));
+                emit(e, output(t2));
+        }
+        emit(e, loadval(t1, '\n'));
+        emit(e, output(t1));
+}
+
+/* a random ADD, MULT, NAND, DIV, CMOV or LOAD_VAL on r1-r4; r7, the
+counter, is never 0 inside a loop and so is what DIV divides by */
+static Um_instruction random_arith(emitter *e)
+{
+        Um_register a = r1 + random_below(e, 4);
+        Um_register b = r1 + random_below(e, 4);
+        Um_register c = r1 + random_below(e, 4);
+        switch (random_below(e, 10)) {
+        case 0: case 1: case 2:
+                return add(a, b, c);
+        case 3: case 4:
+                return mult(a, b, c);
+        case 5: case 6:
+                return nand(a, b, c);
+        case 7:
+                return divide(a, b, r7);
+        case 8:
+                return cond_move(a, b, c);
+        default:
+                return loadval(a, random_below(e, UM_VALUE_MAX + 1));
+        }
+}
+
+/*
+ * arith: a loop of size straight-line arithmetic instructions, for the
+ * dispatch of the engines and nothing else. Prints the sum of r1-r4.
+ */
+uint32_t generate_arith(FILE *image, uint32_t iterations, uint32_t size,
+                        uint32_t seed)
+{
+        emitter e = start_workload(image, seed);
+        for (int r = r1; r <= r4; r++) {
+                emit(&e, loadval(r, random_below(&e, UM_VALUE_MAX + 1)));
+        }
+        load_constant(&e, r7, iterations, r5);
+
+        uint32_t top = e.at;
+        for (uint32_t i = 0; i < size; i++) {
+                emit(&e, random_arith(&e));
+        }
+        loop_end(&e, r7, r5, r6, top);
+
+        emit(&e, add(r1, r1, r2));
+        emit(&e, add(r1, r1, r3));
+        emit(&e, add(r1, r1, r4));
+        put_checksum(&e, r1, r2, r3, r4);
+        emit(&e, halt());
+        return e.at;
+}
+
+/* The segments the map workloads keep, and how many times each is
+replaced in one iteration */
+#define MAP_SLOTS 256
+#define MAP_PASSES 4
+
+typedef enum map_sizes { SIZES_FIXED, SIZES_UNIFORM, SIZES_EXPONENTIAL }
+        map_sizes;
+
+static uint32_t map_size(emitter *e, map_sizes sizes, uint32_t size)
+{
+        if (sizes == SIZES_FIXED) {
+                return size;
+        } else if (sizes == SIZES_UNIFORM) {
+                return random_below(e, size + 1);
+        }
+        double words = -log((next_random(e) + 1.0) / 4294967296.0) * size;
+        return words >= UM_VALUE_MAX ? UM_VALUE_MAX : (uint32_t)words;
+}
+
+/*
+ * maps: MAP and UNMAP churn. A table in $r[r6] holds MAP_SLOTS segments;
+ * each iteration replaces every one MAP_PASSES times, in a random order,
+ * by a segment of a size drawn from sizes, and stores the counter in its
+ * last word. Prints the sum of the last words at the end.
+ */
+static uint32_t generate_maps(FILE *image, uint32_t iterations,
+                              uint32_t size, uint32_t seed, map_sizes sizes)
+{
+        emitter e = start_workload(image, seed);
+        uint32_t order[MAP_SLOTS];
+        uint32_t last_words[MAP_SLOTS];
+
+        emit(&e, loadval(r1, MAP_SLOTS));
+        emit(&e, map(r6, r1));
+        emit(&e, loadval(r1, 0));
+        for (uint32_t slot = 0; slot < MAP_SLOTS; slot++) {
+                emit(&e, map(r2, r1));
+                emit(&e, loadval(r3, slot));
+                emit(&e, seg_store(r6, r3, r2));
+        }
+        load_constant(&e, r7, iterations, r5);
+
+        uint32_t top = e.at;
+        for (int pass = 0; pass < MAP_PASSES; pass++) {
+                shuffle(&e, order, MAP_SLOTS);
+                for (uint32_t i = 0; i < MAP_SLOTS; i++) {
+                        uint32_t words = map_size(&e, sizes, size);
+                        last_words[order[i]] = words;
+                        emit(&e, loadval(r3, order[i]));
+                        emit(&e, seg_load(r2, r6, r3));
+                        emit(&e, unmap(r2));
+                        emit(&e, loadval(r1, words));
+                        emit(&e, map(r2, r1));
+                        emit(&e, seg_store(r6, r3, r2));
+                        if (words != 0) {
+                                emit(&e, loadval(r3, words - 1));
+                                emit(&e, seg_store(r2, r3, r7));
+                        }
+                }
+        }
+        loop_end(&e, r7, r4, r5, top);
+
+        emit(&e, loadval(r5, 0));
+        for (uint32_t slot = 0; slot < MAP_SLOTS; slot++) {
+                if (last_words[slot] != 0) {
+                        emit(&e, loadval(r3, slot));
+                        emit(&e, seg_load(r2, r6, r3));
+                        emit(&e, loadval(r3, last_words[slot] - 1));
+                        emit(&e, seg_load(r4, r2, r3));
+                        emit(&e, add(r5, r5, r4));
+                }
+        }
+        put_checksum(&e, r5, r1, r2, r3);
+        emit(&e, halt());
+        return e.at;
+}
+
+uint32_t generate_maps_fixed(FILE *image, uint32_t iterations,
+                             uint32_t size, uint32_t seed)
+{
+        return generate_maps(image, iterations, size, seed, SIZES_FIXED);
+}
+
+uint32_t generate_maps_uniform(FILE *image, uint32_t iterations,
+                               uint32_t size, uint32_t seed)
+{
+        return generate_maps(image, iterations, size, seed, SIZES_UNIFORM);
+}
+
+uint32_t generate_maps_exponential(FILE *image, uint32_t iterations,
+                                   uint32_t size, uint32_t seed)
+{
+        return generate_maps(image, iterations, size, seed,
+                             SIZES_EXPONENTIAL);
+}
+
+/*
+ * jumps: size blocks of three words, each an ADD and a LOAD_PROGRAM
+ * within segment 0 to the next, laid out in a random order so that every
+ * jump goes somewhere new. Prints the number of blocks run.
+ */
+uint32_t generate_jumps(FILE *image, uint32_t iterations, uint32_t size,
+                        uint32_t seed)
+{
+        emitter e = start_workload(image, seed);
+        uint32_t *order = malloc(size * sizeof(uint32_t));
+        uint32_t *place = malloc(size * sizeof(uint32_t));
+        assert(order != NULL && place != NULL);
+        shuffle(&e, order, size);
+        for (uint32_t i = 0; i < size; i++) {
+                place[order[i]] = i;
+        }
+
+        emit(&e, loadval(r2, 0));
+        emit(&e, loadval(r3, 1));
+        load_constant(&e, r7, iterations, r5);
+
+        /* block k is at base + 3 * place[k]; the last goes to end */
+        uint32_t top = e.at;
+        uint32_t base = here(&e, 2);
+        uint32_t end = here(&e, 2 + 3 * size);
+        emit(&e, loadval(r1, base + 3 * place[0]));
+        emit(&e, load_program(r0, r1));
+        for (uint32_t i = 0; i < size; i++) {
+                uint32_t next = order[i] + 1;
+                emit(&e, add(r2, r2, r3));
+                emit(&e, loadval(r1, next == size ? end :
+                                             base + 3 * place[next]));
+                emit(&e, load_program(r0, r1));
+        }
+        loop_end(&e, r7, r4, r5, top);
+
+        put_checksum(&e, r2, r1, r3, r4);
+        emit(&e, halt());
+        free(order);
+        free(place);
+        return e.at;
+}
+
+/* the code of reload, for a program of length words in all */
+static void reload_code(emitter *e, uint32_t iterations, uint32_t length)
+{
+        emit(e, loadval(r5, 0));
+        emit(e, nand(r5, r5, r5));
+        load_constant(e, r7, iterations, r1);
+        emit(e, loadval(r1, 1));
+        emit(e, map(r6, r1));
+
+        /* a new copy of the program in $r[r6], the last word first */
+        uint32_t top = e->at;
+        emit(e, unmap(r6));
+        emit(e, loadval(r1, length));
+        emit(e, map(r6, r1));
+        emit(e, loadval(r2, length));
+        uint32_t copy = e->at;
+        emit(e, add(r2, r2, r5));
+        emit(e, seg_load(r3, r0, r2));
+        emit(e, seg_store(r6, r2, r3));
+        emit(e, loadval(r4, here(e, 4)));
+        emit(e, loadval(r1, copy));
+        emit(e, cond_move(r4, r1, r2));
+        emit(e, load_program(r0, r4));
+
+        /* which then replaces segment 0, at top or, at the end, here */
+        emit(e, add(r7, r7, r5));
+        emit(e, loadval(r4, here(e, 4)));
+        emit(e, loadval(r1, top));
+        emit(e, cond_move(r4, r1, r7));
+        emit(e, load_program(r6, r4));
+
+        put_checksum(e, r3, r1, r2, r4);
+        emit(e, halt());
+}
+
+/*
+ * reload: LOAD_PROGRAM from a segment other than 0. Each iteration the
+ * program copies itself, with size words of data after its code, into a
+ * new segment one word at a time and loads that. Prints the first word
+ * of the program.
+ */
+uint32_t generate_reload(FILE *image, uint32_t iterations, uint32_t size,
+                         uint32_t seed)
+{
+        emitter measure = start_workload(NULL, seed);
+        reload_code(&measure, iterations, 0);
+        uint32_t length = measure.at + size;
+        assert(length <= UM_VALUE_MAX);
+
+        emitter e = start_workload(image, seed);
+        reload_code(&e, iterations, length);
+        for (uint32_t i = 0; i < size; i++) {
+                emit(&e, next_random(&e));
+        }
+        return e.at;
+}
+
+/*
+ * selfmod: self-modifying code. The loop runs size LOAD_VALs, each added
+ * into r2, and before them rewrites one of them, number counter mod size,
+ * to load one more than before. Prints r2.
+ */
+uint32_t generate_selfmod(FILE *image, uint32_t iterations, uint32_t size,
+                          uint32_t seed)
+{
+        emitter e = start_workload(image, seed);
+        emit(&e, loadval(r5, 1));
+        emit(&e, loadval(r2, 0));
+        load_constant(&e, r7, iterations, r1);
+
+        /* r4 = base + 2 * ($r[r7] mod size), the LOAD_VAL to rewrite */
+        uint32_t top = e.at;
+        emit(&e, loadval(r3, size));
+        emit(&e, divide(r4, r7, r3));
+        emit(&e, mult(r4, r4, r3));
+        emit(&e, nand(r4, r4, r4));
+        emit(&e, add(r4, r4, r7));
+        emit(&e, add(r4, r4, r5));
+        emit(&e, add(r4, r4, r4));
+        emit(&e, loadval(r3, here(&e, 5)));
+        emit(&e, add(r4, r4, r3));
+        emit(&e, seg_load(r3, r0, r4));
+        emit(&e, add(r3, r3, r5));
+        emit(&e, seg_store(r0, r4, r3));
+
+        for (uint32_t i = 0; i < size; i++) {
+                emit(&e, loadval(r1, random_below(&e, 1 << 16)));
+                emit(&e, add(r2, r2, r1));
+        }
+        loop_end(&e, r7, r3, r4, top);
+
+        put_checksum(&e, r2, r1, r3, r4);
+        emit(&e, halt());
+        return e.at;
+}
+
+/*
+ * stream: output. Each iteration writes size bytes, four random letters
+ * in a random order, with a newline every 64.
+ */
+uint32_t generate_stream(FILE *image, uint32_t iterations, uint32_t size,
+                         uint32_t seed)
+{
+        emitter e = start_workload(image, seed);
+        for (int r = r1; r <= r4; r++) {
+                emit(&e, loadval(r, 'a' + random_below(&e, 26)));
+        }
+        load_constant(&e, r7, iterations, r6);
+
+        uint32_t top = e.at;
+        emit(&e, loadval(r5, '\n'));
+        for (uint32_t i = 1; i <= size; i++) {
+                emit(&e, output(i % 64 == 0 ? r5 :
+                                (Um_register)(r1 + random_below(&e, 4))));
+        }
+        loop_end(&e, r7, r5, r6, top);
+        emit(&e, halt());
+        return e.at;
+}
+
+/*
+ * echo: input. Copies its input to its output a byte at a time until
+ * end of file; iterations, size and seed do not change it.
+ */
+uint32_t generate_echo(FILE *image, uint32_t iterations, uint32_t size,
+                       uint32_t seed)
+{
+        (void)iterations;
+        (void)size;
+        emitter e = start_workload(image, seed);
+
+        /* r2 = $r[r1] + 1, 0 at end of file */
+        uint32_t top = e.at;
+        emit(&e, input(r1));
+        emit(&e, loadval(r2, 1));
+        emit(&e, add(r2, r1, r2));
+        emit(&e, loadval(r3, here(&e, 7)));
+        emit(&e, loadval(r4, here(&e, 3)));
+        emit(&e, cond_move(r3, r4, r2));
+        emit(&e, load_program(r0, r3));
+
+        emit(&e, output(r1));
+        emit(&e, loadval(r3, top));
+        emit(&e, load_program(r0, r3));
+        emit(&e, halt());
+        return e.at;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/*                 MICROBENCHMARK KERNELS (run by umbench)                    */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * A kernel is a loop of unroll copies of one operation, run iterations
+ * times. Its baseline is the same loop with the operation left out, so
+ * that the difference between the two is the time of the operations
+ * alone. Kernels set r1-r3 to fixed values and r4 to a mapped segment of
+ * KERNEL_WORDS words; the operations leave r5-r7 to the loop.
+ */
+
+#define KERNEL_WORDS 1024
+
+/* The words between two far jumps, 4 KiB */
+#define FAR_STRIDE 1024
+
+static uint32_t kernel_start(emitter *e, uint32_t iterations,
+                             uint32_t v1, uint32_t v2, uint32_t v3)
+{
+        emit(e, loadval(r1, KERNEL_WORDS));
+        emit(e, map(r4, r1));
+        load_constant(e, r1, v1, r5);
+        load_constant(e, r2, v2, r5);
+        load_constant(e, r3, v3, r5);
+        load_constant(e, r7, iterations, r5);
+        return e->at;
+}
+
+static uint32_t kernel_end(emitter *e, uint32_t top)
+{
+        loop_end(e, r7, r5, r6, top);
+        emit(e, halt());
+        return e->at;
+}
+
+/* a kernel whose operation is the length instructions of unit */
+static uint32_t simple_kernel(FILE *image, uint32_t iterations,
+                              uint32_t unroll, bool baseline,
+                              uint32_t v1, uint32_t v2, uint32_t v3,
+                              const Um_instruction *unit, int length)
+{
+        emitter e = start_workload(image, 1);
+        uint32_t top = kernel_start(&e, iterations, v1, v2, v3);
+        for (uint32_t i = 0; i < unroll && !baseline; i++) {
+                for (int j = 0; j < length; j++) {
+                        emit(&e, unit[j]);
+                }
+        }
+        return kernel_end(&e, top);
+}
+
+uint32_t kernel_cmov_taken(FILE *image, uint32_t iterations, uint32_t unroll,
+                           bool baseline)
+{
+        Um_instruction unit[] = { cond_move(r1, r2, r3) };
+        return simple_kernel(image, iterations, unroll, baseline, 1, 2, 3,
+                             unit, 1);
+}
+
+uint32_t kernel_cmov_not_taken(FILE *image, uint32_t iterations,
+                               uint32_t unroll, bool baseline)
+{
+        Um_instruction unit[] = { cond_move(r1, r2, r0) };
+        return simple_kernel(image, iterations, unroll, baseline, 1, 2, 3,
+                             unit, 1);
+}
+
+uint32_t kernel_add(FILE *image, uint32_t iterations, uint32_t unroll,
+                    bool baseline)
+{
+        Um_instruction unit[] = { add(r1, r1, r2) };
+        return simple_kernel(image, iterations, unroll, baseline, 1, 12345, 0,
+                             unit, 1);
+}
+
+uint32_t kernel_mult(FILE *image, uint32_t iterations, uint32_t unroll,
+                     bool baseline)
+{
+        Um_instruction unit[] = { mult(r1, r1, r2) };
+        return simple_kernel(image, iterations, unroll, baseline, 3, 1000003, 0,
+                             unit, 1);
+}
+
+uint32_t kernel_div(FILE *image, uint32_t iterations, uint32_t unroll,
+                    bool baseline)
+{
+        Um_instruction unit[] = { divide(r1, r2, r3) };
+        return simple_kernel(image, iterations, unroll, baseline, 0,
+                             0xfedcba98, 7, unit, 1);
+}
+
+uint32_t kernel_nand(FILE *image, uint32_t iterations, uint32_t unroll,
+                     bool baseline)
+{
+        Um_instruction unit[] = { nand(r1, r1, r2) };
+        return simple_kernel(image, iterations, unroll, baseline, 1, 0x5555, 0,
+                             unit, 1);
+}
+
+uint32_t kernel_sload(FILE *image, uint32_t iterations, uint32_t unroll,
+                      bool baseline)
+{
+        Um_instruction unit[] = { seg_load(r1, r4, r3) };
+        return simple_kernel(image, iterations, unroll, baseline, 0, 0, 17,
+                             unit, 1);
+}
+
+uint32_t kernel_sstore(FILE *image, uint32_t iterations, uint32_t unroll,
+                       bool baseline)
+{
+        Um_instruction unit[] = { seg_store(r4, r3, r1) };
+        return simple_kernel(image, iterations, unroll, baseline, 5, 0, 17,
+                             unit, 1);
+}
+
+/* a MAP of words words and the UNMAP of the segment it made */
+static uint32_t map_kernel(FILE *image, uint32_t iterations, uint32_t unroll,
+                           bool baseline, uint32_t words)
+{
+        Um_instruction unit[] = { map(r1, r2), unmap(r1) };
+        return simple_kernel(image, iterations, unroll, baseline, 0, words,
+                             0, unit, 2);
+}
+
+uint32_t kernel_map_1(FILE *image, uint32_t iterations, uint32_t unroll,
+                      bool baseline)
+{
+        return map_kernel(image, iterations, unroll, baseline, 1);
+}
+
+uint32_t kernel_map_64(FILE *image, uint32_t iterations, uint32_t unroll,
+                       bool baseline)
+{
+        return map_kernel(image, iterations, unroll, baseline, 64);
+}
+
+uint32_t kernel_map_4096(FILE *image, uint32_t iterations, uint32_t unroll,
+                         bool baseline)
+{
+        return map_kernel(image, iterations, unroll, baseline, 4096);
+}
+
+uint32_t kernel_output(FILE *image, uint32_t iterations, uint32_t unroll,
+                       bool baseline)
+{
+        Um_instruction unit[] = { output(r1) };
+        return simple_kernel(image, iterations, unroll, baseline, 'x', 0, 0,
+                             unit, 1);
+}
+
+/* LOAD_PROGRAMs to the next word; the baseline keeps their LOAD_VALs */
+uint32_t kernel_jump_near(FILE *image, uint32_t iterations, uint32_t unroll,
+                          bool baseline)
+{
+        emitter e = start_workload(image, 1);
+        uint32_t top = kernel_start(&e, iterations, 0, 0, 0);
+        for (uint32_t i = 0; i < unroll; i++) {
+                emit(&e, loadval(r1, here(&e, 2)));
+                if (!baseline) {
+                        emit(&e, load_program(r0, r1));
+                }
+        }
+        return kernel_end(&e, top);
+}
+
+/* LOAD_PROGRAMs FAR_STRIDE words ahead, over HALTs that are never run;
+the baseline keeps their LOAD_VALs, without the gaps */
+uint32_t kernel_jump_far(FILE *image, uint32_t iterations, uint32_t unroll,
+                         bool baseline)
+{
+        emitter e = start_workload(image, 1);
+        uint32_t top = kernel_start(&e, iterations, 0, 0, 0);
+        for (uint32_t i = 0; i < unroll; i++) {
+                if (baseline) {
+                        emit(&e, loadval(r1, here(&e, 1)));
+                        continue;
+                }
+                emit(&e, loadval(r1, here(&e, FAR_STRIDE)));
+                emit(&e, load_program(r0, r1));
+                for (uint32_t gap = 2; gap < FAR_STRIDE; gap++) {
+                        emit(&e, halt());
+                }
+        }
+        return kernel_end(&e, top);
+}
@@ -76,6 +76,30 @@ extern void load_minimum(Seq_T stream);
 extern void load_value(Seq_T stream);
 extern void load_readable(Seq_T stream);
 
+/* ----------------------- EXTENSION TESTS (um --ext) ----------------------- */
+extern void ext_copy(Seq_T stream);
+extern void ext_fill(Seq_T stream);
+extern void ext_copy_code(Seq_T stream);
+extern void ext_resize(Seq_T stream);
+
+/* ------------------ GUARD PAGE TESTS (um --guard-pages) ------------------- */
+extern void guard_load_past_end(Seq_T stream);
+extern void guard_span_past_guard(Seq_T stream);
+
+/* ----------------- IDIOM TESTS (loops idiom.c runs in bulk) --------------- */
+extern void idiom_copy(Seq_T stream);
+extern void idiom_copy_in_place(Seq_T stream);
+extern void idiom_copy_off_end(Seq_T stream);
+extern void idiom_fill(Seq_T stream);
+extern void idiom_fill_code(Seq_T stream);
+extern void idiom_fill_step(Seq_T stream);
+extern void idiom_fill_count(Seq_T stream);
+extern void idiom_compare_equal(Seq_T stream);
+extern void idiom_compare_mismatch(Seq_T stream);
+
+/* ---------------- COMPRESS TESTS (um --compress-cold 1) ------------------ */
+extern void compress_round_trip(Seq_T stream);
+
 
 /* The array `tests` contains all unit tests for the lab. */
 
@@ -155,7 +179,70 @@ static struct test_info {
         /* LOAD VALUE TESTS */
         { "load_value", NULL, "30", load_value },
         { "load_readable", NULL, "B", load_readable },
-        { "load_minimum", NULL, "", load_minimum }
+        { "load_minimum", NULL, "", load_minimum },
+
+        /* EXTENSION TESTS (um --ext) */
+        { "ext_copy", NULL, "Hi", ext_copy },
+        { "ext_fill", NULL, "ZZZ", ext_fill },
+        { "ext_copy_code", NULL, "Y", ext_copy_code },
+        { "ext_resize", NULL, "RS0R", ext_resize },
+
+        /* GUARD PAGE TESTS (um --guard-pages): what um writes on stderr,
+        then its exit status; run_tests.sh takes the output expected of 
+        guard_span_past_guard from um without guard pages */
+        { "guard_load_past_end", NULL,
+          "um: segment access out of bounds at pc 3: segment 1, "
+          "offset 100 (length 2)\nexit 1\n", guard_load_past_end },
+        { "guard_span_past_guard", NULL, "", guard_span_past_guard },
+
+        /* IDIOM TESTS */
+        { "idiom_copy", NULL,
+          "00000000010\n00000000000\n02000000503\n"
+          "00000000007\n00000000017\n00000000000\n"
+          "14000000222\n02000000503\n",
+          idiom_copy },
+        { "idiom_copy_in_place", NULL,
+          "00000000004\n00000000000\n00004553207\n"
+          "00004553207\n",
+          idiom_copy_in_place },
+        { "idiom_copy_off_end", NULL, "A", idiom_copy_off_end },
+        { "idiom_fill", NULL,
+          "00000000006\n00000000000\n00000000010\n"
+          "00000000017\n00000000000\n00110642547\n"
+          "00110642547\n00000000000\n",
+          idiom_fill },
+        { "idiom_fill_code", NULL,
+          "00000000010\n00000000000\n16000000000\n"
+          "00000000777\n00000000777\n16000000000\n",
+          idiom_fill_code },
+        { "idiom_fill_step", NULL,
+          "00000000010\n00000000000\n00000000010\n"
+          "00000000017\n00000000001\n00000000000\n"
+          "00000000001\n00000000000\n",
+          idiom_fill_step },
+        { "idiom_fill_count", NULL,
+          "00000000003\n00000000000\n00000000011\n"
+          "00000000020\n00110642547\n00000000000\n",
+          idiom_fill_count },
+        { "idiom_compare_equal", NULL,
+          "00000000000\n00000000016\n00000000000\n"
+          "00000000023\n00000000042\n",
+          idiom_compare_equal },
+        { "idiom_compare_mismatch", NULL,
+          "05777750350\n00000000011\n00000000005\n"
+          "00000000045\n00000000045\n",
+          idiom_compare_mismatch },
+
+        /* COMPRESS TESTS (um --compress-cold 1): the hashes, what um 
+        writes on stderr (3 segments unpacked in each pass, the noise
+        never packed), then its exit status */
+        { "compress_round_trip", NULL,
+          "01665633500\n37621304077\n15573104032\n13307563075\n"
+          "01665633500\n37621304077\n15573104032\n13307563075\n"
+          "um: memory high-water mark: 26 KiB, 6397 words, 5 segments\n"
+          "um: cold segments: 0 packed, 0 words in 0 KiB; "
+          "6 unpacked again\nexit 0\n",
+          compress_round_trip }
 
 };
 
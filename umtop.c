@@ -0,0 +1,170 @@
+/******************************************************************************
+ *
+ *                              umtop.c
+ *
+ *     Assignment: um
+ *     Authors: Angela Shen and Nora A-Rahim
+ *     Date: April 14, 2023
+ *
+ *    This file contains um-top, a viewer of the live statistics pages that
+ *    um --live-stats keeps in /dev/shm. Every second it lists each running
+ *    um: its program, state, instructions retired and MIPS over the last
+ *    second, live segments and words, MAP and UNMAP rates, LOAD_PROGRAMs
+ *    and bytes of input and output, and the total throughput. It only
+ *    reads the pages, so watching does not slow the programs. Pages whose
+ *    um has died without removing them are left out.
+ *
+ *    Usage: um-top [--once] [--interval SECONDS]
+ *
+ *****************************************************************************/
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "livestats.h"
+#include "timing.h"
+
+/******************************* readPage() *******************************
+ *  Purpose: Copies the page in a file of the statistics directory
+ *  Parameters: const char *name: the name of the file
+ *              struct liveStatsPage *copy: where to copy the page
+ *  Returns: false if the file is not a page of a um that is still alive
+ ***********************************************************************/
+static bool readPage(const char *name, struct liveStatsPage *copy)
+{
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", LIVE_STATS_DIRECTORY, name);
+        int fd = open(path, O_RDONLY);
+        if (fd == -1) {
+                return false;
+        }
+        struct stat file;
+        bool read = false;
+        if (fstat(fd, &file) == 0 &&
+            file.st_size >= (off_t) sizeof(struct liveStatsPage)) {
+                void *page = mmap(NULL, sizeof(struct liveStatsPage),
+                                  PROT_READ, MAP_SHARED, fd, 0);
+                if (page != MAP_FAILED) {
+                        read = readLiveStats(page, copy);
+                        munmap(page, sizeof(struct liveStatsPage));
+                }
+        }
+        close(fd);
+        return read;
+}
+
+/***************************** comparePids() *****************************
+ *  Purpose: Orders pages by pid, for qsort
+ *  Parameters: const void *first, *second: two struct liveStatsPage
+ *  Returns: <0, 0 or >0 as first's pid is below, equal to or above
+ ***********************************************************************/
+static int comparePids(const void *first, const void *second)
+{
+        const struct liveStatsPage *a = first, *b = second;
+        return (a->pid > b->pid) - (a->pid < b->pid);
+}
+
+/****************************** showPages() ******************************
+ *  Purpose: Prints a table of the running ums
+ *  Parameters: None
+ *  Returns: None
+ *  Effects: Exits if the statistics directory cannot be read
+ ***********************************************************************/
+static void showPages(void)
+{
+        DIR *directory = opendir(LIVE_STATS_DIRECTORY);
+        if (directory == NULL) {
+                perror("um-top: " LIVE_STATS_DIRECTORY);
+                exit(EXIT_FAILURE);
+        }
+        size_t count = 0, capacity = 16;
+        struct liveStatsPage *pages = malloc(capacity * sizeof(*pages));
+        assert(pages != NULL);
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL) {
+                if (strncmp(entry->d_name, LIVE_STATS_PREFIX,
+                            strlen(LIVE_STATS_PREFIX)) != 0) {
+                        continue;
+                }
+                if (count == capacity) {
+                        capacity *= 2;
+                        pages = realloc(pages, capacity * sizeof(*pages));
+                        assert(pages != NULL);
+                }
+                if (readPage(entry->d_name, &pages[count])) {
+                        count++;
+                }
+        }
+        closedir(directory);
+        qsort(pages, count, sizeof(*pages), comparePids);
+
+        double now = clockNow(CLOCK_REALTIME);
+        double total_mips = 0;
+        printf("%7s %-16s %-10s %14s %8s %9s %12s %8s %8s %12s %9s %9s %5s\n",
+               "PID", "PROGRAM", "STATE", "INSTRUCTIONS", "MIPS",
+               "SEGMENTS", "WORDS", "MAP/s", "UNMAP/s", "JUMPS", "IN",
+               "OUT", "AGE");
+        for (size_t i = 0; i < count; i++) {
+                const struct liveStatsPage *page = &pages[i];
+                const struct liveCounters *c = &page->counters;
+                printf("%7lld %-16.16s %-10.10s %14llu %8.1f %9llu %12llu "
+                       "%8.0f %8.0f %12llu %9llu %9llu %4.0fs\n",
+                       (long long) page->pid, page->program, page->state,
+                       (unsigned long long) c->instructions, page->mips,
+                       (unsigned long long) c->segments,
+                       (unsigned long long) c->words, page->map_rate,
+                       page->unmap_rate, (unsigned long long) c->jumps,
+                       (unsigned long long) c->input_bytes,
+                       (unsigned long long) c->output_bytes,
+                       now - page->updated);
+                total_mips += page->mips;
+        }
+        printf("%zu running, %.1f MIPS in all\n", count, total_mips);
+        free(pages);
+}
+
+int main(int argc, char *argv[])
+{
+        bool once = false;
+        double interval = 1;
+        for (int i = 1; i < argc; i++) {
+                char *end;
+                if (strcmp(argv[i], "--once") == 0) {
+                        once = true;
+                } else if (strcmp(argv[i], "--interval") == 0 &&
+                           i + 1 < argc &&
+                           (interval = strtod(argv[++i], &end)) > 0 &&
+                           *end == '\0') {
+                        continue;
+                } else {
+                        fprintf(stderr, "Usage: ./um-top [--once] "
+                                        "[--interval SECONDS]\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        for (;;) {
+                if (!once) {
+                        /* home the cursor and clear the screen */
+                        printf("\033[H\033[2J");
+                }
+                showPages();
+                fflush(stdout);
+                if (once) {
+                        return EXIT_SUCCESS;
+                }
+                struct timespec pause = {
+                        (time_t) interval,
+                        (long) ((interval - (time_t) interval) * 1e9)
+                };
+                nanosleep(&pause, NULL);
+        }
+}